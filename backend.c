@@ -400,6 +400,7 @@ SR_API int sr_exit(struct sr_context *ctx)
 	}
 
 	sr_hw_cleanup_all();
+	sr_scan_cache_clear(ctx);
 
 #ifdef HAVE_LIBUSB_1_0
 	libusb_exit(ctx->libusb_ctx);
@@ -410,4 +411,44 @@ SR_API int sr_exit(struct sr_context *ctx)
 	return SR_OK;
 }
 
+/**
+ * Enable or disable the dedicated USB event thread.
+ *
+ * When enabled, drivers that support it handle libusb events on a separate
+ * high-priority thread, which resubmits completed transfers immediately.
+ * The received data is then passed to the session thread. This keeps
+ * transfers flowing while the frontend is busy handling data, at the cost
+ * of one extra thread and a second set of transfer buffers.
+ *
+ * The setting takes effect for acquisitions started afterwards. On Windows,
+ * libusb events are always handled on a separate thread, and this setting
+ * has no effect.
+ *
+ * @param ctx Pointer to a libsigrok context struct. Must not be NULL.
+ * @param enable TRUE to enable the USB event thread, FALSE to disable it.
+ *
+ * @retval SR_OK Success
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_NA libsigrok was built without USB support.
+ *
+ * @since 0.3.0
+ */
+SR_API int sr_usb_event_thread_set(struct sr_context *ctx, gboolean enable)
+{
+	if (!ctx) {
+		sr_err("%s(): libsigrok context was NULL.", __func__);
+		return SR_ERR_ARG;
+	}
+
+#ifdef HAVE_LIBUSB_1_0
+	ctx->usb_event_thread = enable;
+
+	return SR_OK;
+#else
+	(void)enable;
+
+	return SR_ERR_NA;
+#endif
+}
+
 /** @} */
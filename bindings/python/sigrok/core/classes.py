@@ -79,7 +79,19 @@ def python_to_gvariant(value):
 def callback_wrapper(session, callback, device_ptr, packet_ptr):
     device = session.context._devices[int(device_ptr.this)]
     packet = Packet(session, packet_ptr)
-    callback(device, packet)
+    try:
+        callback(device, packet)
+    finally:
+        packet._release()
+
+def batch_callback_wrapper(session, callback, items):
+    packets = [(session.context._devices[int(device_ptr.this)],
+        Packet(session, packet_ptr)) for device_ptr, packet_ptr in items]
+    try:
+        callback(packets)
+    finally:
+        for device, packet in packets:
+            packet._release()
 
 class Context(object):
 
@@ -320,6 +332,7 @@ class Session(object):
         context.session = self
 
     def __del__(self):
+        sr_session_datafeed_python_callbacks_remove()
         check(sr_session_destroy())
 
     def add_device(self, device):
@@ -332,6 +345,14 @@ class Session(object):
         wrapper = partial(callback_wrapper, self, callback)
         check(sr_session_datafeed_python_callback_add(wrapper))
 
+    def add_batch_callback(self, callback, max_packets=64):
+        wrapper = partial(batch_callback_wrapper, self, callback)
+        check(sr_session_datafeed_python_batch_callback_add(wrapper,
+            max_packets))
+
+    def remove_callbacks(self):
+        check(sr_session_datafeed_python_callbacks_remove())
+
     def start(self):
         check(sr_session_start())
 
@@ -367,12 +388,32 @@ class Packet(object):
                     "No Python mapping for packet type %s" % self.struct.type)
         return self._payload
 
+    def _release(self):
+        if self._payload is not None:
+            self._payload._release()
+
+def release_view(view):
+    # Views point into libsigrok-owned memory which goes away when the
+    # callback returns; release them so later access raises an error
+    # instead of reading freed memory. Views still exported to another
+    # object (e.g. a NumPy array) can't be released and must not be kept.
+    if hasattr(view, 'release'):
+        try:
+            view.release()
+        except BufferError:
+            pass
+
 class Logic(object):
 
     def __init__(self, packet, struct):
         self.packet = packet
         self.struct = struct
         self._data = None
+        self._view = None
+
+    @property
+    def unitsize(self):
+        return self.struct.unitsize
 
     @property
     def data(self):
@@ -380,12 +421,24 @@ class Logic(object):
             self._data = cdata(self.struct.data, self.struct.length)
         return self._data
 
+    # Zero-copy alternative to data, only valid during the callback.
+    @property
+    def data_view(self):
+        if self._view is None:
+            self._view = cdata_view(self.struct.data, self.struct.length, "")
+        return self._view
+
+    def _release(self):
+        if self._view is not None:
+            release_view(self._view)
+
 class Analog(object):
 
     def __init__(self, packet, struct):
         self.packet = packet
         self.struct = struct
         self._data = None
+        self._view = None
 
     @property
     def num_samples(self):
@@ -403,12 +456,33 @@ class Analog(object):
     def mqflags(self):
         return QuantityFlag.set_from_mask(self.struct.mqflags)
 
+    @property
+    def num_probes(self):
+        count = 0
+        probe_list = self.struct.probes
+        while (probe_list):
+            count += 1
+            probe_list = probe_list.next
+        return count
+
     @property
     def data(self):
         if self._data is None:
             self._data = float_array.frompointer(self.struct.data)
         return self._data
 
+    # Zero-copy alternative to data, only valid during the callback.
+    @property
+    def data_view(self):
+        if self._view is None:
+            self._view = cdata_view(self.struct.data,
+                self.num_samples * self.num_probes * 4, "f")
+        return self._view
+
+    def _release(self):
+        if self._view is not None:
+            release_view(self._view)
+
 class Log(object):
 
     @property
@@ -54,6 +54,201 @@ void sr_datafeed_python_callback(const struct sr_dev_inst *sdi,
     PyGILState_Release(gstate);
 }
 
+/*
+ * Batched delivery: logic and analog packets are copied into a queue and
+ * handed to Python as a list of (sdi, packet) tuples, so that the GIL is
+ * only taken once per batch rather than once per packet. Any other packet
+ * type flushes the queue and is delivered in the same batch, uncopied.
+ */
+struct python_batch {
+    PyObject *callback;
+    unsigned int max_packets;
+    GPtrArray *sdis;
+    GPtrArray *packets;
+};
+
+/* Registered callbacks, released by sr_session_datafeed_python_callbacks_remove(). */
+static GSList *python_callbacks = NULL;
+static GSList *python_batches = NULL;
+
+static struct sr_datafeed_packet *python_batch_packet_copy(
+        const struct sr_datafeed_packet *packet)
+{
+    struct sr_datafeed_packet *copy;
+    const struct sr_datafeed_logic *logic;
+    const struct sr_datafeed_analog *analog;
+    struct sr_datafeed_logic *logic_copy;
+    struct sr_datafeed_analog *analog_copy;
+    unsigned int num_probes;
+
+    if (!(copy = g_try_malloc(sizeof(struct sr_datafeed_packet))))
+        return NULL;
+    copy->type = packet->type;
+
+    switch (packet->type) {
+    case SR_DF_LOGIC:
+        logic = packet->payload;
+        if (!(logic_copy = g_try_malloc(sizeof(struct sr_datafeed_logic))))
+            break;
+        *logic_copy = *logic;
+        if (!(logic_copy->data = g_try_malloc(logic->length))) {
+            g_free(logic_copy);
+            break;
+        }
+        memcpy(logic_copy->data, logic->data, logic->length);
+        copy->payload = logic_copy;
+        return copy;
+    case SR_DF_ANALOG:
+        analog = packet->payload;
+        num_probes = g_slist_length(analog->probes);
+        if (!(analog_copy = g_try_malloc(sizeof(struct sr_datafeed_analog))))
+            break;
+        *analog_copy = *analog;
+        analog_copy->probes = g_slist_copy(analog->probes);
+        analog_copy->data = g_try_malloc(sizeof(float)
+                * analog->num_samples * num_probes);
+        if (!analog_copy->data) {
+            g_slist_free(analog_copy->probes);
+            g_free(analog_copy);
+            break;
+        }
+        memcpy(analog_copy->data, analog->data,
+                sizeof(float) * analog->num_samples * num_probes);
+        copy->payload = analog_copy;
+        return copy;
+    }
+
+    g_free(copy);
+    return NULL;
+}
+
+static void python_batch_packet_free(struct sr_datafeed_packet *packet)
+{
+    struct sr_datafeed_logic *logic;
+    struct sr_datafeed_analog *analog;
+
+    switch (packet->type) {
+    case SR_DF_LOGIC:
+        logic = (struct sr_datafeed_logic *) packet->payload;
+        g_free(logic->data);
+        g_free(logic);
+        break;
+    case SR_DF_ANALOG:
+        analog = (struct sr_datafeed_analog *) packet->payload;
+        g_slist_free(analog->probes);
+        g_free(analog->data);
+        g_free(analog);
+        break;
+    }
+    g_free(packet);
+}
+
+static void python_batch_flush(struct python_batch *batch,
+        const struct sr_dev_inst *sdi, const struct sr_datafeed_packet *packet)
+{
+    PyObject *list;
+    PyObject *item;
+    PyObject *arglist;
+    PyObject *result;
+    PyGILState_STATE gstate;
+    unsigned int i;
+
+    if (batch->packets->len == 0 && !packet)
+        return;
+
+    gstate = PyGILState_Ensure();
+
+    list = PyList_New(0);
+    for (i = 0; i < batch->packets->len; i++) {
+        item = Py_BuildValue("(NN)",
+            SWIG_NewPointerObj(g_ptr_array_index(batch->sdis, i),
+                SWIGTYPE_p_sr_dev_inst, 0),
+            SWIG_NewPointerObj(g_ptr_array_index(batch->packets, i),
+                SWIGTYPE_p_sr_datafeed_packet, 0));
+        PyList_Append(list, item);
+        Py_XDECREF(item);
+    }
+    if (packet) {
+        item = Py_BuildValue("(NN)",
+            SWIG_NewPointerObj(SWIG_as_voidptr(sdi),
+                SWIGTYPE_p_sr_dev_inst, 0),
+            SWIG_NewPointerObj(SWIG_as_voidptr(packet),
+                SWIGTYPE_p_sr_datafeed_packet, 0));
+        PyList_Append(list, item);
+        Py_XDECREF(item);
+    }
+
+    arglist = Py_BuildValue("(O)", list);
+
+    result = PyEval_CallObject(batch->callback, arglist);
+
+    Py_XDECREF(arglist);
+    Py_XDECREF(list);
+    Py_XDECREF(result);
+
+    PyGILState_Release(gstate);
+
+    for (i = 0; i < batch->packets->len; i++)
+        python_batch_packet_free(g_ptr_array_index(batch->packets, i));
+    g_ptr_array_set_size(batch->packets, 0);
+    g_ptr_array_set_size(batch->sdis, 0);
+}
+
+void sr_datafeed_python_batch_callback(const struct sr_dev_inst *sdi,
+        const struct sr_datafeed_packet *packet, void *cb_data)
+{
+    struct python_batch *batch;
+    struct sr_datafeed_packet *copy;
+
+    batch = (struct python_batch *) cb_data;
+
+    if (packet->type != SR_DF_LOGIC && packet->type != SR_DF_ANALOG) {
+        python_batch_flush(batch, sdi, packet);
+        return;
+    }
+
+    if (!(copy = python_batch_packet_copy(packet))) {
+        /* Out of memory: deliver what we have plus this packet as-is. */
+        python_batch_flush(batch, sdi, packet);
+        return;
+    }
+
+    g_ptr_array_add(batch->sdis, (gpointer) sdi);
+    g_ptr_array_add(batch->packets, copy);
+
+    if (batch->packets->len >= batch->max_packets)
+        python_batch_flush(batch, NULL, NULL);
+}
+
+int sr_session_datafeed_python_batch_callback_add(PyObject *cb,
+        unsigned int max_packets)
+{
+    struct python_batch *batch;
+    int ret;
+
+    if (!PyCallable_Check(cb) || max_packets == 0)
+        return SR_ERR_ARG;
+
+    if (!(batch = g_try_malloc0(sizeof(struct python_batch))))
+        return SR_ERR_MALLOC;
+    batch->callback = cb;
+    batch->max_packets = max_packets;
+    batch->sdis = g_ptr_array_sized_new(max_packets);
+    batch->packets = g_ptr_array_sized_new(max_packets);
+
+    ret = sr_session_datafeed_callback_add(
+        sr_datafeed_python_batch_callback, batch);
+    if (ret == SR_OK) {
+        Py_XINCREF(cb);
+        python_batches = g_slist_append(python_batches, batch);
+    } else {
+        g_ptr_array_free(batch->sdis, TRUE);
+        g_ptr_array_free(batch->packets, TRUE);
+        g_free(batch);
+    }
+    return ret;
+}
+
 int sr_session_datafeed_python_callback_add(PyObject *cb)
 {
     int ret;
@@ -63,12 +258,47 @@ int sr_session_datafeed_python_callback_add(PyObject *cb)
     else {
         ret = sr_session_datafeed_callback_add(
             sr_datafeed_python_callback, cb);
-        if (ret == SR_OK)
+        if (ret == SR_OK) {
             Py_XINCREF(cb);
+            python_callbacks = g_slist_append(python_callbacks, cb);
+        }
         return ret;
     }
 }
 
+/*
+ * Remove all datafeed callbacks, and drop the references and batch state
+ * held for the Python ones. Packets still queued in a batch are discarded.
+ */
+int sr_session_datafeed_python_callbacks_remove(void)
+{
+    struct python_batch *batch;
+    GSList *l;
+    unsigned int i;
+    int ret;
+
+    ret = sr_session_datafeed_callback_remove_all();
+
+    for (l = python_batches; l; l = l->next) {
+        batch = l->data;
+        for (i = 0; i < batch->packets->len; i++)
+            python_batch_packet_free(g_ptr_array_index(batch->packets, i));
+        g_ptr_array_free(batch->sdis, TRUE);
+        g_ptr_array_free(batch->packets, TRUE);
+        Py_XDECREF(batch->callback);
+        g_free(batch);
+    }
+    g_slist_free(python_batches);
+    python_batches = NULL;
+
+    for (l = python_callbacks; l; l = l->next)
+        Py_XDECREF((PyObject *) l->data);
+    g_slist_free(python_callbacks);
+    python_callbacks = NULL;
+
+    return ret;
+}
+
 PyObject *cdata(const void *data, unsigned long size)
 {
 #if PY_MAJOR_VERSION < 3
@@ -78,6 +308,32 @@ PyObject *cdata(const void *data, unsigned long size)
 #endif
 }
 
+/*
+ * Expose a C buffer through the buffer protocol without copying it, for
+ * the opt-in data_view accessors. The view is only valid for as long as
+ * the underlying buffer is, i.e. for the duration of the datafeed
+ * callback it was created in. A non-empty format
+ * (e.g. "f") yields a typed view on Python 3.
+ */
+PyObject *cdata_view(const void *data, unsigned long size, const char *format)
+{
+    PyObject *view;
+    PyObject *typed;
+
+#if PY_MAJOR_VERSION < 3
+    (void)format;
+    view = PyBuffer_FromMemory((void *) data, size);
+#else
+    view = PyMemoryView_FromMemory((char *) data, size, PyBUF_READ);
+    if (view && format && *format) {
+        typed = PyObject_CallMethod(view, "cast", "s", format);
+        Py_DECREF(view);
+        view = typed;
+    }
+#endif
+    return view;
+}
+
 GSList *python_to_gslist(PyObject *pylist)
 {
     if (PyList_Check(pylist)) {
@@ -106,8 +362,12 @@ PyObject *gslist_to_python(GSList *gslist)
 %}
 
 int sr_session_datafeed_python_callback_add(PyObject *cb);
+int sr_session_datafeed_python_batch_callback_add(PyObject *cb,
+        unsigned int max_packets);
+int sr_session_datafeed_python_callbacks_remove(void);
 
 PyObject *cdata(const void *data, unsigned long size);
+PyObject *cdata_view(const void *data, unsigned long size, const char *format);
 
 GSList *python_to_gslist(PyObject *pylist);
 PyObject *gslist_to_python(GSList *gslist);
@@ -18,6 +18,7 @@
  */
 
 #include <stdio.h>
+#include <string.h>
 #include <glib.h>
 #include "config.h" /* Needed for HAVE_LIBUSB_1_0 and others. */
 #include "libsigrok.h"
@@ -259,6 +260,8 @@ SR_PRIV struct sr_dev_inst *sr_dev_inst_new(int index, int status,
 	sdi->probe_groups = NULL;
 	sdi->conn = NULL;
 	sdi->priv = NULL;
+	memset(&sdi->stats, 0, sizeof(struct sr_acq_stats));
+	sdi->config_cache = NULL;
 
 	return sdi;
 }
@@ -283,6 +286,8 @@ SR_PRIV void sr_dev_inst_free(struct sr_dev_inst *sdi)
 	if (sdi->probe_groups)
 		g_slist_free(sdi->probe_groups);
 
+	sr_config_cache_free(sdi);
+
 	g_free(sdi->vendor);
 	g_free(sdi->model);
 	g_free(sdi->version);
@@ -313,6 +318,7 @@ SR_PRIV struct sr_usb_dev_inst *sr_usb_dev_inst_new(uint8_t bus,
 	udi->bus = bus;
 	udi->address = address;
 	udi->devhdl = hdl;
+	udi->port_path_len = 0;
 
 	return udi;
 }
@@ -437,6 +443,12 @@ SR_API GSList *sr_dev_list(const struct sr_dev_driver *driver)
  */
 SR_API int sr_dev_clear(const struct sr_dev_driver *driver)
 {
+	struct drv_context *drvc;
+
+	/* The instances are freed, so forget sr_driver_scan_all(). */
+	if (driver && (drvc = driver->priv))
+		sr_scan_cache_clear(drvc->sr_ctx);
+
 	if (driver && driver->dev_clear)
 		return driver->dev_clear();
 	else
@@ -485,4 +497,29 @@ SR_API int sr_dev_close(struct sr_dev_inst *sdi)
 	return ret;
 }
 
+/**
+ * Get the acquisition counters of a device.
+ *
+ * The counters are reset when a session with this device is started.
+ * While the session is running in another thread, the values are a
+ * snapshot which may be slightly inconsistent.
+ *
+ * @param sdi Device instance to use. Must not be NULL.
+ * @param stats Where to store the counters. Must not be NULL.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG upon invalid arguments.
+ *
+ * @since 0.3.0
+ */
+SR_API int sr_dev_stats_get(const struct sr_dev_inst *sdi,
+		struct sr_acq_stats *stats)
+{
+	if (!sdi || !stats)
+		return SR_ERR_ARG;
+
+	*stats = sdi->stats;
+
+	return SR_OK;
+}
+
 /** @} */
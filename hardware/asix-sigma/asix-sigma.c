@@ -39,6 +39,8 @@
 #define USB_MODEL_VERSION		""
 #define TRIGGER_TYPE 			"rf10"
 #define NUM_PROBES			16
+/* Bitbang firmware is written in chunks of this size, see upload_firmware(). */
+#define FIRMWARE_CHUNK_SIZE		(64 * 1024)
 
 SR_PRIV struct sr_dev_driver asix_sigma_driver_info;
 static struct sr_dev_driver *di = &asix_sigma_driver_info;
@@ -299,54 +301,35 @@ static int sigma_write_trigger_lut(struct triggerlut *lut, struct dev_context *d
 	return SR_OK;
 }
 
+/* Bitbang streams are only generated once per process. */
+static struct {
+	unsigned char *buf;
+	size_t buf_size;
+} firmware_cache[ARRAY_SIZE(firmware_files)];
+
 /* Generate the bitbang stream for programming the FPGA. */
 static int bin2bitbang(const char *filename,
 		       unsigned char **buf, size_t *buf_size)
 {
-	FILE *f;
-	unsigned long file_size;
-	unsigned long offset = 0;
-	unsigned char *p;
 	uint8_t *firmware;
-	unsigned long fwsize = 0;
-	const int buffer_size = 65536;
-	size_t i;
-	int c, bit, v;
+	gsize fwsize, i;
+	GError *error;
+	unsigned char *p;
+	int bit, v;
 	uint32_t imm = 0x3f6df2ab;
 
-	f = g_fopen(filename, "rb");
-	if (!f) {
-		sr_err("g_fopen(\"%s\", \"rb\")", filename);
+	error = NULL;
+	if (!g_file_get_contents(filename, (gchar **)&firmware, &fwsize,
+				 &error)) {
+		sr_err("Unable to read firmware %s: %s", filename,
+		       error->message);
+		g_error_free(error);
 		return SR_ERR;
 	}
 
-	if (-1 == fseek(f, 0, SEEK_END)) {
-		sr_err("fseek on %s failed", filename);
-		fclose(f);
-		return SR_ERR;
-	}
-
-	file_size = ftell(f);
-
-	fseek(f, 0, SEEK_SET);
-
-	if (!(firmware = g_try_malloc(buffer_size))) {
-		sr_err("%s: firmware malloc failed", __func__);
-		fclose(f);
-		return SR_ERR_MALLOC;
-	}
-
-	while ((c = getc(f)) != EOF) {
+	for (i = 0; i < fwsize; i++) {
 		imm = (imm + 0xa853753) % 177 + (imm * 0x8034052);
-		firmware[fwsize++] = c ^ imm;
-	}
-	fclose(f);
-
-	if(fwsize != file_size) {
-	    sr_err("%s: Error reading firmware", filename);
-	    fclose(f);
-	    g_free(firmware);
-	    return SR_ERR;
+		firmware[i] ^= imm;
 	}
 
 	*buf_size = fwsize * 2 * 8;
@@ -361,23 +344,24 @@ static int bin2bitbang(const char *filename,
 	for (i = 0; i < fwsize; ++i) {
 		for (bit = 7; bit >= 0; --bit) {
 			v = firmware[i] & 1 << bit ? 0x40 : 0x00;
-			p[offset++] = v | 0x01;
-			p[offset++] = v;
+			*p++ = v | 0x01;
+			*p++ = v;
 		}
 	}
 
 	g_free(firmware);
 
-	if (offset != *buf_size) {
-		g_free(*buf);
-		sr_err("Error reading firmware %s "
-		       "offset=%ld, file_size=%ld, buf_size=%zd.",
-		       filename, offset, file_size, *buf_size);
+	return SR_OK;
+}
 
-		return SR_ERR;
-	}
+static void firmware_cache_free(void)
+{
+	unsigned int i;
 
-	return SR_OK;
+	for (i = 0; i < ARRAY_SIZE(firmware_cache); i++) {
+		g_free(firmware_cache[i].buf);
+		firmware_cache[i].buf = NULL;
+	}
 }
 
 static void clear_helper(void *priv)
@@ -496,6 +480,7 @@ static int upload_firmware(int firmware_idx, struct dev_context *devc)
 	unsigned char *buf;
 	unsigned char pins;
 	size_t buf_size;
+	unsigned int chunksize;
 	unsigned char result[32];
 	char firmware_path[128];
 
@@ -539,20 +524,33 @@ static int upload_firmware(int firmware_idx, struct dev_context *devc)
 	}
 
 	/* Prepare firmware. */
-	snprintf(firmware_path, sizeof(firmware_path), "%s/%s", FIRMWARE_DIR,
-		 firmware_files[firmware_idx]);
-
-	if ((ret = bin2bitbang(firmware_path, &buf, &buf_size)) != SR_OK) {
-		sr_err("An error occured while reading the firmware: %s",
-		       firmware_path);
-		return ret;
+	if (!firmware_cache[firmware_idx].buf) {
+		snprintf(firmware_path, sizeof(firmware_path), "%s/%s",
+			 FIRMWARE_DIR, firmware_files[firmware_idx]);
+		if ((ret = bin2bitbang(firmware_path,
+				&firmware_cache[firmware_idx].buf,
+				&firmware_cache[firmware_idx].buf_size)) != SR_OK) {
+			sr_err("An error occured while reading the firmware: %s",
+			       firmware_path);
+			return ret;
+		}
 	}
-
-	/* Upload firmare. */
+	buf = firmware_cache[firmware_idx].buf;
+	buf_size = firmware_cache[firmware_idx].buf_size;
+
+	/*
+	 * Upload firmare. Use larger chunks than libftdi's default 4k, so
+	 * the bulk transfers aren't stalled in between so often. Each chunk
+	 * is a single transfer subject to libftdi's write timeout (5s by
+	 * default), so they must stay small enough to get through at the
+	 * bitbang rate even on slow hosts.
+	 */
 	sr_info("Uploading firmware file '%s'.", firmware_files[firmware_idx]);
+	ftdi_write_data_get_chunksize(&devc->ftdic, &chunksize);
+	ftdi_write_data_set_chunksize(&devc->ftdic,
+				      MIN(buf_size, FIRMWARE_CHUNK_SIZE));
 	sigma_write(buf, buf_size, devc);
-
-	g_free(buf);
+	ftdi_write_data_set_chunksize(&devc->ftdic, chunksize);
 
 	if ((ret = ftdi_set_bitmode(&devc->ftdic, 0x00, BITMODE_RESET)) < 0) {
 		sr_err("ftdi_set_bitmode failed: %s",
@@ -741,6 +739,8 @@ static int dev_close(struct sr_dev_inst *sdi)
 
 static int cleanup(void)
 {
+	firmware_cache_free();
+
 	return dev_clear();
 }
 
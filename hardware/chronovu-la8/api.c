@@ -104,7 +104,10 @@ static GSList *scan(GSList *options)
 	devc->limit_msec = 0;
 	devc->limit_samples = 0;
 	devc->cb_data = NULL;
-	memset(devc->mangled_buf, 0, BS);
+	devc->blocks = NULL;
+	devc->free_blocks = NULL;
+	devc->read_blocks = NULL;
+	devc->reader = NULL;
 	devc->final_buf = NULL;
 	devc->trigger_pattern = 0x00; /* Value irrelevant, see trigger_mask. */
 	devc->trigger_mask = 0x00; /* All probes are "don't care". */
@@ -370,9 +373,10 @@ static int config_list(int key, GVariant **data, const struct sr_dev_inst *sdi,
 
 static int receive_data(int fd, int revents, void *cb_data)
 {
-	int i, ret;
+	int ret;
 	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
+	struct la8_block *block;
 
 	(void)fd;
 	(void)revents;
@@ -392,24 +396,27 @@ static int receive_data(int fd, int revents, void *cb_data)
 		return FALSE;
 	}
 
-	/* Get one block of data. */
-	if ((ret = la8_read_block(devc)) < 0) {
-		sr_err("%s: la8_read_block error: %d.", __func__, ret);
-		dev_acquisition_stop(sdi, sdi);
-		return FALSE;
+	/* Demangle the blocks read so far, waiting a bit for the first. */
+	block = g_async_queue_timeout_pop(devc->read_blocks, 10 * 1000);
+	while (block) {
+		if ((ret = block->ret) < 0) {
+			sr_err("%s: la8_read_block error: %d.", __func__, ret);
+			la8_reader_stop(devc);
+			(void) la8_reset(devc); /* Ignore errors. */
+			dev_acquisition_stop(sdi, sdi);
+			return FALSE;
+		}
+		la8_demangle_block(devc, block);
+		g_async_queue_push(devc->free_blocks, block);
+		devc->block_counter++;
+		block = g_async_queue_try_pop(devc->read_blocks);
 	}
 
 	/* We need to get exactly NUM_BLOCKS blocks (i.e. 8MB) of data. */
-	if (devc->block_counter != (NUM_BLOCKS - 1)) {
-		devc->block_counter++;
+	if (devc->block_counter != NUM_BLOCKS)
 		return TRUE;
-	}
-
-	sr_dbg("Sampling finished, sending data to session bus now.");
 
-	/* All data was received and demangled, send it to the session bus. */
-	for (i = 0; i < NUM_BLOCKS; i++)
-		send_block_to_session_bus(devc, i);
+	sr_dbg("Sampling finished, all data was sent to the session bus.");
 
 	dev_acquisition_stop(sdi, sdi);
 
@@ -473,9 +480,14 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 	/* Time when we should be done (for detecting trigger timeouts). */
 	devc->done = (devc->divcount + 1) * 0.08388608 + time(NULL)
 			+ devc->trigger_timeout;
-	devc->block_counter = 0;
 	devc->trigger_found = 0;
 
+	/* Read the samples in the background while the main loop sends them. */
+	if (la8_reader_start(devc) != SR_OK) {
+		(void) la8_reset(devc); /* Ignore errors. */
+		return SR_ERR_MALLOC;
+	}
+
 	/* Hook up a dummy handler to receive data from the LA8. */
 	sr_source_add(-1, G_IO_IN, 0, receive_data, (void *)sdi);
 
@@ -486,11 +498,11 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
 {
 	struct sr_datafeed_packet packet;
 
-	(void)sdi;
-
 	sr_dbg("Stopping acquisition.");
 	sr_source_remove(-1);
 
+	la8_reader_stop(sdi->priv);
+
 	/* Send end packet to the session bus. */
 	sr_dbg("Sending SR_DF_END.");
 	packet.type = SR_DF_END;
@@ -20,6 +20,7 @@
 
 #include <ftdi.h>
 #include <glib.h>
+#include <string.h>
 #include "libsigrok.h"
 #include "libsigrok-internal.h"
 #include "protocol.h"
@@ -340,6 +341,12 @@ SR_PRIV int configure_probes(const struct sr_dev_inst *sdi)
 	sr_dbg("Trigger mask = 0x%x, trigger pattern = 0x%x.",
 	       devc->trigger_mask, devc->trigger_pattern);
 
+	/* Used to find the trigger point in the downloaded samples. */
+	sr_soft_trigger_init(&devc->trigger, 1);
+	if (devc->trigger_mask != 0x00)
+		sr_soft_trigger_add_stage(&devc->trigger, devc->trigger_mask,
+					  devc->trigger_pattern);
+
 	return SR_OK;
 }
 
@@ -372,83 +379,196 @@ SR_PRIV int set_samplerate(const struct sr_dev_inst *sdi, uint64_t samplerate)
  *
  * @param devc The struct containing private per-device-instance data. Must not
  *            be NULL. devc->ftdic must not be NULL either.
+ * @param block The block to read into, block->index must be set.
  * @return SR_OK upon success, or SR_ERR upon errors.
  */
-SR_PRIV int la8_read_block(struct dev_context *devc)
+static int la8_read_block(struct dev_context *devc, struct la8_block *block)
 {
-	int i, byte_offset, m, mi, p, index, bytes_read;
+	int bytes_read;
 	time_t now;
 
 	/* Note: Caller checked that devc and devc->ftdic != NULL. */
 
-	sr_spew("Reading block %d.", devc->block_counter);
+	sr_spew("Reading block %d.", block->index);
 
-	bytes_read = la8_read(devc, devc->mangled_buf, BS);
+	bytes_read = la8_read(devc, block->data, BS);
 
 	/* If first block read got 0 bytes, retry until success or timeout. */
-	if ((bytes_read == 0) && (devc->block_counter == 0)) {
+	if ((bytes_read == 0) && (block->index == 0)) {
 		do {
 			sr_spew("Reading block 0 (again).");
-			bytes_read = la8_read(devc, devc->mangled_buf, BS);
+			bytes_read = la8_read(devc, block->data, BS);
 			/* TODO: How to handle read errors here? */
 			now = time(NULL);
-		} while ((devc->done > now) && (bytes_read == 0));
+		} while ((devc->done > now) && (bytes_read == 0)
+			 && !g_atomic_int_get(&devc->abort));
 	}
 
 	/* Check if block read was successful or a timeout occured. */
 	if (bytes_read != BS) {
 		sr_err("Trigger timed out. Bytes read: %d.", bytes_read);
-		(void) la8_reset(devc); /* Ignore errors. */
 		return SR_ERR;
 	}
 
-	/* De-mangle the data. */
-	sr_spew("Demangling block %d.", devc->block_counter);
-	byte_offset = devc->block_counter * BS;
-	m = byte_offset / (1024 * 1024);
-	mi = m * (1024 * 1024);
+	return SR_OK;
+}
+
+/*
+ * Read all blocks from the device, so the USB transfers overlap with
+ * demangling and sending the previous blocks in the main loop.
+ */
+static gpointer la8_reader_thread(gpointer data)
+{
+	struct dev_context *devc;
+	struct la8_block *block;
+	int i;
+
+	devc = data;
+
+	for (i = 0; i < NUM_BLOCKS; i++) {
+		while (!(block = g_async_queue_timeout_pop(devc->free_blocks,
+							   100 * 1000))) {
+			if (g_atomic_int_get(&devc->abort))
+				return NULL;
+		}
+		if (g_atomic_int_get(&devc->abort)) {
+			g_async_queue_push(devc->free_blocks, block);
+			return NULL;
+		}
+
+		block->index = i;
+		block->ret = la8_read_block(devc, block);
+		g_async_queue_push(devc->read_blocks, block);
+		if (block->ret != SR_OK)
+			break;
+	}
+
+	return NULL;
+}
+
+/*
+ * Each lane's bytes come in pairs, which are swapped unless divcount is 0.
+ * The pairs of all lanes are interleaved, so the k-th pair of a block
+ * ends up 2 * NUM_LANES * k bytes from the block's first pair.
+ */
+static void la8_demangle_init(struct dev_context *devc)
+{
+	int i, p;
+
 	for (i = 0; i < BS; i++) {
 		p = i & (1 << 0);
-		index = m * 2 + (((byte_offset + i) - mi) / 2) * 16;
-		index += (devc->divcount == 0) ? p : (1 - p);
-		devc->final_buf[index] = devc->mangled_buf[i];
+		devc->demangle_offset[i] = (i / 2) * (2 * NUM_LANES)
+				+ ((devc->divcount == 0) ? p : (1 - p));
 	}
+}
+
+/**
+ * Start reading the samples from the LA8 in a separate thread.
+ *
+ * The blocks read are passed to the main loop via devc->read_blocks,
+ * and must be returned to devc->free_blocks after demangling.
+ *
+ * @param devc The struct containing private per-device-instance data. Must not
+ *            be NULL. devc->ftdic must not be NULL either.
+ * @return SR_OK upon success, SR_ERR_MALLOC upon memory allocation errors.
+ */
+SR_PRIV int la8_reader_start(struct dev_context *devc)
+{
+	int i;
+
+	la8_demangle_init(devc);
+	memset(devc->lanes_done, 0, sizeof(devc->lanes_done));
+	devc->send_block = 0;
+	devc->block_counter = 0;
+
+	if (!(devc->blocks = g_try_malloc(NUM_READ_BUFS
+					  * sizeof(struct la8_block)))) {
+		sr_err("Block buffer malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+
+	devc->free_blocks = g_async_queue_new();
+	devc->read_blocks = g_async_queue_new();
+	for (i = 0; i < NUM_READ_BUFS; i++)
+		g_async_queue_push(devc->free_blocks, &devc->blocks[i]);
+
+	g_atomic_int_set(&devc->abort, 0);
+	devc->reader = g_thread_new("chronovu-la8", la8_reader_thread, devc);
 
 	return SR_OK;
 }
 
+/**
+ * Stop the reader thread, if running, and free its buffers.
+ *
+ * @param devc The struct containing private per-device-instance data.
+ */
+SR_PRIV void la8_reader_stop(struct dev_context *devc)
+{
+	if (!devc->reader)
+		return;
+
+	g_atomic_int_set(&devc->abort, 1);
+	g_thread_join(devc->reader);
+	devc->reader = NULL;
+
+	g_async_queue_unref(devc->free_blocks);
+	g_async_queue_unref(devc->read_blocks);
+	g_free(devc->blocks);
+	devc->free_blocks = devc->read_blocks = NULL;
+	devc->blocks = NULL;
+}
+
+/**
+ * De-mangle a block into devc->final_buf, and send all samples whose
+ * range of final_buf is complete now to the session bus.
+ *
+ * @param devc The struct containing private per-device-instance data.
+ * @param block A block read by the reader thread.
+ */
+SR_PRIV void la8_demangle_block(struct dev_context *devc,
+		const struct la8_block *block)
+{
+	uint8_t *dst;
+	int lane, lane_block, i;
+
+	sr_spew("Demangling block %d.", block->index);
+
+	lane = block->index / BLOCKS_PER_LANE;
+	lane_block = block->index % BLOCKS_PER_LANE;
+	dst = devc->final_buf + lane_block * BS * NUM_LANES + lane * 2;
+	for (i = 0; i < BS; i++)
+		dst[devc->demangle_offset[i]] = block->data[i];
+
+	devc->lanes_done[lane_block]++;
+	while (devc->send_block < NUM_BLOCKS
+	       && devc->lanes_done[devc->send_block / NUM_LANES] == NUM_LANES)
+		send_block_to_session_bus(devc, devc->send_block++);
+}
+
 SR_PRIV void send_block_to_session_bus(struct dev_context *devc, int block)
 {
-	int i;
-	uint8_t sample, expected_sample;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
 	int trigger_point; /* Relative trigger point (in this block). */
 
 	/* Note: No sanity checks on devc/block, caller is responsible. */
 
-	/* Check if we can find the trigger condition in this block. */
+	/*
+	 * Check if we can find the trigger condition in this block. Don't
+	 * bother if the trigger was found previously, or if triggers are
+	 * "don't care", i.e. if no trigger conditions were specified by
+	 * the user. In that case we don't want to send an SR_DF_TRIGGER
+	 * packet at all.
+	 */
 	trigger_point = -1;
-	expected_sample = devc->trigger_pattern & devc->trigger_mask;
-	for (i = 0; i < BS; i++) {
-		/* Don't continue if the trigger was found previously. */
-		if (devc->trigger_found)
-			break;
-
-		/*
-		 * Also, don't continue if triggers are "don't care", i.e. if
-		 * no trigger conditions were specified by the user. In that
-		 * case we don't want to send an SR_DF_TRIGGER packet at all.
-		 */
-		if (devc->trigger_mask == 0x00)
-			break;
-
-		sample = *(devc->final_buf + (block * BS) + i);
-
-		if ((sample & devc->trigger_mask) == expected_sample) {
-			trigger_point = i;
+	if (!devc->trigger_found && devc->trigger.num_stages > 0) {
+		trigger_point = sr_soft_trigger_scan(&devc->trigger,
+				devc->final_buf + (block * BS), BS);
+		if (trigger_point >= 0) {
+			/* The trigger point is the matching sample itself. */
+			trigger_point--;
 			devc->trigger_found = 1;
-			break;
 		}
 	}
 
@@ -43,6 +43,26 @@
 #define BS				4096 /* Block size */
 #define NUM_BLOCKS			2048 /* Number of blocks */
 
+/*
+ * The SDRAM is read as NUM_LANES lanes of LANE_SIZE bytes each. Every
+ * 2 * NUM_LANES samples hold two consecutive bytes of each lane.
+ */
+#define LANE_SIZE			(1024 * 1024)
+#define NUM_LANES			(SDRAM_SIZE / LANE_SIZE)
+#define BLOCKS_PER_LANE			(LANE_SIZE / BS)
+
+/* Number of blocks the reader thread can get ahead of demangling. */
+#define NUM_READ_BUFS			16
+
+/** A block of (mangled) samples as read from the device. */
+struct la8_block {
+	/** Index of the block in the SDRAM. */
+	int index;
+	/** SR_OK, or the error reading the block. */
+	int ret;
+	uint8_t data[BS];
+};
+
 /* Private, per-device-instance driver context. */
 struct dev_context {
 	/** FTDI device context (used by libftdi). */
@@ -60,10 +80,25 @@ struct dev_context {
 	void *cb_data;
 
 	/**
-	 * A buffer containing some (mangled) samples from the device.
-	 * Format: Pretty mangled-up (due to hardware reasons), see code.
+	 * Buffers for (mangled) blocks from the device. They are passed from
+	 * free_blocks to the reader thread, which hands them to the main
+	 * loop via read_blocks for demangling.
 	 */
-	uint8_t mangled_buf[BS];
+	struct la8_block *blocks;
+	GAsyncQueue *free_blocks;
+	GAsyncQueue *read_blocks;
+	GThread *reader;
+	/** Set to make the reader thread stop. */
+	gint abort;
+
+	/** Where each byte of a block goes, relative to its lane. */
+	uint16_t demangle_offset[BS];
+
+	/** Number of lanes demangled for each range of NUM_LANES blocks. */
+	uint8_t lanes_done[BLOCKS_PER_LANE];
+
+	/** The next de-mangled block to send to the session bus. */
+	int send_block;
 
 	/**
 	 * An 8MB buffer where we'll store the de-mangled samples.
@@ -84,6 +119,9 @@ struct dev_context {
 	 */
 	uint8_t trigger_mask;
 
+	/** Finds the trigger point in the downloaded samples. */
+	struct sr_soft_trigger trigger;
+
 	/** Time (in seconds) before the trigger times out. */
 	uint64_t trigger_timeout;
 
@@ -93,7 +131,7 @@ struct dev_context {
 	/** TODO */
 	time_t done;
 
-	/** Counter/index for the data block to be read. */
+	/** Number of blocks demangled so far. */
 	int block_counter;
 
 	/** The divcount value (determines the sample period) for the LA8. */
@@ -117,7 +155,10 @@ SR_PRIV int la8_close_usb_reset_sequencer(struct dev_context *devc);
 SR_PRIV int la8_reset(struct dev_context *devc);
 SR_PRIV int configure_probes(const struct sr_dev_inst *sdi);
 SR_PRIV int set_samplerate(const struct sr_dev_inst *sdi, uint64_t samplerate);
-SR_PRIV int la8_read_block(struct dev_context *devc);
+SR_PRIV int la8_reader_start(struct dev_context *devc);
+SR_PRIV void la8_reader_stop(struct dev_context *devc);
+SR_PRIV void la8_demangle_block(struct dev_context *devc,
+		const struct la8_block *block);
 SR_PRIV void send_block_to_session_bus(struct dev_context *devc, int block);
 
 #endif
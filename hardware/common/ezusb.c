@@ -134,3 +134,76 @@ SR_PRIV int ezusb_upload_firmware(libusb_device *dev, int configuration,
 
 	return SR_OK;
 }
+
+/**
+ * Prepare a firmware upload for ezusb_upload_firmware_all().
+ *
+ * @private
+ */
+SR_PRIV struct ezusb_fw_upload *ezusb_fw_upload_new(libusb_device *dev,
+		int configuration, const char *filename, void *user_data)
+{
+	struct ezusb_fw_upload *upload;
+
+	if (!(upload = g_try_malloc0(sizeof(struct ezusb_fw_upload)))) {
+		sr_err("Firmware upload malloc failed.");
+		return NULL;
+	}
+	upload->dev = libusb_ref_device(dev);
+	upload->configuration = configuration;
+	upload->filename = filename;
+	upload->user_data = user_data;
+	upload->ret = SR_ERR;
+
+	return upload;
+}
+
+/** @private */
+SR_PRIV void ezusb_fw_upload_free(struct ezusb_fw_upload *upload)
+{
+	libusb_unref_device(upload->dev);
+	g_free(upload);
+}
+
+static gpointer upload_thread(gpointer data)
+{
+	struct ezusb_fw_upload *upload;
+
+	upload = data;
+	upload->ret = ezusb_upload_firmware(upload->dev, upload->configuration,
+					    upload->filename);
+	upload->done = g_get_monotonic_time();
+
+	return NULL;
+}
+
+/**
+ * Upload firmware to several devices at once, one thread per device.
+ *
+ * Returns when all uploads are done. The result and completion time of
+ * each upload are stored in its ret and done fields.
+ *
+ * @param uploads A GSList of struct ezusb_fw_upload.
+ *
+ * @private
+ */
+SR_PRIV void ezusb_upload_firmware_all(GSList *uploads)
+{
+	struct ezusb_fw_upload *upload;
+	GSList *l;
+
+	for (l = uploads; l; l = l->next) {
+		upload = l->data;
+		/* A single upload doesn't need a thread. */
+		if (!uploads->next || !(upload->thread = g_thread_try_new(
+				"ezusb", upload_thread, upload, NULL)))
+			upload_thread(upload);
+	}
+
+	for (l = uploads; l; l = l->next) {
+		upload = l->data;
+		if (upload->thread)
+			g_thread_join(upload->thread);
+		upload->thread = NULL;
+	}
+}
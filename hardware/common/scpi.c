@@ -264,6 +264,10 @@ SR_PRIV int sr_scpi_get_string(struct sr_scpi_dev_inst *scpi,
 		g_string_append_len(response, buf, len);
 	}
 
+	/* Strip the terminating linefeed, if the transport passed it on. */
+	if (response->len > 0 && response->str[response->len - 1] == '\n')
+		g_string_truncate(response, response->len - 1);
+
 	*scpi_response = response->str;
 	g_string_free(response, FALSE);
 
@@ -421,10 +425,52 @@ SR_PRIV int sr_scpi_get_opc(struct sr_scpi_dev_inst *scpi)
 	return SR_ERR;
 }
 
+/**
+ * Split a comma separated response in place.
+ *
+ * Each call returns the next token, NUL-terminated inside the response
+ * buffer, and advances *pos past it. No memory is allocated.
+ *
+ * @param pos Pointer to the current parse position, updated on return.
+ *
+ * @return The next token, or NULL when the response has been consumed.
+ */
+static char *scpi_next_token(char **pos)
+{
+	char *token, *comma;
+
+	if (!*pos)
+		return NULL;
+
+	token = *pos;
+	if ((comma = strchr(token, ','))) {
+		*comma = '\0';
+		*pos = comma + 1;
+	} else {
+		*pos = NULL;
+	}
+
+	return token;
+}
+
+/* Return the number of comma separated tokens in a response. */
+static unsigned int scpi_count_tokens(const char *response)
+{
+	unsigned int n;
+
+	for (n = 1; (response = strchr(response, ',')); response++)
+		n++;
+
+	return n;
+}
+
 /**
  * Send a SCPI command, read the reply, parse it as comma separated list of
  * floats and store the as an result in scpi_response.
  *
+ * The response is tokenized in place, so the only allocations are the
+ * response string and the result array.
+ *
  * @param scpi Previously initialised SCPI device structure.
  * @param command The SCPI command to send to the device (can be NULL).
  * @param scpi_response Pointer where to store the parsed result.
@@ -439,33 +485,27 @@ SR_PRIV int sr_scpi_get_floatv(struct sr_scpi_dev_inst *scpi,
 {
 	int ret;
 	float tmp;
-	char *response;
-	gchar **ptr, **tokens;
+	char *response, *pos, *token;
 	GArray *response_array;
 
 	ret = SR_OK;
 	response = NULL;
-	tokens = NULL;
 
 	if (sr_scpi_get_string(scpi, command, &response) != SR_OK)
 		if (!response)
 			return SR_ERR;
 
-	tokens = g_strsplit(response, ",", 0);
-	ptr = tokens;
-
-	response_array = g_array_sized_new(TRUE, FALSE, sizeof(float), 256);
+	response_array = g_array_sized_new(TRUE, FALSE, sizeof(float),
+					   scpi_count_tokens(response));
 
-	while (*ptr) {
-		if (sr_atof(*ptr, &tmp) == SR_OK)
+	pos = response;
+	while ((token = scpi_next_token(&pos))) {
+		if (sr_atof(token, &tmp) == SR_OK)
 			response_array = g_array_append_val(response_array,
 							    tmp);
 		else
 			ret = SR_ERR;
-
-		ptr++;
 	}
-	g_strfreev(tokens);
 	g_free(response);
 
 	if (ret == SR_ERR && response_array->len == 0) {
@@ -483,6 +523,9 @@ SR_PRIV int sr_scpi_get_floatv(struct sr_scpi_dev_inst *scpi,
  * Send a SCPI command, read the reply, parse it as comma separated list of
  * unsigned 8 bit integers and store the as an result in scpi_response.
  *
+ * The response is tokenized in place, so the only allocations are the
+ * response string and the result array.
+ *
  * @param scpi Previously initialised SCPI device structure.
  * @param command The SCPI command to send to the device (can be NULL).
  * @param scpi_response Pointer where to store the parsed result.
@@ -496,33 +539,27 @@ SR_PRIV int sr_scpi_get_uint8v(struct sr_scpi_dev_inst *scpi,
 			       const char *command, GArray **scpi_response)
 {
 	int tmp, ret;
-	char *response;
-	gchar **ptr, **tokens;
+	char *response, *pos, *token;
 	GArray *response_array;
 
 	ret = SR_OK;
 	response = NULL;
-	tokens = NULL;
 
 	if (sr_scpi_get_string(scpi, command, &response) != SR_OK)
 		if (!response)
 			return SR_ERR;
 
-	tokens = g_strsplit(response, ",", 0);
-	ptr = tokens;
-
-	response_array = g_array_sized_new(TRUE, FALSE, sizeof(uint8_t), 256);
+	response_array = g_array_sized_new(TRUE, FALSE, sizeof(uint8_t),
+					   scpi_count_tokens(response));
 
-	while (*ptr) {
-		if (sr_atoi(*ptr, &tmp) == SR_OK)
+	pos = response;
+	while ((token = scpi_next_token(&pos))) {
+		if (sr_atoi(token, &tmp) == SR_OK)
 			response_array = g_array_append_val(response_array,
 							    tmp);
 		else
 			ret = SR_ERR;
-
-		ptr++;
 	}
-	g_strfreev(tokens);
 	g_free(response);
 
 	if (response_array->len == 0) {
@@ -536,6 +573,468 @@ SR_PRIV int sr_scpi_get_uint8v(struct sr_scpi_dev_inst *scpi,
 	return ret;
 }
 
+/* Longest compound message sent, which all known devices accept. */
+#define SCPI_BATCH_MAX_LEN 200
+
+/** A command or query of a batch, see sr_scpi_batch_add(). */
+struct scpi_batch_entry {
+	char *command;
+	int type;
+	void *result;
+};
+
+struct sr_scpi_batch {
+	GArray *entries;
+};
+
+/**
+ * Create a new, empty batch of SCPI commands and queries.
+ *
+ * @return The batch, to be freed with sr_scpi_batch_free().
+ */
+SR_PRIV struct sr_scpi_batch *sr_scpi_batch_new(void)
+{
+	struct sr_scpi_batch *batch;
+
+	batch = g_malloc(sizeof(struct sr_scpi_batch));
+	batch->entries = g_array_new(FALSE, FALSE,
+				     sizeof(struct scpi_batch_entry));
+
+	return batch;
+}
+
+/**
+ * Add a command or query to a batch.
+ *
+ * The result of a query is parsed according to type, and stored where
+ * result points to once the batch has been run: a gboolean for
+ * SCPI_BATCH_BOOL, an int for SCPI_BATCH_INT, a float for
+ * SCPI_BATCH_FLOAT, a double for SCPI_BATCH_DOUBLE, or a newly allocated
+ * string (char *) for SCPI_BATCH_STRING. Commands without a reply use
+ * SCPI_BATCH_CMD and a NULL result.
+ *
+ * Queries returning a block must not be batched.
+ *
+ * @param batch The batch.
+ * @param type SCPI_BATCH_CMD, SCPI_BATCH_BOOL, ...
+ * @param result Where to store the result.
+ * @param format Format string of the command, followed by its arguments.
+ */
+SR_PRIV void sr_scpi_batch_add(struct sr_scpi_batch *batch, int type,
+		void *result, const char *format, ...)
+{
+	struct scpi_batch_entry entry;
+	va_list args;
+
+	va_start(args, format);
+	entry.command = g_strdup_vprintf(format, args);
+	va_end(args);
+	entry.type = type;
+	entry.result = result;
+	g_array_append_val(batch->entries, entry);
+}
+
+/**
+ * Free a batch. Strings returned by its queries are left alone.
+ *
+ * @param batch The batch.
+ */
+SR_PRIV void sr_scpi_batch_free(struct sr_scpi_batch *batch)
+{
+	unsigned int i;
+
+	for (i = 0; i < batch->entries->len; i++)
+		g_free(g_array_index(batch->entries,
+				     struct scpi_batch_entry, i).command);
+	g_array_free(batch->entries, TRUE);
+	g_free(batch);
+}
+
+static int scpi_batch_parse(const struct scpi_batch_entry *entry,
+		const char *response)
+{
+	int ret;
+
+	sr_spew("Received '%s' for '%s'.", response, entry->command);
+
+	switch (entry->type) {
+	case SCPI_BATCH_BOOL:
+		ret = parse_strict_bool(response, entry->result);
+		break;
+	case SCPI_BATCH_INT:
+		ret = sr_atoi(response, entry->result);
+		break;
+	case SCPI_BATCH_FLOAT:
+		ret = sr_atof(response, entry->result);
+		break;
+	case SCPI_BATCH_DOUBLE:
+		ret = sr_atod(response, entry->result);
+		break;
+	case SCPI_BATCH_STRING:
+		*(char **)entry->result = g_strdup(response);
+		ret = SR_OK;
+		break;
+	default:
+		ret = SR_ERR_BUG;
+	}
+
+	if (ret != SR_OK)
+		sr_err("Failed to parse response '%s' to '%s'.",
+		       response, entry->command);
+
+	return ret;
+}
+
+/*
+ * Split the reply to a compound query into its responses, in place.
+ * Semicolons inside quoted strings don't separate responses.
+ */
+static char *scpi_next_response(char **pos)
+{
+	char *response, *s, quote;
+
+	if (!*pos)
+		return NULL;
+
+	response = *pos;
+	quote = 0;
+	for (s = response; *s; s++) {
+		if (quote) {
+			if (*s == quote)
+				quote = 0;
+		} else if (*s == '"' || *s == '\'') {
+			quote = *s;
+		} else if (*s == ';') {
+			break;
+		}
+	}
+
+	if (*s) {
+		*s = '\0';
+		*pos = s + 1;
+	} else {
+		*pos = NULL;
+	}
+
+	return response;
+}
+
+/* Send entries first to last as one message, and parse the reply. */
+static int scpi_batch_send(struct sr_scpi_dev_inst *scpi,
+		const struct sr_scpi_batch *batch, unsigned int first,
+		unsigned int last)
+{
+	const struct scpi_batch_entry *entry;
+	GString *msg;
+	unsigned int i;
+	int num_queries, ret;
+	char *reply, *pos, *response;
+
+	msg = g_string_sized_new(SCPI_BATCH_MAX_LEN);
+	num_queries = 0;
+	for (i = first; i <= last; i++) {
+		entry = &g_array_index(batch->entries,
+				       struct scpi_batch_entry, i);
+		if (i > first)
+			g_string_append_c(msg, ';');
+		g_string_append(msg, entry->command);
+		if (entry->type != SCPI_BATCH_CMD)
+			num_queries++;
+	}
+
+	if (!num_queries) {
+		ret = sr_scpi_send(scpi, "%s", msg->str);
+		g_string_free(msg, TRUE);
+		return ret;
+	}
+
+	reply = NULL;
+	if (sr_scpi_get_string(scpi, msg->str, &reply) != SR_OK) {
+		g_free(reply);
+		g_string_free(msg, TRUE);
+		return SR_ERR;
+	}
+
+	ret = SR_OK;
+	pos = reply;
+	for (i = first; i <= last && ret == SR_OK; i++) {
+		entry = &g_array_index(batch->entries,
+				       struct scpi_batch_entry, i);
+		if (entry->type == SCPI_BATCH_CMD)
+			continue;
+		if (!(response = scpi_next_response(&pos))) {
+			sr_err("Too few responses to '%s'.", msg->str);
+			ret = SR_ERR;
+			break;
+		}
+		ret = scpi_batch_parse(entry, response);
+	}
+	if (ret == SR_OK && pos) {
+		sr_err("Too many responses to '%s'.", msg->str);
+		ret = SR_ERR;
+	}
+
+	g_free(reply);
+	g_string_free(msg, TRUE);
+
+	return ret;
+}
+
+/**
+ * Run all commands and queries of a batch, in the order they were added.
+ *
+ * With compound set, as many of them as fit are joined with semicolons
+ * into IEEE 488.2 compound messages, each of which takes just one round
+ * trip to the device. Every command should then start with a colon, or
+ * it is relative to the subsystem of the previous one. Otherwise, every
+ * query is sent and answered on its own.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param batch The batch.
+ * @param compound Whether the device supports compound messages.
+ *
+ * @return SR_OK on success, SR_ERR on failure. Results of queries are
+ *         only stored for the ones answered before a failure.
+ */
+SR_PRIV int sr_scpi_batch_run(struct sr_scpi_dev_inst *scpi,
+		struct sr_scpi_batch *batch, gboolean compound)
+{
+	const struct scpi_batch_entry *entry;
+	unsigned int first, i;
+	size_t len;
+
+	first = 0;
+	len = 0;
+	for (i = 0; i < batch->entries->len; i++) {
+		entry = &g_array_index(batch->entries,
+				       struct scpi_batch_entry, i);
+		/* Start a new message if this entry doesn't fit anymore. */
+		if (i > first && (!compound || len + 1
+				  + strlen(entry->command) > SCPI_BATCH_MAX_LEN)) {
+			if (scpi_batch_send(scpi, batch, first, i - 1) != SR_OK)
+				return SR_ERR;
+			first = i;
+			len = 0;
+		}
+		len += (i > first ? 1 : 0) + strlen(entry->command);
+	}
+
+	if (i > first && scpi_batch_send(scpi, batch, first, i - 1) != SR_OK)
+		return SR_ERR;
+
+	return SR_OK;
+}
+
+/**
+ * Prepare a block parser for a new IEEE 488.2 definite length arbitrary
+ * block ("#<n><length><data>").
+ *
+ * @param block Block parser state to initialize.
+ */
+SR_PRIV void sr_scpi_block_init(struct sr_scpi_block *block)
+{
+	block->header_len = 0;
+	block->length = -1;
+	block->pos = 0;
+}
+
+/**
+ * Read part of a definite length block.
+ *
+ * The header is parsed as it arrives, possibly across several calls, and
+ * the block data is read directly into the caller's buffer. Nothing is
+ * allocated. When the header is not complete yet, or no data is
+ * available at the moment, 0 is returned.
+ *
+ * Only the data is read, the terminating linefeed (if any) is left for
+ * the caller to discard.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param block Block parser state, see sr_scpi_block_init().
+ * @param buf Buffer to store block data.
+ * @param maxlen Maximum number of data bytes to read.
+ *
+ * @return Number of data bytes read, or SR_ERR upon failure.
+ */
+SR_PRIV int sr_scpi_block_read(struct sr_scpi_dev_inst *scpi,
+		struct sr_scpi_block *block, char *buf, int maxlen)
+{
+	int len, need;
+
+	while (block->length < 0) {
+		/* A '#', then a digit giving the number of length digits. */
+		if (block->header_len < 2)
+			need = 2 - block->header_len;
+		else
+			need = 2 + (block->header[1] - '0') - block->header_len;
+
+		if (need > 0) {
+			len = sr_scpi_read_data(scpi,
+					block->header + block->header_len, need);
+			if (len <= 0)
+				return len;
+			block->header_len += len;
+			if (block->header_len < 2)
+				continue;
+			if (block->header[0] != '#'
+			    || !g_ascii_isdigit(block->header[1])
+			    || block->header[1] == '0') {
+				sr_err("Invalid block header start '%c%c'.",
+				       block->header[0], block->header[1]);
+				return SR_ERR;
+			}
+			continue;
+		}
+
+		block->header[block->header_len] = '\0';
+		if (sr_atoi(block->header + 2, &block->length) != SR_OK
+		    || block->length < 0) {
+			sr_err("Invalid block header '%s'.", block->header);
+			block->length = -1;
+			return SR_ERR;
+		}
+		sr_dbg("Block header '%s', %d bytes.", block->header,
+		       block->length);
+	}
+
+	if ((len = block->length - block->pos) > maxlen)
+		len = maxlen;
+	if (len == 0)
+		return 0;
+
+	if ((len = sr_scpi_read_data(scpi, buf, len)) > 0)
+		block->pos += len;
+
+	return len;
+}
+
+/**
+ * Check whether all data of a definite length block has been read.
+ *
+ * @param block Block parser state.
+ *
+ * @return TRUE if complete, FALSE otherwise.
+ */
+SR_PRIV gboolean sr_scpi_block_complete(const struct sr_scpi_block *block)
+{
+	return block->length >= 0 && block->pos == block->length;
+}
+
+/**
+ * Read a definite length block, waiting for slow transports.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param block Block parser state.
+ * @param buf Buffer to store block data, or NULL to only parse the header.
+ * @param maxlen Size of buf.
+ *
+ * @return SR_OK on success, SR_ERR on failure or timeout.
+ */
+static int scpi_block_read_all(struct sr_scpi_dev_inst *scpi,
+		struct sr_scpi_block *block, char *buf, int maxlen)
+{
+	int len, retries;
+
+	retries = 0;
+	while (buf ? !sr_scpi_block_complete(block) : block->length < 0) {
+		if (buf)
+			len = sr_scpi_block_read(scpi, block, buf + block->pos,
+					maxlen - block->pos);
+		else
+			len = sr_scpi_block_read(scpi, block, NULL, 0);
+		if (len < 0)
+			return SR_ERR;
+		if (len > 0) {
+			retries = 0;
+		} else if (++retries > SCPI_READ_RETRIES) {
+			sr_err("Timeout while reading data block.");
+			return SR_ERR;
+		} else {
+			g_usleep(SCPI_READ_RETRY_TIMEOUT);
+		}
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Read the header of a definite length block, waiting for slow transports.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param block Block parser state, see sr_scpi_block_init().
+ *
+ * @return The block length in bytes, or SR_ERR upon failure.
+ */
+SR_PRIV int sr_scpi_block_read_header(struct sr_scpi_dev_inst *scpi,
+		struct sr_scpi_block *block)
+{
+	if (scpi_block_read_all(scpi, block, NULL, 0) != SR_OK)
+		return SR_ERR;
+
+	return block->length;
+}
+
+/**
+ * Send a SCPI command, read the reply, parse it as an IEEE 488.2 definite
+ * length arbitrary block ("#<n><length><data>") and store the block data
+ * in scpi_response.
+ *
+ * Unlike the text based getters, this never looks at the content of the
+ * data bytes, so it is safe to use for binary waveform transfers. The
+ * caller provides the array, which is resized to the block length; when
+ * it is reused across calls, no allocations happen once it has grown to
+ * the block size.
+ *
+ * @param scpi Previously initialised SCPI device structure.
+ * @param command The SCPI command to send to the device (can be NULL).
+ * @param scpi_response Byte array where to store the block data.
+ *
+ * @return SR_OK on success, SR_ERR on failure.
+ */
+SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
+			       const char *command, GByteArray *scpi_response)
+{
+	struct sr_scpi_block block;
+	char c;
+	int len;
+
+	g_byte_array_set_size(scpi_response, 0);
+
+	if (command)
+		if (sr_scpi_send(scpi, command) != SR_OK)
+			return SR_ERR;
+
+	if (sr_scpi_read_begin(scpi) != SR_OK)
+		return SR_ERR;
+
+	sr_scpi_block_init(&block);
+	if ((len = sr_scpi_block_read_header(scpi, &block)) < 0)
+		return SR_ERR;
+
+	g_byte_array_set_size(scpi_response, len);
+	if (scpi_block_read_all(scpi, &block, (char *)scpi_response->data,
+				len) != SR_OK) {
+		g_byte_array_set_size(scpi_response, 0);
+		return SR_ERR;
+	}
+
+	/*
+	 * Consume the terminating linefeed. Unframed transports always pass
+	 * exactly one on, and can't tell it from the last data byte. The
+	 * others strip it, or know whether it is still pending, so only
+	 * wait for it then.
+	 */
+	for (len = 0; len <= SCPI_READ_RETRIES; len++) {
+		if (!scpi->unframed && sr_scpi_read_complete(scpi))
+			break;
+		if (sr_scpi_read_data(scpi, &c, 1) != 0)
+			break;
+		g_usleep(SCPI_READ_RETRY_TIMEOUT);
+	}
+
+	return SR_OK;
+}
+
 /**
  * Send the *IDN? SCPI command, receive the reply, parse it and store the
  * reply as a sr_scpi_hw_info structure in the supplied scpi_response pointer.
@@ -165,11 +165,12 @@ SR_PRIV int scpi_serial_read_data(void *priv, char *buf, int maxlen)
 	if (ret < 0)
 		return ret;
 
-	if (ret > 0) {
+	/*
+	 * The terminating linefeed is passed on, since it can't be told
+	 * apart from a 0x0a byte in binary block data at this level.
+	 */
+	if (ret > 0)
 		sscpi->last_character = buf[ret - 1];
-		if (sscpi->last_character == '\n')
-			ret--;
-	}
 
 	return ret;
 }
@@ -224,6 +225,7 @@ SR_PRIV struct sr_scpi_dev_inst *scpi_serial_dev_inst_new(const char *port,
 	scpi->close = scpi_serial_close;
 	scpi->free = scpi_serial_free;
 	scpi->priv = sscpi;
+	scpi->unframed = TRUE;
 
 	return scpi;
 }
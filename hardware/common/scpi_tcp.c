@@ -231,6 +231,7 @@ SR_PRIV struct sr_scpi_dev_inst *scpi_tcp_dev_inst_new(const char *address,
 	scpi->close = scpi_tcp_close;
 	scpi->free = scpi_tcp_free;
 	scpi->priv = tcp;
+	scpi->unframed = FALSE;
 
 	return scpi;
 }
@@ -189,6 +189,7 @@ SR_PRIV struct sr_scpi_dev_inst *scpi_usbtmc_dev_inst_new(const char *device)
 	scpi->close = scpi_usbtmc_close;
 	scpi->free = scpi_usbtmc_free;
 	scpi->priv = uscpi;
+	scpi->unframed = FALSE;
 
 	return scpi;
 }
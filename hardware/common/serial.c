@@ -232,7 +232,7 @@ SR_PRIV int serial_write_nonblocking(struct sr_serial_dev_inst *serial,
 }
 
 static int _serial_read(struct sr_serial_dev_inst *serial, void *buf,
-		size_t count, int nonblocking)
+		size_t count, int nonblocking, unsigned int timeout_ms)
 {
 	ssize_t ret;
 	char *error;
@@ -250,7 +250,7 @@ static int _serial_read(struct sr_serial_dev_inst *serial, void *buf,
 	if (nonblocking)
 		ret = sp_nonblocking_read(serial->data, buf, count);
 	else
-		ret = sp_blocking_read(serial->data, buf, count, 0);
+		ret = sp_blocking_read(serial->data, buf, count, timeout_ms);
 
 	switch (ret) {
 	case SP_ERR_ARG:
@@ -281,19 +281,19 @@ static int _serial_read(struct sr_serial_dev_inst *serial, void *buf,
 SR_PRIV int serial_read(struct sr_serial_dev_inst *serial, void *buf,
 		size_t count)
 {
-	return _serial_read(serial, buf, count, serial->nonblocking);
+	return _serial_read(serial, buf, count, serial->nonblocking, 0);
 }
 
 SR_PRIV int serial_read_blocking(struct sr_serial_dev_inst *serial, void *buf,
 		size_t count)
 {
-	return _serial_read(serial, buf, count, 0);
+	return _serial_read(serial, buf, count, 0, 0);
 }
 
 SR_PRIV int serial_read_nonblocking(struct sr_serial_dev_inst *serial, void *buf,
 		size_t count)
 {
-	return _serial_read(serial, buf, count, 1);
+	return _serial_read(serial, buf, count, 1, 0);
 }
 
 /**
@@ -550,90 +550,179 @@ SR_PRIV int serial_readline(struct sr_serial_dev_inst *serial, char **buf,
 	return SR_OK;
 }
 
+/*
+ * Read whatever is already buffered (up to maxlen bytes), then block
+ * until at least minlen bytes have been read in total or timeout_ms
+ * has passed. Returns the number of bytes read, or a negative error.
+ */
+static int serial_read_bulk(struct sr_serial_dev_inst *serial, uint8_t *buf,
+		size_t minlen, size_t maxlen, unsigned int timeout_ms)
+{
+	int len, ret;
+
+	if ((len = _serial_read(serial, buf, maxlen, 1, 0)) < 0)
+		return len;
+	if ((size_t)len >= minlen || timeout_ms == 0)
+		return len;
+
+	if ((ret = _serial_read(serial, buf + len, minlen - len,
+				0, timeout_ms)) < 0)
+		return ret;
+
+	return len + ret;
+}
+
 /**
- * Try to find a valid packet in a serial data stream.
+ * Try to find a valid packet of one of several formats in a serial data
+ * stream.
+ *
+ * Data is read in bulk: everything the port has buffered is taken at
+ * once, and when more bytes are needed the read blocks (up to the
+ * remaining timeout) until the next candidate packet of any format can
+ * be checked. Each format is checked at every offset of the buffer, so
+ * a single pass over the stream probes all of them.
+ *
+ * The first format has priority: a packet of any other format is only
+ * reported once the first one has been checked over the whole buffer
+ * (or the timeout hit), so a short packet of another format can't hide
+ * a longer one of the first format which hasn't fully arrived yet.
  *
  * @param serial Previously initialized serial port structure.
- * @param buf Buffer containing the bytes to write.
- * @param buflen Size of the buffer.
- * @param[in] packet_size Size, in bytes, of a valid packet.
- * @param is_valid Callback that assesses whether the packet is valid or not.
- * @param[in] timeout_ms The timeout after which, if no packet is detected, to
- *                   abort scanning.
- * @param[in] baudrate The baudrate of the serial port. This parameter is not
- *                 critical, but it helps fine tune the serial port polling
- *                 delay.
+ * @param buf Buffer where to store the bytes that are read.
+ * @param[in,out] buflen Size of the buffer. On return, the offset just
+ *                past the packet if it is of the first format, otherwise
+ *                the number of bytes read.
+ * @param formats Candidate packet formats, the first one taking
+ *                priority.
+ * @param num_formats Number of entries in formats.
+ * @param[in] timeout_ms The timeout after which, if no packet is detected,
+ *                   to abort scanning.
  *
- * @retval SR_OK Valid packet was found within the given timeout
- * @retval SR_ERR Failure.
+ * @return The index into formats of the packet found, or SR_ERR if no
+ *         valid packet was found within the given timeout.
+ *
+ * @private
  */
-SR_PRIV int serial_stream_detect(struct sr_serial_dev_inst *serial,
-				 uint8_t *buf, size_t *buflen,
-				 size_t packet_size, packet_valid_t is_valid,
-				 uint64_t timeout_ms, int baudrate)
+SR_PRIV int serial_stream_detect_multi(struct sr_serial_dev_inst *serial,
+		uint8_t *buf, size_t *buflen,
+		const struct serial_packet_format *formats, int num_formats,
+		uint64_t timeout_ms)
 {
-	uint64_t start, time, byte_delay_us;
-	size_t ibuf, i, maxlen;
-	int len;
+	size_t ibuf, maxlen, need, offset[SERIAL_MAX_PACKET_FORMATS];
+	uint64_t start, elapsed;
+	int len, f, found, active;
 
 	maxlen = *buflen;
 
-	sr_dbg("Detecting packets on %s (timeout = %" PRIu64
-	       "ms, baudrate = %d).", serial->port, timeout_ms, baudrate);
+	if (num_formats < 1 || num_formats > SERIAL_MAX_PACKET_FORMATS) {
+		sr_err("Invalid number of packet formats: %d.", num_formats);
+		return SR_ERR_ARG;
+	}
 
-	if (maxlen < (packet_size / 2) ) {
-		sr_err("Buffer size must be at least twice the packet size.");
-		return SR_ERR;
+	for (f = 0; f < num_formats; f++) {
+		if (maxlen < (formats[f].packet_size / 2)) {
+			sr_err("Buffer size must be at least twice the packet size.");
+			return SR_ERR;
+		}
+		offset[f] = 0;
 	}
 
-	/* Assume 8n1 transmission. That is 10 bits for every byte. */
-	byte_delay_us = 10 * (1000000 / baudrate);
-	start = g_get_monotonic_time();
+	sr_dbg("Detecting %d packet format(s) on %s (timeout = %" PRIu64
+	       "ms).", num_formats, serial->port, timeout_ms);
 
-	i = ibuf = len = 0;
+	start = g_get_monotonic_time();
+	ibuf = 0;
+	elapsed = 0;
+	/* First packet of another format than the first, if any. */
+	found = -1;
+	active = num_formats;
 	while (ibuf < maxlen) {
-		len = serial_read(serial, &buf[ibuf], 1);
-		if (len > 0) {
-			ibuf += len;
-		} else if (len == 0) {
-			/* No logging, already done in serial_read(). */
-		} else {
-			/* Error reading byte, but continuing anyway. */
+		/* Block only for the bytes completing the next candidate. */
+		need = maxlen - ibuf;
+		for (f = 0; f < active; f++) {
+			if (offset[f] + formats[f].packet_size - ibuf < need)
+				need = offset[f] + formats[f].packet_size - ibuf;
 		}
 
-		time = g_get_monotonic_time() - start;
-		time /= 1000;
+		len = serial_read_bulk(serial, &buf[ibuf], need, maxlen - ibuf,
+				       timeout_ms - elapsed);
+		if (len > 0)
+			ibuf += len;
+		/* On error, keep trying until the timeout. */
 
-		if ((ibuf - i) >= packet_size) {
-			/* We have at least a packet's worth of data. */
-			if (is_valid(&buf[i])) {
-				sr_spew("Found valid %d-byte packet after "
-					"%" PRIu64 "ms.", (ibuf - i), time);
-				*buflen = ibuf;
-				return SR_OK;
-			} else {
-				sr_spew("Got %d bytes, but not a valid "
-					"packet.", (ibuf - i));
+		for (f = 0; f < active; f++) {
+			while (offset[f] + formats[f].packet_size <= ibuf) {
+				if (formats[f].is_valid(&buf[offset[f]]))
+					break;
+				offset[f]++;
+			}
+			if (offset[f] + formats[f].packet_size > ibuf)
+				continue;
+			sr_spew("Found valid %zu-byte packet (format %d) at "
+				"offset %zu.", formats[f].packet_size, f,
+				offset[f]);
+			if (f == 0) {
+				*buflen = offset[f] + formats[f].packet_size;
+				return 0;
 			}
-			/* Not a valid packet. Continue searching. */
-			i++;
+			/* Keep looking for the first format only. */
+			found = f;
+			active = 1;
 		}
-		if (time >= timeout_ms) {
-			/* Timeout */
-			sr_dbg("Detection timed out after %dms.", time);
+
+		elapsed = (g_get_monotonic_time() - start) / 1000;
+		if (elapsed >= timeout_ms) {
+			sr_dbg("Detection timed out after %" PRIu64 "ms.",
+			       elapsed);
 			break;
 		}
-		if (len < 1)
-			g_usleep(byte_delay_us);
+		if (len < 0)
+			g_usleep(1000);
 	}
 
 	*buflen = ibuf;
 
-	sr_err("Didn't find a valid packet (read %d bytes).", *buflen);
+	if (found >= 0)
+		return found;
+
+	sr_err("Didn't find a valid packet (read %zu bytes).", ibuf);
 
 	return SR_ERR;
 }
 
+/**
+ * Try to find a valid packet in a serial data stream.
+ *
+ * @param serial Previously initialized serial port structure.
+ * @param buf Buffer where to store the bytes that are read.
+ * @param buflen Size of the buffer.
+ * @param[in] packet_size Size, in bytes, of a valid packet.
+ * @param is_valid Callback that assesses whether the packet is valid or not.
+ * @param[in] timeout_ms The timeout after which, if no packet is detected, to
+ *                   abort scanning.
+ * @param[in] baudrate The baudrate of the serial port. Only used for
+ *                 logging, reads block until data arrives.
+ *
+ * @retval SR_OK Valid packet was found within the given timeout
+ * @retval SR_ERR Failure.
+ */
+SR_PRIV int serial_stream_detect(struct sr_serial_dev_inst *serial,
+				 uint8_t *buf, size_t *buflen,
+				 size_t packet_size, packet_valid_t is_valid,
+				 uint64_t timeout_ms, int baudrate)
+{
+	struct serial_packet_format format;
+
+	sr_dbg("Detecting packets on %s (baudrate = %d).", serial->port,
+	       baudrate);
+
+	format.packet_size = packet_size;
+	format.is_valid = is_valid;
+
+	return serial_stream_detect_multi(serial, buf, buflen, &format, 1,
+					  timeout_ms) < 0 ? SR_ERR : SR_OK;
+}
+
 /**
  * Extract the serial device and options from the options linked list.
  *
@@ -0,0 +1,243 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+#include <glib.h>
+#include "libsigrok.h"
+#include "libsigrok-internal.h"
+
+#define LOG_PREFIX "trigger"
+
+/* Every byte (or 16-bit lane) of a 64-bit word set to 1, resp. its MSB. */
+#define ONES_8		0x0101010101010101ULL
+#define HIGHS_8		0x8080808080808080ULL
+#define ONES_16		0x0001000100010001ULL
+#define HIGHS_16	0x8000800080008000ULL
+
+/**
+ * Initialize a software trigger without any stages.
+ *
+ * @param st The trigger.
+ * @param unitsize Size of a sample in bytes, 1 or 2. 16-bit samples
+ *                 are little endian.
+ *
+ * @private
+ */
+SR_PRIV void sr_soft_trigger_init(struct sr_soft_trigger *st, int unitsize)
+{
+	memset(st, 0, sizeof(struct sr_soft_trigger));
+	st->unitsize = unitsize;
+}
+
+/**
+ * Append a stage to a software trigger.
+ *
+ * The trigger fires on consecutive samples matching all stages in order.
+ * A sample matches a stage if (sample & mask) == value.
+ *
+ * @private
+ */
+SR_PRIV int sr_soft_trigger_add_stage(struct sr_soft_trigger *st,
+		uint16_t mask, uint16_t value)
+{
+	if (st->num_stages == SR_SOFT_TRIGGER_MAX_STAGES) {
+		sr_err("Too many trigger stages.");
+		return SR_ERR_ARG;
+	}
+
+	if (st->unitsize == 1)
+		mask &= 0xff;
+	st->mask[st->num_stages] = mask;
+	st->value[st->num_stages] = value & mask;
+	st->num_stages++;
+
+	return SR_OK;
+}
+
+/**
+ * Rearm a software trigger, discarding any partial match.
+ *
+ * @private
+ */
+SR_PRIV void sr_soft_trigger_reset(struct sr_soft_trigger *st)
+{
+	st->stage = 0;
+}
+
+static inline uint16_t get_sample(const struct sr_soft_trigger *st,
+		const uint8_t *buf, int i)
+{
+	return st->unitsize == 2 ? RL16(buf + 2 * i) : buf[i];
+}
+
+static inline gboolean stage_match(const struct sr_soft_trigger *st,
+		int stage, uint16_t sample)
+{
+	return (sample & st->mask[stage]) == st->value[stage];
+}
+
+static void set_matched(struct sr_soft_trigger *st, int stage, uint16_t sample)
+{
+	if (st->unitsize == 2) {
+		st->matched[2 * stage] = sample & 0xff;
+		st->matched[2 * stage + 1] = sample >> 8;
+	} else {
+		st->matched[stage] = sample;
+	}
+}
+
+static uint64_t replicate(const struct sr_soft_trigger *st, uint16_t v)
+{
+	if (st->unitsize == 2) {
+#ifdef WORDS_BIGENDIAN
+		/* Samples are little endian, so swap the bytes of each lane. */
+		v = (v >> 8) | (v << 8);
+#endif
+		return ONES_16 * v;
+	}
+
+	return ONES_8 * (v & 0xff);
+}
+
+/*
+ * Return the index of the first sample at or after start matching the
+ * first stage, or num_samples if there is none.
+ *
+ * Eight bytes are checked at once: after masking and XORing with the
+ * expected value, a matching sample is a zero lane, which the classic
+ * (x - ones) & ~x & highs test detects for all lanes in one go. Only
+ * words containing a candidate are then looked at sample by sample.
+ */
+static int find_first_stage(const struct sr_soft_trigger *st,
+		const uint8_t *buf, int start, int num_samples)
+{
+	uint64_t mask, value, ones, highs, w;
+	int i, step;
+
+	mask = replicate(st, st->mask[0]);
+	value = replicate(st, st->value[0]);
+	ones = st->unitsize == 2 ? ONES_16 : ONES_8;
+	highs = st->unitsize == 2 ? HIGHS_16 : HIGHS_8;
+	step = 8 / st->unitsize;
+
+	for (i = start; i + step <= num_samples; i += step) {
+		memcpy(&w, buf + i * st->unitsize, sizeof(w));
+		w = (w & mask) ^ value;
+		if ((w - ones) & ~w & highs)
+			break;
+	}
+
+	for (; i < num_samples; i++) {
+		if (stage_match(st, 0, get_sample(st, buf, i)))
+			return i;
+	}
+
+	return num_samples;
+}
+
+/*
+ * Retry partial matches carried over from the previous buffer, starting
+ * at each of the carried samples in turn. Returns the offset just past
+ * the trigger in buf if it fired, -1 otherwise. If a partial match still
+ * runs up to the end of buf, it is carried over again.
+ */
+static int scan_carried(struct sr_soft_trigger *st, const uint8_t *buf,
+		int num_samples)
+{
+	uint16_t seq[2 * SR_SOFT_TRIGGER_MAX_STAGES];
+	int carried, len, start, stage, i;
+
+	carried = st->stage;
+	for (i = 0; i < carried; i++)
+		seq[i] = st->unitsize == 2 ? RL16(st->matched + 2 * i)
+					   : st->matched[i];
+	len = carried;
+	for (i = 0; i < num_samples && i < st->num_stages; i++)
+		seq[len++] = get_sample(st, buf, i);
+
+	st->stage = 0;
+	for (start = 0; start < carried; start++) {
+		for (stage = 0; stage < st->num_stages
+				&& start + stage < len; stage++) {
+			if (!stage_match(st, stage, seq[start + stage]))
+				break;
+		}
+		if (stage < st->num_stages && start + stage < len)
+			continue;
+
+		for (i = 0; i < stage; i++)
+			set_matched(st, i, seq[start + i]);
+		st->stage = stage;
+		if (stage == st->num_stages)
+			return start + stage - carried;
+		/* Ran out of samples, keep the partial match. */
+		return -1;
+	}
+
+	return -1;
+}
+
+/**
+ * Scan a buffer of samples for the trigger.
+ *
+ * Partial matches at the end of the buffer are carried over to the
+ * next call. Once the trigger has fired, the samples matching each
+ * stage are in st->matched, some of them possibly from earlier buffers.
+ *
+ * @param st The trigger. A trigger without stages fires right away.
+ * @param buf The samples.
+ * @param num_samples Number of samples in buf.
+ *
+ * @return The offset (in samples) just past the last sample matching
+ *         the trigger, or -1 if the trigger did not fire.
+ *
+ * @private
+ */
+SR_PRIV int sr_soft_trigger_scan(struct sr_soft_trigger *st,
+		const uint8_t *buf, int num_samples)
+{
+	int ret, start, stage, i, k;
+
+	if (st->num_stages == 0)
+		return 0;
+
+	if (st->stage > 0) {
+		if ((ret = scan_carried(st, buf, num_samples)) >= 0)
+			return ret;
+		if (st->stage > 0)
+			return -1;
+	}
+
+	start = 0;
+	while ((i = find_first_stage(st, buf, start, num_samples))
+			< num_samples) {
+		for (stage = 1; stage < st->num_stages
+				&& i + stage < num_samples; stage++) {
+			if (!stage_match(st, stage, get_sample(st, buf, i + stage)))
+				break;
+		}
+		if (stage == st->num_stages || i + stage == num_samples) {
+			for (k = 0; k < stage; k++)
+				set_matched(st, k, get_sample(st, buf, i + k));
+			st->stage = stage;
+			return stage == st->num_stages ? i + stage : -1;
+		}
+		start = i + 1;
+	}
+
+	return -1;
+}
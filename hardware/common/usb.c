@@ -22,6 +22,14 @@
 #include <stdlib.h>
 #include <glib.h>
 #include <libusb.h>
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#endif
 #include "libsigrok.h"
 #include "libsigrok-internal.h"
 
@@ -35,6 +43,93 @@
 
 #define LOG_PREFIX "usb"
 
+/* Device list shared by all drivers during sr_driver_scan_all(). */
+static struct {
+	libusb_context *usb_ctx;
+	libusb_device **devlist;
+	ssize_t count;
+} devlist_snapshot;
+G_LOCK_DEFINE_STATIC(devlist_snapshot);
+
+/**
+ * Enumerate the USB bus once, for all following sr_usb_get_device_list()
+ * calls until usb_devlist_snapshot_release().
+ *
+ * @return The number of devices, or a libusb error code.
+ *
+ * @private
+ */
+SR_PRIV ssize_t usb_devlist_snapshot_take(libusb_context *usb_ctx)
+{
+	libusb_device **devlist;
+	ssize_t count;
+
+	if ((count = libusb_get_device_list(usb_ctx, &devlist)) < 0) {
+		sr_err("Failed to retrieve device list: %s.",
+		       libusb_error_name(count));
+		return count;
+	}
+
+	G_LOCK(devlist_snapshot);
+	if (devlist_snapshot.devlist)
+		libusb_free_device_list(devlist_snapshot.devlist, 1);
+	devlist_snapshot.usb_ctx = usb_ctx;
+	devlist_snapshot.devlist = devlist;
+	devlist_snapshot.count = count;
+	G_UNLOCK(devlist_snapshot);
+
+	return count;
+}
+
+/** @private */
+SR_PRIV void usb_devlist_snapshot_release(void)
+{
+	G_LOCK(devlist_snapshot);
+	if (devlist_snapshot.devlist)
+		libusb_free_device_list(devlist_snapshot.devlist, 1);
+	devlist_snapshot.usb_ctx = NULL;
+	devlist_snapshot.devlist = NULL;
+	devlist_snapshot.count = 0;
+	G_UNLOCK(devlist_snapshot);
+}
+
+/**
+ * Get the list of USB devices, like libusb_get_device_list().
+ *
+ * While sr_driver_scan_all() runs, this returns a copy of the list it
+ * enumerated up front, so concurrently scanning drivers don't each walk
+ * the bus again. The list must be freed with libusb_free_device_list().
+ *
+ * @private
+ */
+SR_PRIV ssize_t sr_usb_get_device_list(libusb_context *usb_ctx,
+		libusb_device ***list)
+{
+	libusb_device **devlist;
+	ssize_t i, count;
+
+	G_LOCK(devlist_snapshot);
+	if (!devlist_snapshot.devlist || devlist_snapshot.usb_ctx != usb_ctx) {
+		G_UNLOCK(devlist_snapshot);
+		return libusb_get_device_list(usb_ctx, list);
+	}
+
+	/* libusb_free_device_list() free()s the list, so use malloc(). */
+	count = devlist_snapshot.count;
+	if (!(devlist = malloc((count + 1) * sizeof(libusb_device *)))) {
+		G_UNLOCK(devlist_snapshot);
+		return LIBUSB_ERROR_NO_MEM;
+	}
+	for (i = 0; i < count; i++)
+		devlist[i] = libusb_ref_device(devlist_snapshot.devlist[i]);
+	devlist[count] = NULL;
+	G_UNLOCK(devlist_snapshot);
+
+	*list = devlist;
+
+	return count;
+}
+
 /**
  * Find USB devices according to a connection string.
  *
@@ -105,7 +200,8 @@ SR_PRIV GSList *sr_usb_find(libusb_context *usb_ctx, const char *conn)
 
 	/* Looks like a valid USB device specification, but is it connected? */
 	devices = NULL;
-	libusb_get_device_list(usb_ctx, &devlist);
+	if (sr_usb_get_device_list(usb_ctx, &devlist) < 0)
+		return NULL;
 	for (i = 0; devlist[i]; i++) {
 		if ((ret = libusb_get_device_descriptor(devlist[i], &des))) {
 			sr_err("Failed to get device descriptor: %s.",
@@ -154,7 +250,8 @@ SR_PRIV GSList *sr_usb_find_usbtmc(libusb_context *usb_ctx)
 	int confidx, intfidx, ret, i;
 
 	devices = NULL;
-	libusb_get_device_list(usb_ctx, &devlist);
+	if (sr_usb_get_device_list(usb_ctx, &devlist) < 0)
+		return NULL;
 	for (i = 0; devlist[i]; i++) {
 		if ((ret = libusb_get_device_descriptor(devlist[i], &des))) {
 			sr_err("Failed to get device descriptor: %s.",
@@ -237,6 +334,169 @@ SR_PRIV int sr_usb_open(libusb_context *usb_ctx, struct sr_usb_dev_inst *usb)
 	return ret;
 }
 
+/* An FX2 takes at least this long to drop off the bus after an upload. */
+#define RENUM_GONE_MS	300
+
+/* Retry interval when the device can't be opened right after it arrived. */
+#define RENUM_POLL_MS	100
+
+/**
+ * Remember the port path of a USB device, so it can be recognized after
+ * it renumerated, see usb_wait_for_renumeration().
+ *
+ * @param usb The device instance.
+ * @param dev The libusb device.
+ *
+ * @private
+ */
+SR_PRIV void usb_dev_inst_set_port_path(struct sr_usb_dev_inst *usb,
+		libusb_device *dev)
+{
+	/* libusb_get_port_numbers() came along with hotplug support. */
+#ifdef LIBUSB_HOTPLUG_MATCH_ANY
+	int len;
+
+	len = libusb_get_port_numbers(dev, usb->port_path,
+				      sizeof(usb->port_path));
+	usb->port_path_len = MAX(len, 0);
+#else
+	(void)usb;
+	(void)dev;
+#endif
+}
+
+/* State of usb_wait_for_renumeration(), shared with its hotplug callback. */
+struct renum_wait {
+	const struct sr_usb_dev_inst *usb;
+	/* Number of arrivals at the device's port path. */
+	int arrived;
+};
+
+#ifdef LIBUSB_HOTPLUG_MATCH_ANY
+static int renum_hotplug_cb(libusb_context *usb_ctx, libusb_device *dev,
+		libusb_hotplug_event event, void *user_data)
+{
+	struct renum_wait *rw;
+	uint8_t port_path[sizeof(rw->usb->port_path)];
+	int len;
+
+	(void)usb_ctx;
+	(void)event;
+
+	rw = user_data;
+
+	/*
+	 * Other boards with the same VID/PID may renumerate at the same
+	 * time, e.g. during ezusb_upload_firmware_all(). Only count the
+	 * one on the bus and port our device was on.
+	 */
+	len = libusb_get_port_numbers(dev, port_path, sizeof(port_path));
+	if (libusb_get_bus_number(dev) == rw->usb->bus
+			&& len == rw->usb->port_path_len
+			&& !memcmp(port_path, rw->usb->port_path, len))
+		rw->arrived++;
+
+	/* Stay registered, it may not be the device we're waiting for. */
+	return 0;
+}
+#endif
+
+/**
+ * Wait for a device to renumerate after a firmware upload, and open it.
+ *
+ * With libusb hotplug support, open_cb is tried as soon as a device with
+ * the given VID/PID arrives on the bus and port path the device was on
+ * before, see usb_dev_inst_set_port_path(). Otherwise, or if the device
+ * can't be opened yet, open_cb is retried every RENUM_POLL_MS.
+ *
+ * @param ctx libsigrok context.
+ * @param sdi The device instance, passed to open_cb. Its conn is the
+ *            struct sr_usb_dev_inst of the device before renumeration.
+ * @param vid USB vendor ID of the device after renumeration.
+ * @param pid USB product ID of the device after renumeration.
+ * @param fw_updated Monotonic time when the firmware upload finished.
+ * @param timeout_ms Give up this long after fw_updated.
+ * @param open_cb The driver's function to open the renumerated device.
+ *
+ * @return SR_OK if open_cb succeeded in time, SR_ERR otherwise.
+ *
+ * @private
+ */
+SR_PRIV int usb_wait_for_renumeration(struct sr_context *ctx,
+		struct sr_dev_inst *sdi, int vid, int pid, int64_t fw_updated,
+		int timeout_ms, int (*open_cb)(struct sr_dev_inst *sdi))
+{
+	struct timeval tv;
+	struct renum_wait rw;
+	int64_t gone, deadline, now, wait;
+	gboolean hotplug;
+	int completed, ret;
+#ifdef LIBUSB_HOTPLUG_MATCH_ANY
+	libusb_hotplug_callback_handle handle;
+#endif
+
+	sr_info("Waiting for device to reset.");
+
+	gone = fw_updated + RENUM_GONE_MS * 1000;
+	deadline = fw_updated + (int64_t)timeout_ms * 1000;
+	rw.usb = sdi->conn;
+	rw.arrived = 0;
+
+	hotplug = FALSE;
+#ifdef LIBUSB_HOTPLUG_MATCH_ANY
+	/* Without the port path, the device can't be told from others. */
+	if (rw.usb && rw.usb->port_path_len > 0
+			&& libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG)
+			&& libusb_hotplug_register_callback(ctx->libusb_ctx,
+				LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED,
+				LIBUSB_HOTPLUG_NO_FLAGS, vid, pid,
+				LIBUSB_HOTPLUG_MATCH_ANY, renum_hotplug_cb,
+				&rw, &handle) == LIBUSB_SUCCESS)
+		hotplug = TRUE;
+#else
+	(void)vid;
+	(void)pid;
+#endif
+
+	ret = SR_ERR;
+	while (TRUE) {
+		now = g_get_monotonic_time();
+		/* Before the old device is gone, don't open that one. */
+		if ((now >= gone || rw.arrived) && (ret = open_cb(sdi)) == SR_OK)
+			break;
+		if ((now = g_get_monotonic_time()) >= deadline)
+			break;
+
+		if (hotplug && !rw.arrived) {
+			/* Sleep until something happens on the bus. */
+			wait = deadline - now;
+			tv.tv_sec = wait / 1000000;
+			tv.tv_usec = wait % 1000000;
+			completed = 0;
+			libusb_handle_events_timeout_completed(ctx->libusb_ctx,
+							       &tv, &completed);
+		} else {
+			wait = now < gone ? gone - now : RENUM_POLL_MS * 1000;
+			g_usleep(MIN(wait, deadline - now));
+		}
+	}
+
+#ifdef LIBUSB_HOTPLUG_MATCH_ANY
+	if (hotplug)
+		libusb_hotplug_deregister_callback(ctx->libusb_ctx, handle);
+#endif
+
+	if (ret != SR_OK) {
+		sr_err("Device failed to renumerate.");
+		return SR_ERR;
+	}
+
+	sr_info("Device came back after %" PRIi64 "ms.",
+		(g_get_monotonic_time() - fw_updated) / 1000);
+
+	return SR_OK;
+}
+
 #ifdef _WIN32
 SR_PRIV gpointer usb_thread(gpointer data)
 {
@@ -268,7 +528,288 @@ SR_PRIV int usb_callback(int fd, int revents, void *cb_data)
 
 	return ret;
 }
+#else
+
+/* How long the USB event thread waits for events before checking for exit. */
+#define USB_EVENT_THREAD_TIMEOUT_MS 100
+
+/* A buffer handed from the USB event thread to the session thread. */
+struct usb_completion {
+	/* The transfer, if it still needs handling by its callback. */
+	struct libusb_transfer *transfer;
+	/* Otherwise the filled buffer, the transfer was resubmitted. */
+	uint8_t *buf;
+	int len;
+	void *user_data;
+};
+
+/*
+ * Single producer, single consumer ring. The producer only ever writes
+ * head, the consumer only ever writes tail, so no locking is needed.
+ */
+struct usb_ring {
+	struct usb_completion *slots;
+	unsigned int mask;
+	volatile gint head;
+	volatile gint tail;
+};
+
+struct sr_usb_event_thread {
+	GThread *thread;
+	/* Set by the thread itself, it may run before g_thread_new() returns. */
+	volatile gpointer self;
+	volatile gint running;
+	volatile gint resubmit;
+	int pipefd[2];
+	size_t buffer_size;
+	/* Spare buffer owned by the event thread. */
+	uint8_t *stash;
+	sr_usb_buffer_callback_t buffer_cb;
+	sr_receive_data_callback_t cb;
+	void *cb_data;
+	/* Event thread -> session thread: completed transfers and buffers. */
+	struct usb_ring done;
+	/* Session thread -> event thread: empty buffers. */
+	struct usb_ring spare;
+};
+
+static int ring_init(struct usb_ring *ring, unsigned int size)
+{
+	unsigned int n;
+
+	for (n = 1; n < size; n <<= 1);
+	if (!(ring->slots = g_try_malloc0(n * sizeof(*ring->slots))))
+		return SR_ERR_MALLOC;
+	ring->mask = n - 1;
+	ring->head = ring->tail = 0;
+
+	return SR_OK;
+}
+
+static gboolean ring_push(struct usb_ring *ring, const struct usb_completion *c)
+{
+	unsigned int head, tail;
+
+	head = g_atomic_int_get(&ring->head);
+	tail = g_atomic_int_get(&ring->tail);
+	if (head - tail > ring->mask)
+		return FALSE;
+	ring->slots[head & ring->mask] = *c;
+	g_atomic_int_set(&ring->head, head + 1);
+
+	return TRUE;
+}
+
+static gboolean ring_pop(struct usb_ring *ring, struct usb_completion *c)
+{
+	unsigned int head, tail;
+
+	tail = g_atomic_int_get(&ring->tail);
+	head = g_atomic_int_get(&ring->head);
+	if (head == tail)
+		return FALSE;
+	*c = ring->slots[tail & ring->mask];
+	g_atomic_int_set(&ring->tail, tail + 1);
+
+	return TRUE;
+}
+
+static gpointer usb_event_thread(gpointer data)
+{
+	struct sr_context *ctx = data;
+	struct sr_usb_event_thread *evt;
+	struct sched_param param;
+	struct timeval tv;
+	int ret;
+
+	evt = ctx->usb_evt;
+	g_atomic_pointer_set(&evt->self, g_thread_self());
+
+	param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+	if ((ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param)))
+		sr_dbg("Failed to raise USB event thread priority: %s.",
+		       strerror(ret));
+
+	while (g_atomic_int_get(&evt->running)) {
+		tv.tv_sec = 0;
+		tv.tv_usec = USB_EVENT_THREAD_TIMEOUT_MS * 1000;
+		libusb_handle_events_timeout_completed(ctx->libusb_ctx, &tv,
+						       NULL);
+	}
+
+	return NULL;
+}
+
+/* Runs on the session thread, whenever the event thread queued something. */
+static int usb_event_thread_callback(int fd, int revents, void *cb_data)
+{
+	struct sr_context *ctx = cb_data;
+	struct sr_usb_event_thread *evt;
+	struct usb_completion c;
+	char dummy[64];
+
+	evt = ctx->usb_evt;
+
+	if (revents & G_IO_IN)
+		while (read(evt->pipefd[0], dummy, sizeof(dummy)) > 0);
+
+	sr_session_stats_queue_depth(g_atomic_int_get(&evt->done.head)
+				     - g_atomic_int_get(&evt->done.tail));
+
+	while (ring_pop(&evt->done, &c)) {
+		if (c.transfer) {
+			c.transfer->callback(c.transfer);
+		} else {
+			evt->buffer_cb(c.buf, c.len, c.user_data);
+			/*
+			 * The callback may have ended the acquisition, and
+			 * freed evt along with it. Don't touch it then.
+			 */
+			if (ctx->usb_evt != evt) {
+				g_free(c.buf);
+				return TRUE;
+			}
+			c.transfer = NULL;
+			c.len = 0;
+			ring_push(&evt->spare, &c);
+		}
+		/* The callback may have ended the acquisition. */
+		if (ctx->usb_evt != evt)
+			return TRUE;
+	}
+
+	if (evt->cb)
+		return evt->cb(fd, revents, evt->cb_data);
+
+	return TRUE;
+}
+
+static void usb_event_thread_free(struct sr_usb_event_thread *evt)
+{
+	struct usb_completion c;
+
+	while (ring_pop(&evt->done, &c)) {
+		if (c.transfer)
+			sr_err("Dropping unhandled USB transfer.");
+		else
+			g_free(c.buf);
+	}
+	while (ring_pop(&evt->spare, &c))
+		g_free(c.buf);
+	g_free(evt->stash);
+	g_free(evt->done.slots);
+	g_free(evt->spare.slots);
+	if (evt->pipefd[0] >= 0)
+		close(evt->pipefd[0]);
+	if (evt->pipefd[1] >= 0)
+		close(evt->pipefd[1]);
+	g_free(evt);
+}
+#endif
+
+/**
+ * Check whether libusb events are handled on the USB event thread.
+ *
+ * Drivers that handle libusb events from their session callback should
+ * not do so while this returns TRUE.
+ *
+ * @private
+ */
+SR_PRIV gboolean usb_event_thread_running(struct sr_context *ctx)
+{
+#ifndef _WIN32
+	return ctx->usb_evt != NULL;
+#else
+	(void)ctx;
+	return FALSE;
+#endif
+}
+
+/**
+ * Hand a completed transfer over to the session thread.
+ *
+ * Transfer callbacks of drivers using usb_source_add_threaded() must call
+ * this first, and return right away if it returns TRUE. On the USB event
+ * thread, a successfully completed transfer gets a spare buffer and is
+ * resubmitted immediately, and the filled buffer is queued for the
+ * buffer callback. Any other transfer is queued as is, and its callback
+ * runs again on the session thread, where this function returns FALSE.
+ *
+ * @private
+ */
+SR_PRIV gboolean usb_transfer_defer(struct sr_context *ctx,
+		struct libusb_transfer *transfer)
+{
+#ifndef _WIN32
+	struct sr_usb_event_thread *evt;
+	struct usb_completion c, spare;
+
+	if (!(evt = ctx->usb_evt))
+		return FALSE;
+	if (g_thread_self() != g_atomic_pointer_get(&evt->self))
+		return FALSE;
+
+	c.transfer = transfer;
+	c.buf = NULL;
+	c.len = 0;
+	c.user_data = transfer->user_data;
+
+	if (!evt->stash && ring_pop(&evt->spare, &spare))
+		evt->stash = spare.buf;
+
+	if (transfer->status == LIBUSB_TRANSFER_COMPLETED
+			&& transfer->actual_length > 0
+			&& (size_t)transfer->length == evt->buffer_size
+			&& g_atomic_int_get(&evt->resubmit) && evt->stash) {
+		c.buf = transfer->buffer;
+		c.len = transfer->actual_length;
+		transfer->buffer = evt->stash;
+		if (libusb_submit_transfer(transfer) == LIBUSB_SUCCESS) {
+			evt->stash = NULL;
+			c.transfer = NULL;
+			/*
+			 * The session thread may have started cancelling
+			 * transfers just before we resubmitted.
+			 */
+			if (!g_atomic_int_get(&evt->resubmit))
+				libusb_cancel_transfer(transfer);
+		} else {
+			/* Let the transfer callback deal with it. */
+			transfer->buffer = c.buf;
+			c.buf = NULL;
+			c.len = 0;
+		}
+	}
+
+	ring_push(&evt->done, &c);
+	if (write(evt->pipefd[1], "", 1) < 0 && errno != EAGAIN)
+		sr_err("Failed to wake up session thread: %s.",
+		       strerror(errno));
+
+	return TRUE;
+#else
+	(void)ctx;
+	(void)transfer;
+	return FALSE;
+#endif
+}
+
+/**
+ * Stop the USB event thread from resubmitting transfers.
+ *
+ * Must be called on the session thread before cancelling transfers.
+ *
+ * @private
+ */
+SR_PRIV void usb_source_stop_resubmit(struct sr_context *ctx)
+{
+#ifndef _WIN32
+	if (ctx && ctx->usb_evt)
+		g_atomic_int_set(&ctx->usb_evt->resubmit, 0);
+#else
+	(void)ctx;
 #endif
+}
 
 SR_PRIV int usb_source_add(struct sr_context *ctx, int timeout,
 		sr_receive_data_callback_t cb, void *cb_data)
@@ -302,11 +843,129 @@ SR_PRIV int usb_source_add(struct sr_context *ctx, int timeout,
 	return SR_OK;
 }
 
+/**
+ * Add a USB event source, handling libusb events on a separate thread.
+ *
+ * If the USB event thread is enabled (see sr_usb_event_thread_set()), a
+ * high-priority thread handles libusb events, and resubmits successfully
+ * completed transfers right away with a spare buffer. The filled buffers
+ * are passed to buffer_cb on the session thread, in order. Transfer
+ * callbacks must call usb_transfer_defer() first.
+ *
+ * Otherwise, or on Windows, this is the same as usb_source_add().
+ *
+ * @param ctx libsigrok context.
+ * @param timeout Session source timeout in ms.
+ * @param cb Session source callback. It is called after the queued
+ *           buffers have been handled, and must not handle libusb
+ *           events while usb_event_thread_running() returns TRUE.
+ * @param cb_data Data passed to cb.
+ * @param buffer_cb Called on the session thread for each filled buffer.
+ *                  The buffer is only valid during the call.
+ * @param num_transfers Number of transfers the driver submits. This many
+ *                      spare buffers are allocated.
+ * @param buffer_size Size of each transfer buffer. Only transfers of
+ *                    exactly this size take the fast path.
+ *
+ * @private
+ */
+SR_PRIV int usb_source_add_threaded(struct sr_context *ctx, int timeout,
+		sr_receive_data_callback_t cb, void *cb_data,
+		sr_usb_buffer_callback_t buffer_cb, unsigned int num_transfers,
+		size_t buffer_size)
+{
+#ifndef _WIN32
+	struct sr_usb_event_thread *evt;
+	struct usb_completion c;
+	unsigned int i;
+	int ret;
+
+	if (!ctx->usb_event_thread)
+		return usb_source_add(ctx, timeout, cb, cb_data);
+
+	if (ctx->usb_source_present) {
+		sr_err("A USB event source is already present.");
+		return SR_ERR;
+	}
+
+	if (!(evt = g_try_malloc0(sizeof(struct sr_usb_event_thread)))) {
+		sr_err("USB event thread malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+	evt->pipefd[0] = evt->pipefd[1] = -1;
+	evt->buffer_size = buffer_size;
+	evt->buffer_cb = buffer_cb;
+	evt->cb = cb;
+	evt->cb_data = cb_data;
+	evt->running = evt->resubmit = 1;
+
+	if ((ret = ring_init(&evt->done, 2 * num_transfers)) != SR_OK
+			|| (ret = ring_init(&evt->spare, num_transfers)) != SR_OK) {
+		sr_err("USB event queue malloc failed.");
+		usb_event_thread_free(evt);
+		return ret;
+	}
+
+	c.transfer = NULL;
+	c.len = 0;
+	c.user_data = NULL;
+	for (i = 0; i < num_transfers; i++) {
+		if (!(c.buf = g_try_malloc(buffer_size))) {
+			sr_err("USB spare buffer malloc failed.");
+			usb_event_thread_free(evt);
+			return SR_ERR_MALLOC;
+		}
+		ring_push(&evt->spare, &c);
+	}
+
+	if (pipe(evt->pipefd) < 0) {
+		sr_err("Failed to create USB event pipe: %s.",
+		       strerror(errno));
+		evt->pipefd[0] = evt->pipefd[1] = -1;
+		usb_event_thread_free(evt);
+		return SR_ERR;
+	}
+	fcntl(evt->pipefd[0], F_SETFL, O_NONBLOCK);
+	fcntl(evt->pipefd[1], F_SETFL, O_NONBLOCK);
+
+	ctx->usb_evt = evt;
+	sr_source_add(evt->pipefd[0], G_IO_IN, timeout,
+		      usb_event_thread_callback, ctx);
+	evt->thread = g_thread_new("usb-events", usb_event_thread, ctx);
+	ctx->usb_source_present = TRUE;
+
+	return SR_OK;
+#else
+	(void)buffer_cb;
+	(void)num_transfers;
+	(void)buffer_size;
+
+	return usb_source_add(ctx, timeout, cb, cb_data);
+#endif
+}
+
 SR_PRIV int usb_source_remove(struct sr_context *ctx)
 {
+#ifndef _WIN32
+	struct sr_usb_event_thread *evt;
+#endif
+
 	if (!ctx->usb_source_present)
 		return SR_OK;
 
+#ifndef _WIN32
+	if ((evt = ctx->usb_evt)) {
+		g_atomic_int_set(&evt->resubmit, 0);
+		g_atomic_int_set(&evt->running, 0);
+		g_thread_join(evt->thread);
+		sr_source_remove(evt->pipefd[0]);
+		ctx->usb_evt = NULL;
+		usb_event_thread_free(evt);
+		ctx->usb_source_present = FALSE;
+		return SR_OK;
+	}
+#endif
+
 #ifdef _WIN32
 	ctx->usb_thread_running = FALSE;
 	g_mutex_unlock(&ctx->usb_mutex);
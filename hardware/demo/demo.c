@@ -38,6 +38,15 @@
 
 /* The size in bytes of chunks to send through the session bus. */
 #define LOGIC_BUFSIZE        4096
+/* Chunk size used in max throughput mode. */
+#define LOGIC_MAX_BUFSIZE    (1024 * 1024)
+/* Number of chunks sent per poll callback in max throughput mode. */
+#define MAX_THROUGHPUT_CHUNKS 16
+/*
+ * Length (in samples) which all periodic logic patterns repeat after:
+ * 64 for the "sigrok" pattern, 256 for the incremental pattern.
+ */
+#define LOGIC_PATTERN_PERIOD 256
 /* Size of the analog pattern space per channel. */
 #define ANALOG_BUFSIZE       4096
 
@@ -103,11 +112,17 @@ struct dev_context {
 	uint64_t samples_counter;
 	int64_t starttime;
 	uint64_t step;
+	gboolean max_throughput;
 	/* Logic */
 	int32_t num_logic_probes;
 	unsigned int logic_unitsize;
 	uint8_t logic_pattern;
-	unsigned char logic_data[LOGIC_BUFSIZE];
+	/* LOGIC_MAX_BUFSIZE bytes, LOGIC_BUFSIZE of which are used when paced. */
+	unsigned char *logic_data;
+	/* Samples per logic packet. */
+	uint64_t logic_chunk;
+	/* xorshift64* PRNG state for PATTERN_RANDOM. */
+	uint64_t rng_state;
 	/* Analog */
 	int32_t num_analog_probes;
 	GSList *analog_probe_groups;
@@ -125,6 +140,7 @@ static const int hwcaps[] = {
 	SR_CONF_PATTERN_MODE,
 	SR_CONF_LIMIT_SAMPLES,
 	SR_CONF_LIMIT_MSEC,
+	SR_CONF_MAX_THROUGHPUT,
 };
 
 static const uint64_t samplerates[] = {
@@ -150,9 +166,18 @@ static struct sr_dev_driver *di = &demo_driver_info;
 static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data);
 
 
+static void clear_helper(void *priv)
+{
+	struct dev_context *devc;
+
+	devc = priv;
+	g_free(devc->logic_data);
+	g_free(devc);
+}
+
 static int dev_clear(void)
 {
-	return std_dev_clear(di, NULL);
+	return std_dev_clear(di, clear_helper);
 }
 
 static int init(struct sr_context *sr_ctx)
@@ -228,10 +253,16 @@ static GSList *scan(GSList *options)
 		sr_err("Device context malloc failed.");
 		return NULL;
 	}
+	if (!(devc->logic_data = g_try_malloc0(LOGIC_MAX_BUFSIZE))) {
+		sr_err("Logic buffer malloc failed.");
+		g_free(devc);
+		return NULL;
+	}
 	devc->cur_samplerate = SR_KHZ(200);
 	devc->limit_samples = 0;
 	devc->limit_msec = 0;
 	devc->step = 0;
+	devc->max_throughput = FALSE;
 	devc->num_logic_probes = num_logic_probes;
 	devc->logic_unitsize = (devc->num_logic_probes + 7) / 8;
 	devc->logic_pattern = PATTERN_SIGROK;
@@ -339,6 +370,9 @@ static int config_get(int id, GVariant **data, const struct sr_dev_inst *sdi,
 	case SR_CONF_NUM_ANALOG_PROBES:
 		*data = g_variant_new_int32(devc->num_analog_probes);
 		break;
+	case SR_CONF_MAX_THROUGHPUT:
+		*data = g_variant_new_boolean(devc->max_throughput);
+		break;
 	default:
 		return SR_ERR_NA;
 	}
@@ -377,6 +411,11 @@ static int config_set(int id, GVariant *data, const struct sr_dev_inst *sdi,
 		devc->limit_samples = 0;
 		sr_dbg("Setting time limit to %" PRIu64"ms", devc->limit_msec);
 		ret = SR_OK;
+	} else if (id == SR_CONF_MAX_THROUGHPUT) {
+		devc->max_throughput = g_variant_get_boolean(data);
+		sr_dbg("%s max throughput mode.",
+		       devc->max_throughput ? "Enabling" : "Disabling");
+		ret = SR_OK;
 	} else if (id == SR_CONF_PATTERN_MODE) {
 		stropt = g_variant_get_string(data, NULL);
 		logic_pattern = analog_pattern = -1;
@@ -400,9 +439,9 @@ static int config_set(int id, GVariant *data, const struct sr_dev_inst *sdi,
 			devc->logic_pattern = logic_pattern;
 			/* Might as well do this now. */
 			if (logic_pattern == PATTERN_ALL_LOW)
-				memset(devc->logic_data, 0x00, LOGIC_BUFSIZE);
+				memset(devc->logic_data, 0x00, LOGIC_MAX_BUFSIZE);
 			else if (logic_pattern == PATTERN_ALL_HIGH)
-				memset(devc->logic_data, 0xff, LOGIC_BUFSIZE);
+				memset(devc->logic_data, 0xff, LOGIC_MAX_BUFSIZE);
 			ret = SR_OK;
 			sr_dbg("Setting logic pattern to %s", logic_pattern_str[logic_pattern]);
 		} else if (analog_pattern > -1) {
@@ -462,10 +501,24 @@ static int config_list(int key, GVariant **data, const struct sr_dev_inst *sdi,
 	return SR_OK;
 }
 
+/* xorshift64*, much cheaper than calling rand() for every byte. */
+static uint64_t random_next(struct dev_context *devc)
+{
+	uint64_t x;
+
+	x = devc->rng_state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	devc->rng_state = x;
+
+	return x * UINT64_C(2685821657736338717);
+}
+
 static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
 {
 	struct dev_context *devc;
-	uint64_t i, j;
+	uint64_t i, j, r;
 	uint8_t pat;
 
 	devc = sdi->priv;
@@ -482,11 +535,13 @@ static void logic_generator(struct sr_dev_inst *sdi, uint64_t size)
 		}
 		break;
 	case PATTERN_RANDOM:
-		for (i = 0; i < size; i++)
-			devc->logic_data[i] = (uint8_t)(rand() & 0xff);
+		for (i = 0; i < size; i += sizeof(r)) {
+			r = random_next(devc);
+			memcpy(devc->logic_data + i, &r, MIN(sizeof(r), size - i));
+		}
 		break;
 	case PATTERN_INC:
-		for (i = 0; i < size; i++) {
+		for (i = 0; i < size; i += devc->logic_unitsize) {
 			for (j = 0; j < devc->logic_unitsize; j++) {
 				devc->logic_data[i + j] = devc->step;
 			}
@@ -514,6 +569,7 @@ static int prepare_data(int fd, int revents, void *cb_data)
 	struct analog_gen *ag;
 	GSList *l;
 	uint64_t samples_to_send, expected_samplenum, analog_samples, sending_now;
+	uint64_t analog_sent;
 	int64_t time, elapsed;
 
 	(void)fd;
@@ -522,12 +578,21 @@ static int prepare_data(int fd, int revents, void *cb_data)
 	sdi = cb_data;
 	devc = sdi->priv;
 
-	/* How many "virtual" samples should we have collected by now? */
 	time = g_get_monotonic_time();
 	elapsed = time - devc->starttime;
-	expected_samplenum = elapsed * devc->cur_samplerate / 1000000;
-	/* Of those, how many do we still have to send? */
-	samples_to_send = expected_samplenum - devc->samples_counter;
+
+	if (devc->max_throughput) {
+		/*
+		 * Ignore the wall clock, just send a fixed amount of data
+		 * per call so the session loop still gets to run.
+		 */
+		samples_to_send = devc->logic_chunk * MAX_THROUGHPUT_CHUNKS;
+	} else {
+		/* How many "virtual" samples should we have collected by now? */
+		expected_samplenum = elapsed * devc->cur_samplerate / 1000000;
+		/* Of those, how many do we still have to send? */
+		samples_to_send = expected_samplenum - devc->samples_counter;
+	}
 
 	if (devc->limit_samples) {
 		samples_to_send = MIN(samples_to_send,
@@ -539,9 +604,14 @@ static int prepare_data(int fd, int revents, void *cb_data)
 
 		/* Logic */
 		if (devc->num_logic_probes > 0) {
-			sending_now = MIN(samples_to_send,
-					LOGIC_BUFSIZE / devc->logic_unitsize);
-			logic_generator(sdi, sending_now * devc->logic_unitsize);
+			sending_now = MIN(samples_to_send, devc->logic_chunk);
+			/*
+			 * In max throughput mode the periodic patterns were
+			 * rendered into the whole buffer at acquisition start.
+			 */
+			if (!devc->max_throughput
+			    || devc->logic_pattern == PATTERN_RANDOM)
+				logic_generator(sdi, sending_now * devc->logic_unitsize);
 			packet.type = SR_DF_LOGIC;
 			packet.payload = &logic;
 			logic.length = sending_now * devc->logic_unitsize;
@@ -552,17 +622,33 @@ static int prepare_data(int fd, int revents, void *cb_data)
 
 		/* Analog, one probe at a time */
 		if (devc->num_analog_probes > 0) {
-			sending_now = 0;
+			/*
+			 * Without logic probes, the analog pattern length
+			 * decides the chunk size. Otherwise send as many
+			 * analog packets as it takes to match the logic chunk.
+			 */
+			if (devc->num_logic_probes == 0)
+				sending_now = 0;
 			for (l = devc->analog_probe_groups; l; l = l->next) {
 				pg = l->data;
 				ag = pg->priv;
 				packet.type = SR_DF_ANALOG;
 				packet.payload = &ag->packet;
-				analog_samples = MIN(samples_to_send, ag->num_samples);
-				/* Whichever probe group gets there first. */
-				sending_now = MAX(sending_now, analog_samples);
-				ag->packet.num_samples = analog_samples;
-				sr_session_send(sdi, &packet);
+				if (devc->num_logic_probes == 0) {
+					analog_samples = MIN(samples_to_send, ag->num_samples);
+					/* Whichever probe group gets there first. */
+					sending_now = MAX(sending_now, analog_samples);
+					ag->packet.num_samples = analog_samples;
+					sr_session_send(sdi, &packet);
+					continue;
+				}
+				for (analog_sent = 0; analog_sent < sending_now;
+						analog_sent += analog_samples) {
+					analog_samples = MIN(sending_now - analog_sent,
+							ag->num_samples);
+					ag->packet.num_samples = analog_samples;
+					sr_session_send(sdi, &packet);
+				}
 			}
 		}
 
@@ -577,6 +663,13 @@ static int prepare_data(int fd, int revents, void *cb_data)
 		return TRUE;
 	}
 
+	if (devc->limit_msec &&
+		(uint64_t)elapsed >= devc->limit_msec * 1000) {
+		sr_info("Requested time limit reached.");
+		dev_acquisition_stop(sdi, cb_data);
+		return TRUE;
+	}
+
 	return TRUE;
 }
 
@@ -590,6 +683,25 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 	/* TODO: don't start without a sample limit set */
 	devc = sdi->priv;
 	devc->samples_counter = 0;
+	devc->rng_state = UINT64_C(0x9e3779b97f4a7c15);
+
+	if (devc->max_throughput && devc->num_logic_probes > 0) {
+		/*
+		 * Use a buffer which holds a whole number of pattern periods,
+		 * so it can be sent over and over without regenerating it.
+		 */
+		devc->logic_chunk = LOGIC_MAX_BUFSIZE / devc->logic_unitsize;
+		devc->logic_chunk -= devc->logic_chunk % LOGIC_PATTERN_PERIOD;
+		if (devc->logic_pattern != PATTERN_RANDOM) {
+			devc->step = 0;
+			logic_generator((struct sr_dev_inst *)sdi,
+					devc->logic_chunk * devc->logic_unitsize);
+		}
+	} else if (devc->num_logic_probes > 0) {
+		devc->logic_chunk = LOGIC_BUFSIZE / devc->logic_unitsize;
+	} else {
+		devc->logic_chunk = ANALOG_BUFSIZE;
+	}
 
 	/*
 	 * Setting two channels connected by a pipe is a remnant from when the
@@ -603,6 +715,16 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 		return SR_ERR;
 	}
 
+	/*
+	 * In max throughput mode, leave a byte in the pipe which is never
+	 * read, so the channel is always readable and the session loop
+	 * calls us back without waiting for the poll timeout.
+	 */
+	if (devc->max_throughput && write(devc->pipe_fds[1], "", 1) != 1) {
+		sr_err("%s: write() to pipe failed", __func__);
+		return SR_ERR;
+	}
+
 	devc->channel = g_io_channel_unix_new(devc->pipe_fds[0]);
 
 	g_io_channel_set_flags(devc->channel, G_IO_FLAG_NONBLOCK, NULL);
@@ -629,6 +751,8 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
 {
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
+	int64_t elapsed;
+	double msps;
 
 	(void)cb_data;
 
@@ -639,6 +763,16 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
 	g_io_channel_shutdown(devc->channel, FALSE, NULL);
 	g_io_channel_unref(devc->channel);
 	devc->channel = NULL;
+	close(devc->pipe_fds[1]);
+
+	/* Report how fast the session bus consumed our data. */
+	elapsed = g_get_monotonic_time() - devc->starttime;
+	if (elapsed > 0) {
+		msps = (double)devc->samples_counter / elapsed;
+		sr_info("Sent %" PRIu64 " samples in %.3f s: %.2f MS/s, %.2f MB/s.",
+			devc->samples_counter, elapsed / 1000000.0, msps,
+			msps * devc->logic_unitsize);
+	}
 
 	/* Send last packet. */
 	packet.type = SR_DF_END;
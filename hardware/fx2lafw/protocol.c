@@ -298,15 +298,16 @@ SR_PRIV int fx2lafw_configure_probes(const struct sr_dev_inst *sdi)
 	struct sr_probe *probe;
 	GSList *l;
 	int probe_bit, stage, i;
+	uint16_t trigger_mask[NUM_TRIGGER_STAGES];
+	uint16_t trigger_value[NUM_TRIGGER_STAGES];
 	char *tc;
 
 	devc = sdi->priv;
 	for (i = 0; i < NUM_TRIGGER_STAGES; i++) {
-		devc->trigger_mask[i] = 0;
-		devc->trigger_value[i] = 0;
+		trigger_mask[i] = 0;
+		trigger_value[i] = 0;
 	}
 
-	stage = -1;
 	for (l = sdi->probes; l; l = l->next) {
 		probe = (struct sr_probe *)l->data;
 		if (probe->enabled == FALSE)
@@ -321,23 +322,25 @@ SR_PRIV int fx2lafw_configure_probes(const struct sr_dev_inst *sdi)
 
 		stage = 0;
 		for (tc = probe->trigger; *tc; tc++) {
-			devc->trigger_mask[stage] |= probe_bit;
+			if (stage == NUM_TRIGGER_STAGES)
+				return SR_ERR;
+			trigger_mask[stage] |= probe_bit;
 			if (*tc == '1')
-				devc->trigger_value[stage] |= probe_bit;
+				trigger_value[stage] |= probe_bit;
 			stage++;
-			if (stage > NUM_TRIGGER_STAGES)
-				return SR_ERR;
 		}
 	}
 
-	if (stage == -1)
-		/*
-		 * We didn't configure any triggers, make sure acquisition
-		 * doesn't wait for any.
-		 */
-		devc->trigger_stage = TRIGGER_FIRED;
-	else
-		devc->trigger_stage = 0;
+	sr_soft_trigger_init(&devc->trigger, devc->sample_wide ? 2 : 1);
+	for (i = 0; i < NUM_TRIGGER_STAGES && trigger_mask[i]; i++)
+		sr_soft_trigger_add_stage(&devc->trigger, trigger_mask[i],
+					  trigger_value[i]);
+
+	/*
+	 * If we didn't configure any triggers (or only empty ones), make
+	 * sure acquisition doesn't wait for any.
+	 */
+	devc->trigger_fired = (devc->trigger.num_stages == 0);
 
 	return SR_OK;
 }
@@ -356,6 +359,7 @@ SR_PRIV struct dev_context *fx2lafw_dev_new(void)
 	devc->cur_samplerate = 0;
 	devc->limit_samples = 0;
 	devc->sample_wide = FALSE;
+	devc->ctx = NULL;
 
 	return devc;
 }
@@ -366,6 +370,7 @@ SR_PRIV void fx2lafw_abort_acquisition(struct dev_context *devc)
 
 	devc->num_samples = -1;
 
+	usb_source_stop_resubmit(devc->ctx);
 	for (i = devc->num_transfers - 1; i >= 0; i--) {
 		if (devc->transfers[i])
 			libusb_cancel_transfer(devc->transfers[i]);
@@ -412,29 +417,103 @@ static void free_transfer(struct libusb_transfer *transfer)
 
 static void resubmit_transfer(struct libusb_transfer *transfer)
 {
+	struct dev_context *devc;
+	struct sr_dev_inst *sdi;
 	int ret;
 
-	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
+	devc = transfer->user_data;
+	sdi = devc->cb_data;
+
+	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS) {
+		sdi->stats.transfers_resubmitted++;
 		return;
+	}
 
 	free_transfer(transfer);
 	/* TODO: Stop session? */
+	sr_trace(SR_TRACE_USB_RESUBMIT_FAILED, ret, 0);
 
 	sr_err("%s: %s", __func__, libusb_error_name(ret));
 }
 
-SR_PRIV void fx2lafw_receive_transfer(struct libusb_transfer *transfer)
+/*
+ * Run the software trigger over a buffer of samples and send them to the
+ * session bus. Returns FALSE once the sample limit has been reached.
+ */
+static gboolean send_samples(struct dev_context *devc, uint8_t *cur_buf,
+		int length)
 {
-	gboolean packet_has_error = FALSE;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-	struct dev_context *devc;
-	int trigger_offset, i, sample_width, cur_sample_count;
+	int trigger_offset, sample_width, cur_sample_count;
 	int trigger_offset_bytes;
-	uint8_t *cur_buf;
-	uint16_t cur_sample;
+
+	sample_width = devc->sample_wide ? 2 : 1;
+	cur_sample_count = length / sample_width;
+
+	trigger_offset = 0;
+	if (!devc->trigger_fired) {
+		trigger_offset = sr_soft_trigger_scan(&devc->trigger, cur_buf,
+						      cur_sample_count);
+		if (trigger_offset < 0) {
+			/*
+			 * TODO: Buffer pre-trigger data in capture
+			 * ratio-sized buffer.
+			 */
+			return TRUE;
+		}
+
+		/*
+		 * TODO: Send pre-trigger buffer to session bus.
+		 * Tell the frontend we hit the trigger here.
+		 */
+		packet.type = SR_DF_TRIGGER;
+		packet.payload = NULL;
+		sr_session_send(devc->cb_data, &packet);
+
+		/*
+		 * Send the samples that triggered it, since we're
+		 * skipping past them. Some of them may have been in
+		 * an earlier transfer.
+		 */
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.unitsize = sample_width;
+		logic.length = devc->trigger.num_stages * logic.unitsize;
+		logic.data = devc->trigger.matched;
+		sr_session_send(devc->cb_data, &packet);
+
+		devc->trigger_fired = TRUE;
+	}
+
+	/* Send the incoming transfer to the session bus. */
+	trigger_offset_bytes = trigger_offset * sample_width;
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.length = length - trigger_offset_bytes;
+	logic.unitsize = sample_width;
+	logic.data = cur_buf + trigger_offset_bytes;
+	sr_session_send(devc->cb_data, &packet);
+
+	devc->num_samples += cur_sample_count;
+	if (devc->limit_samples &&
+		(unsigned int)devc->num_samples > devc->limit_samples)
+		return FALSE;
+
+	return TRUE;
+}
+
+SR_PRIV void fx2lafw_receive_transfer(struct libusb_transfer *transfer)
+{
+	gboolean packet_has_error = FALSE;
+	struct dev_context *devc;
+	struct sr_dev_inst *sdi;
 
 	devc = transfer->user_data;
+	sdi = devc->cb_data;
+
+	if (usb_transfer_defer(devc->ctx, transfer))
+		return;
 
 	/*
 	 * If acquisition has already ended, just free any queued up
@@ -447,11 +526,8 @@ SR_PRIV void fx2lafw_receive_transfer(struct libusb_transfer *transfer)
 
 	sr_info("receive_transfer(): status %d received %d bytes.",
 		transfer->status, transfer->actual_length);
-
-	/* Save incoming transfer before reusing the transfer struct. */
-	cur_buf = transfer->buffer;
-	sample_width = devc->sample_wide ? 2 : 1;
-	cur_sample_count = transfer->actual_length / sample_width;
+	sr_trace(SR_TRACE_USB_TRANSFER, transfer->status,
+		 transfer->actual_length);
 
 	switch (transfer->status) {
 	case LIBUSB_TRANSFER_NO_DEVICE:
@@ -466,6 +542,14 @@ SR_PRIV void fx2lafw_receive_transfer(struct libusb_transfer *transfer)
 		break;
 	}
 
+	sdi->stats.bytes_received += transfer->actual_length;
+	if (packet_has_error)
+		sdi->stats.transfers_failed++;
+	else if (transfer->actual_length == 0)
+		sdi->stats.transfers_empty++;
+	else
+		sdi->stats.transfers_completed++;
+
 	if (transfer->actual_length == 0 || packet_has_error) {
 		devc->empty_transfer_count++;
 		if (devc->empty_transfer_count > MAX_EMPTY_TRANSFERS) {
@@ -483,89 +567,37 @@ SR_PRIV void fx2lafw_receive_transfer(struct libusb_transfer *transfer)
 		devc->empty_transfer_count = 0;
 	}
 
-	trigger_offset = 0;
-	if (devc->trigger_stage >= 0) {
-		for (i = 0; i < cur_sample_count; i++) {
-
-			cur_sample = devc->sample_wide ?
-				*((uint16_t *)cur_buf + i) :
-				*((uint8_t *)cur_buf + i);
-
-			if ((cur_sample & devc->trigger_mask[devc->trigger_stage]) ==
-				devc->trigger_value[devc->trigger_stage]) {
-				/* Match on this trigger stage. */
-				devc->trigger_buffer[devc->trigger_stage] = cur_sample;
-				devc->trigger_stage++;
-
-				if (devc->trigger_stage == NUM_TRIGGER_STAGES ||
-					devc->trigger_mask[devc->trigger_stage] == 0) {
-					/* Match on all trigger stages, we're done. */
-					trigger_offset = i + 1;
-
-					/*
-					 * TODO: Send pre-trigger buffer to session bus.
-					 * Tell the frontend we hit the trigger here.
-					 */
-					packet.type = SR_DF_TRIGGER;
-					packet.payload = NULL;
-					sr_session_send(devc->cb_data, &packet);
-
-					/*
-					 * Send the samples that triggered it,
-					 * since we're skipping past them.
-					 */
-					packet.type = SR_DF_LOGIC;
-					packet.payload = &logic;
-					logic.unitsize = sample_width;
-					logic.length = devc->trigger_stage * logic.unitsize;
-					logic.data = devc->trigger_buffer;
-					sr_session_send(devc->cb_data, &packet);
-
-					devc->trigger_stage = TRIGGER_FIRED;
-					break;
-				}
-			} else if (devc->trigger_stage > 0) {
-				/*
-				 * We had a match before, but not in the next sample. However, we may
-				 * have a match on this stage in the next bit -- trigger on 0001 will
-				 * fail on seeing 00001, so we need to go back to stage 0 -- but at
-				 * the next sample from the one that matched originally, which the
-				 * counter increment at the end of the loop takes care of.
-				 */
-				i -= devc->trigger_stage;
-				if (i < -1)
-					i = -1; /* Oops, went back past this buffer. */
-				/* Reset trigger stage. */
-				devc->trigger_stage = 0;
-			}
-		}
+	if (!send_samples(devc, transfer->buffer, transfer->actual_length)) {
+		fx2lafw_abort_acquisition(devc);
+		free_transfer(transfer);
+		return;
 	}
 
-	if (devc->trigger_stage == TRIGGER_FIRED) {
-		/* Send the incoming transfer to the session bus. */
-		trigger_offset_bytes = trigger_offset * sample_width;
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		logic.length = transfer->actual_length - trigger_offset_bytes;
-		logic.unitsize = sample_width;
-		logic.data = cur_buf + trigger_offset_bytes;
-		sr_session_send(devc->cb_data, &packet);
+	resubmit_transfer(transfer);
+}
 
-		devc->num_samples += cur_sample_count;
-		if (devc->limit_samples &&
-			(unsigned int)devc->num_samples > devc->limit_samples) {
-			fx2lafw_abort_acquisition(devc);
-			free_transfer(transfer);
-			return;
-		}
-	} else {
-		/*
-		 * TODO: Buffer pre-trigger data in capture
-		 * ratio-sized buffer.
-		 */
-	}
+/*
+ * Handle a buffer from a transfer the USB event thread has already
+ * resubmitted.
+ */
+SR_PRIV void fx2lafw_receive_buffer(uint8_t *buf, int len, void *user_data)
+{
+	struct dev_context *devc;
+	struct sr_dev_inst *sdi;
 
-	resubmit_transfer(transfer);
+	devc = user_data;
+	sdi = devc->cb_data;
+
+	if (devc->num_samples == -1)
+		return;
+
+	sdi->stats.bytes_received += len;
+	sdi->stats.transfers_completed++;
+	sdi->stats.transfers_resubmitted++;
+
+	devc->empty_transfer_count = 0;
+	if (!send_samples(devc, buf, len))
+		fx2lafw_abort_acquisition(devc);
 }
 
 static unsigned int to_bytes_per_ms(unsigned int samplerate)
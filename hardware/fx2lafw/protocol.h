@@ -48,9 +48,6 @@
 /* 6 delay states of up to 256 clock ticks */
 #define MAX_SAMPLE_DELAY	(6 * 256)
 
-/* Software trigger implementation: positive values indicate trigger stage. */
-#define TRIGGER_FIRED          -1
-
 #define DEV_CAPS_16BIT_POS	0
 
 #define DEV_CAPS_16BIT		(1 << DEV_CAPS_16BIT_POS)
@@ -84,10 +81,8 @@ struct dev_context {
 
 	/* Operational settings */
 	gboolean sample_wide;
-	uint16_t trigger_mask[NUM_TRIGGER_STAGES];
-	uint16_t trigger_value[NUM_TRIGGER_STAGES];
-	int trigger_stage;
-	uint16_t trigger_buffer[NUM_TRIGGER_STAGES];
+	struct sr_soft_trigger trigger;
+	gboolean trigger_fired;
 
 	int num_samples;
 	int submitted_transfers;
@@ -107,6 +102,7 @@ SR_PRIV int fx2lafw_configure_probes(const struct sr_dev_inst *sdi);
 SR_PRIV struct dev_context *fx2lafw_dev_new(void);
 SR_PRIV void fx2lafw_abort_acquisition(struct dev_context *devc);
 SR_PRIV void fx2lafw_receive_transfer(struct libusb_transfer *transfer);
+SR_PRIV void fx2lafw_receive_buffer(uint8_t *buf, int len, void *user_data);
 SR_PRIV size_t fx2lafw_get_buffer_size(struct dev_context *devc);
 SR_PRIV unsigned int fx2lafw_get_number_of_transfers(struct dev_context *devc);
 SR_PRIV unsigned int fx2lafw_get_timeout(struct dev_context *devc);
@@ -356,6 +356,10 @@ static int dev_open(struct sr_dev_inst *sdi)
 	if (hmo_scope_state_get(sdi) != SR_OK)
 		return SR_ERR;
 
+	/* All settings are known now, there's no need to ask again. */
+	if (sr_config_cache_enable(sdi) != SR_OK)
+		return SR_ERR_MALLOC;
+
 	sdi->status = SR_ST_ACTIVE;
 
 	return SR_OK;
@@ -862,6 +866,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 		return SR_ERR;
 	}
 
+	devc->block = g_byte_array_new();
+
 	sr_scpi_source_add(scpi, G_IO_IN, 50, hmo_receive_data, (void *)sdi);
 
 	/* Send header packet to the session bus. */
@@ -886,6 +892,9 @@ static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
 
 	g_slist_free(devc->enabled_probes);
 	devc->enabled_probes = NULL;
+	if (devc->block)
+		g_byte_array_free(devc->block, TRUE);
+	devc->block = NULL;
 	scpi = sdi->conn;
 	sr_scpi_source_remove(scpi);
 
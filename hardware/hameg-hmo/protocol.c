@@ -20,12 +20,12 @@
 #include "protocol.h"
 
 static const char *hameg_scpi_dialect[] = {
-	[SCPI_CMD_GET_DIG_DATA]		    = ":POD%d:DATA?",
+	[SCPI_CMD_GET_DIG_DATA]		    = ":FORM UINT,8;:POD%d:DATA?",
 	[SCPI_CMD_GET_TIMEBASE]		    = ":TIM:SCAL?",
 	[SCPI_CMD_SET_TIMEBASE]		    = ":TIM:SCAL %E",
 	[SCPI_CMD_GET_COUPLING]		    = ":CHAN%d:COUP?",
 	[SCPI_CMD_SET_COUPLING]		    = ":CHAN%d:COUP %s",
-	[SCPI_CMD_GET_ANALOG_DATA]	    = ":CHAN%d:DATA?",
+	[SCPI_CMD_GET_ANALOG_DATA]	    = ":FORM:BORD LSBF;:FORM REAL;:CHAN%d:DATA?",
 	[SCPI_CMD_GET_VERTICAL_DIV]	    = ":CHAN%d:SCAL?",
 	[SCPI_CMD_SET_VERTICAL_DIV]	    = ":CHAN%d:SCAL %E",
 	[SCPI_CMD_GET_DIG_POD_STATE]	    = ":POD%d:STAT?",
@@ -282,106 +282,66 @@ static void scope_state_dump(struct scope_config *config,
 		state->horiz_triggerpos);
 }
 
-static int scope_state_get_array_option(struct sr_scpi_dev_inst *scpi,
-		const char *command, const char *(*array)[], int *result)
+static int array_option_get(const char *str, const char *(*array)[],
+		int *result)
 {
-	char *tmp;
 	unsigned int i;
 
-	if (sr_scpi_get_string(scpi, command, &tmp) != SR_OK) {
-		g_free(tmp);
-		return SR_ERR;
-	}
-
 	for (i = 0; (*array)[i]; ++i) {
-		if (!g_strcmp0(tmp, (*array)[i])) {
+		if (!g_strcmp0(str, (*array)[i])) {
 			*result = i;
-			g_free(tmp);
-			tmp = NULL;
-			break;
+			return SR_OK;
 		}
 	}
 
-	if (tmp) {
-		g_free(tmp);
-		return SR_ERR;
-	}
+	sr_err("Unknown option '%s'.", str);
 
-	return SR_OK;
+	return SR_ERR;
 }
 
-static int analog_channel_state_get(struct sr_scpi_dev_inst *scpi,
-				    struct scope_config *config,
-				    struct scope_state *state)
+static void analog_channel_state_add(struct sr_scpi_batch *batch,
+				     struct scope_config *config,
+				     struct scope_state *state,
+				     char **coupling)
 {
 	unsigned int i;
-	char command[MAX_COMMAND_SIZE];
 
 	for (i = 0; i < config->analog_channels; ++i) {
-		g_snprintf(command, sizeof(command),
-			   (*config->scpi_dialect)[SCPI_CMD_GET_ANALOG_CHAN_STATE],
-			   i + 1);
-
-		if (sr_scpi_get_bool(scpi, command,
-				     &state->analog_channels[i].state) != SR_OK)
-			return SR_ERR;
-
-		g_snprintf(command, sizeof(command),
-			   (*config->scpi_dialect)[SCPI_CMD_GET_VERTICAL_DIV],
-			   i + 1);
-
-		if (sr_scpi_get_float(scpi, command,
-				     &state->analog_channels[i].vdiv) != SR_OK)
-			return SR_ERR;
-
-		g_snprintf(command, sizeof(command),
-			   (*config->scpi_dialect)[SCPI_CMD_GET_VERTICAL_OFFSET],
-			   i + 1);
-
-		if (sr_scpi_get_float(scpi, command,
-				     &state->analog_channels[i].vertical_offset) != SR_OK)
-			return SR_ERR;
-
-		g_snprintf(command, sizeof(command),
-			   (*config->scpi_dialect)[SCPI_CMD_GET_COUPLING],
-			   i + 1);
-
-		if (scope_state_get_array_option(scpi, command, config->coupling_options,
-					 &state->analog_channels[i].coupling) != SR_OK)
-			return SR_ERR;
+		sr_scpi_batch_add(batch, SCPI_BATCH_BOOL,
+			&state->analog_channels[i].state,
+			(*config->scpi_dialect)[SCPI_CMD_GET_ANALOG_CHAN_STATE],
+			i + 1);
+		sr_scpi_batch_add(batch, SCPI_BATCH_FLOAT,
+			&state->analog_channels[i].vdiv,
+			(*config->scpi_dialect)[SCPI_CMD_GET_VERTICAL_DIV],
+			i + 1);
+		sr_scpi_batch_add(batch, SCPI_BATCH_FLOAT,
+			&state->analog_channels[i].vertical_offset,
+			(*config->scpi_dialect)[SCPI_CMD_GET_VERTICAL_OFFSET],
+			i + 1);
+		sr_scpi_batch_add(batch, SCPI_BATCH_STRING, &coupling[i],
+			(*config->scpi_dialect)[SCPI_CMD_GET_COUPLING],
+			i + 1);
 	}
-
-	return SR_OK;
 }
 
-static int digital_channel_state_get(struct sr_scpi_dev_inst *scpi,
-				     struct scope_config *config,
-				     struct scope_state *state)
+static void digital_channel_state_add(struct sr_scpi_batch *batch,
+				      struct scope_config *config,
+				      struct scope_state *state)
 {
 	unsigned int i;
-	char command[MAX_COMMAND_SIZE];
-
-	for (i = 0; i < config->digital_channels; ++i) {
-		g_snprintf(command, sizeof(command),
-			   (*config->scpi_dialect)[SCPI_CMD_GET_DIG_CHAN_STATE],
-			   i);
-
-		if (sr_scpi_get_bool(scpi, command,
-				     &state->digital_channels[i]) != SR_OK)
-			return SR_ERR;
-	}
-
-	for (i = 0; i < config->digital_pods; ++i) {
-		g_snprintf(command, sizeof(command),
-			   (*config->scpi_dialect)[SCPI_CMD_GET_DIG_POD_STATE],
-			   i + 1);
 
-		if (sr_scpi_get_bool(scpi, command,
-				     &state->digital_pods[i]) != SR_OK)
-			return SR_ERR;
-	}
-
-	return SR_OK;
+	for (i = 0; i < config->digital_channels; ++i)
+		sr_scpi_batch_add(batch, SCPI_BATCH_BOOL,
+			&state->digital_channels[i],
+			(*config->scpi_dialect)[SCPI_CMD_GET_DIG_CHAN_STATE],
+			i);
+
+	for (i = 0; i < config->digital_pods; ++i)
+		sr_scpi_batch_add(batch, SCPI_BATCH_BOOL,
+			&state->digital_pods[i],
+			(*config->scpi_dialect)[SCPI_CMD_GET_DIG_POD_STATE],
+			i + 1);
 }
 
 SR_PRIV int hmo_scope_state_get(struct sr_dev_inst *sdi)
@@ -389,36 +349,52 @@ SR_PRIV int hmo_scope_state_get(struct sr_dev_inst *sdi)
 	struct dev_context *devc;
 	struct scope_state *state;
 	struct scope_config *config;
+	struct sr_scpi_batch *batch;
+	unsigned int i;
+	int ret;
+	char **coupling, *trigger_source, *trigger_slope;
 
 	devc = sdi->priv;
 	config = devc->model_config;
 	state = devc->model_state;
 
-	if (analog_channel_state_get(sdi->conn, config, state) != SR_OK)
-		return SR_ERR;
-
-	if (digital_channel_state_get(sdi->conn, config, state) != SR_OK)
-		return SR_ERR;
+	coupling = g_malloc0(config->analog_channels * sizeof(char *));
+	trigger_source = trigger_slope = NULL;
 
+	/* The whole state is read in a few compound queries. */
+	batch = sr_scpi_batch_new();
+	analog_channel_state_add(batch, config, state, coupling);
+	digital_channel_state_add(batch, config, state);
 	/* TODO: Check if value is sensible. */
-	if (sr_scpi_get_float(sdi->conn,
-			(*config->scpi_dialect)[SCPI_CMD_GET_TIMEBASE],
-			&state->timebase) != SR_OK)
-		return SR_ERR;
-
-	if (sr_scpi_get_float(sdi->conn,
-			(*config->scpi_dialect)[SCPI_CMD_GET_HORIZ_TRIGGERPOS],
-			&state->horiz_triggerpos) != SR_OK)
-		return SR_ERR;
-
-	if (scope_state_get_array_option(sdi->conn,
-			(*config->scpi_dialect)[SCPI_CMD_GET_TRIGGER_SOURCE],
-			config->trigger_sources, &state->trigger_source) != SR_OK)
-		return SR_ERR;
-
-	if (scope_state_get_array_option(sdi->conn,
-		(*config->scpi_dialect)[SCPI_CMD_GET_TRIGGER_SLOPE],
-		config->trigger_slopes, &state->trigger_slope) != SR_OK)
+	sr_scpi_batch_add(batch, SCPI_BATCH_FLOAT, &state->timebase,
+			  (*config->scpi_dialect)[SCPI_CMD_GET_TIMEBASE]);
+	sr_scpi_batch_add(batch, SCPI_BATCH_FLOAT, &state->horiz_triggerpos,
+			  (*config->scpi_dialect)[SCPI_CMD_GET_HORIZ_TRIGGERPOS]);
+	sr_scpi_batch_add(batch, SCPI_BATCH_STRING, &trigger_source,
+			  (*config->scpi_dialect)[SCPI_CMD_GET_TRIGGER_SOURCE]);
+	sr_scpi_batch_add(batch, SCPI_BATCH_STRING, &trigger_slope,
+			  (*config->scpi_dialect)[SCPI_CMD_GET_TRIGGER_SLOPE]);
+
+	ret = sr_scpi_batch_run(sdi->conn, batch, TRUE);
+	sr_scpi_batch_free(batch);
+
+	for (i = 0; i < config->analog_channels && ret == SR_OK; ++i)
+		ret = array_option_get(coupling[i], config->coupling_options,
+				       &state->analog_channels[i].coupling);
+	if (ret == SR_OK)
+		ret = array_option_get(trigger_source, config->trigger_sources,
+				       &state->trigger_source);
+	if (ret == SR_OK)
+		ret = array_option_get(trigger_slope, config->trigger_slopes,
+				       &state->trigger_slope);
+
+	for (i = 0; i < config->analog_channels; ++i)
+		g_free(coupling[i]);
+	g_free(coupling);
+	g_free(trigger_source);
+	g_free(trigger_slope);
+
+	if (ret != SR_OK)
 		return SR_ERR;
 
 	scope_state_dump(config, state);
@@ -546,15 +522,40 @@ SR_PRIV int hmo_init_device(struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
+/* Convert little endian IEEE 754 floats to host byte order, in place. */
+static void hmo_floats_from_le(uint8_t *buf, unsigned int num)
+{
+#ifdef WORDS_BIGENDIAN
+	unsigned int i;
+	uint32_t tmp;
+
+	for (i = 0; i < num; i++, buf += sizeof(float)) {
+		tmp = RL32(buf);
+		memcpy(buf, &tmp, sizeof(float));
+	}
+#else
+	(void)buf;
+	(void)num;
+#endif
+}
+
+/*
+ * Waveforms are fetched as binary blocks (FORM REAL for analog channels,
+ * FORM UINT,8 for the logic pods), one enabled probe at a time. As soon
+ * as a block has been read completely, the query for the next probe is
+ * sent, so the scope prepares it while the current one is being
+ * converted and sent to the session bus.
+ */
 SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 {
 	struct sr_probe *probe;
 	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
-	GArray *data;
+	GByteArray *data;
 	struct sr_datafeed_analog analog;
 	struct sr_datafeed_logic logic;
+	gboolean frame_done, acq_done;
 
 	(void)fd;
 
@@ -564,70 +565,66 @@ SR_PRIV int hmo_receive_data(int fd, int revents, void *cb_data)
 	if (!(devc = sdi->priv))
 		return TRUE;
 
-	if (revents == G_IO_IN) {
-		probe = devc->current_probe->data;
+	if (revents != G_IO_IN)
+		return TRUE;
 
-		switch (probe->type) {
-		case SR_PROBE_ANALOG:
-			if (sr_scpi_get_floatv(sdi->conn, NULL, &data) != SR_OK) {
-				if (data)
-					g_array_free(data, TRUE);
+	probe = devc->current_probe->data;
+	data = devc->block;
 
-				return TRUE;
-			}
+	if (sr_scpi_get_block(sdi->conn, NULL, data) != SR_OK)
+		return TRUE;
 
-			packet.type = SR_DF_FRAME_BEGIN;
-			sr_session_send(sdi, &packet);
-
-			analog.probes = g_slist_append(NULL, probe);
-			analog.num_samples = data->len;
-			analog.data = (float *) data->data;
-			analog.mq = SR_MQ_VOLTAGE;
-			analog.unit = SR_UNIT_VOLT;
-			analog.mqflags = 0;
-			packet.type = SR_DF_ANALOG;
-			packet.payload = &analog;
-			sr_session_send(cb_data, &packet);
-			g_slist_free(analog.probes);
-			g_array_free(data, TRUE);
-			break;
-		case SR_PROBE_LOGIC:
-			if (sr_scpi_get_uint8v(sdi->conn, NULL, &data) != SR_OK) {
-				if (data)
-					g_free(data);
-				return TRUE;
-			}
+	frame_done = !devc->current_probe->next;
+	if (frame_done)
+		devc->num_frames++;
+	acq_done = frame_done && devc->num_frames == devc->frame_limit;
 
-			packet.type = SR_DF_FRAME_BEGIN;
-			sr_session_send(sdi, &packet);
+	/* Get the next query in flight before doing any work on this one. */
+	if (!acq_done) {
+		if (frame_done)
+			devc->current_probe = devc->enabled_probes;
+		else
+			devc->current_probe = devc->current_probe->next;
+		hmo_request_data(sdi);
+	}
 
-			logic.length = data->len;
-			logic.unitsize = 1;
-			logic.data = data->data;
-			packet.type = SR_DF_LOGIC;
-			packet.payload = &logic;
-			sr_session_send(cb_data, &packet);
-			g_array_free(data, TRUE);
-			break;
-		default:
-			sr_err("Invalid probe type.");
-			break;
-		}
+	packet.type = SR_DF_FRAME_BEGIN;
+	sr_session_send(sdi, &packet);
+
+	switch (probe->type) {
+	case SR_PROBE_ANALOG:
+		hmo_floats_from_le(data->data, data->len / sizeof(float));
+		analog.probes = g_slist_append(NULL, probe);
+		analog.num_samples = data->len / sizeof(float);
+		analog.data = (float *)data->data;
+		analog.mq = SR_MQ_VOLTAGE;
+		analog.unit = SR_UNIT_VOLT;
+		analog.mqflags = 0;
+		packet.type = SR_DF_ANALOG;
+		packet.payload = &analog;
+		sr_session_send(cb_data, &packet);
+		g_slist_free(analog.probes);
+		break;
+	case SR_PROBE_LOGIC:
+		logic.length = data->len;
+		logic.unitsize = 1;
+		logic.data = data->data;
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		sr_session_send(cb_data, &packet);
+		break;
+	default:
+		sr_err("Invalid probe type.");
+		break;
+	}
 
-		packet.type = SR_DF_FRAME_END;
-		sr_session_send(sdi, &packet);
+	packet.type = SR_DF_FRAME_END;
+	sr_session_send(sdi, &packet);
 
-		if (devc->current_probe->next) {
-			devc->current_probe = devc->current_probe->next;
-			hmo_request_data(sdi);
-		} else if (++devc->num_frames == devc->frame_limit) {
-			packet.type = SR_DF_END;
-			sr_session_send(sdi, &packet);
-			sdi->driver->dev_acquisition_stop(sdi, cb_data);
-		} else {
-			devc->current_probe = devc->enabled_probes;
-			hmo_request_data(sdi);
-		}
+	if (acq_done) {
+		packet.type = SR_DF_END;
+		sr_session_send(sdi, &packet);
+		sdi->driver->dev_acquisition_stop(sdi, cb_data);
 	}
 
 	return TRUE;
@@ -29,7 +29,7 @@
 #define LOG_PREFIX "hameg-hmo"
 
 #define MAX_INSTRUMENT_VERSIONS 10
-#define MAX_COMMAND_SIZE 31
+#define MAX_COMMAND_SIZE 48
 
 struct scope_config {
 	const char *name[MAX_INSTRUMENT_VERSIONS];
@@ -99,6 +99,9 @@ struct dev_context {
 	GSList *current_probe;
 	uint64_t num_frames;
 
+	/* Waveform block buffer, reused for all probes and frames. */
+	GByteArray *block;
+
 	uint64_t frame_limit;
 };
 
@@ -262,7 +262,8 @@ static GSList *scan(GSList *options)
 	struct sr_usb_dev_inst *usb;
 	struct sr_config *src;
 	const struct dso_profile *prof;
-	GSList *l, *devices, *conn_devices;
+	struct ezusb_fw_upload *upload;
+	GSList *l, *devices, *conn_devices, *uploads;
 	struct libusb_device_descriptor des;
 	libusb_device **devlist;
 	int devcnt, ret, i, j;
@@ -272,6 +273,7 @@ static GSList *scan(GSList *options)
 
 	devcnt = 0;
 	devices = 0;
+	uploads = NULL;
 
 	conn = NULL;
 	for (l = options; l; l = l->next) {
@@ -287,7 +289,7 @@ static GSList *scan(GSList *options)
 		conn_devices = NULL;
 
 	/* Find all Hantek DSO devices and upload firmware to all of them. */
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	sr_usb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
 	for (i = 0; devlist[i]; i++) {
 		if (conn) {
 			usb = NULL;
@@ -318,17 +320,17 @@ static GSList *scan(GSList *options)
 				sr_dbg("Found a %s %s.", prof->vendor, prof->model);
 				sdi = dso_dev_new(devcnt, prof);
 				devices = g_slist_append(devices, sdi);
-				devc = sdi->priv;
-				if (ezusb_upload_firmware(devlist[i], USB_CONFIGURATION,
-						prof->firmware) == SR_OK)
-					/* Remember when the firmware on this device was updated */
-					devc->fw_updated = g_get_monotonic_time();
+				if ((upload = ezusb_fw_upload_new(devlist[i],
+						USB_CONFIGURATION, prof->firmware, sdi)))
+					uploads = g_slist_append(uploads, upload);
 				else
 					sr_err("Firmware upload failed for "
 					        "device %d.", devcnt);
 				/* Dummy USB address of 0xff will get overwritten later. */
 				sdi->conn = sr_usb_dev_inst_new(
 						libusb_get_bus_number(devlist[i]), 0xff, NULL);
+				if (sdi->conn)
+					usb_dev_inst_set_port_path(sdi->conn, devlist[i]);
 				devcnt++;
 				break;
 			} else if (des.idVendor == dev_profiles[j].fw_vid
@@ -354,6 +356,21 @@ static GSList *scan(GSList *options)
 	}
 	libusb_free_device_list(devlist, 1);
 
+	/* Upload to all devices at once, they renumerate in parallel. */
+	ezusb_upload_firmware_all(uploads);
+	for (l = uploads; l; l = l->next) {
+		upload = l->data;
+		sdi = upload->user_data;
+		devc = sdi->priv;
+		if (upload->ret == SR_OK)
+			/* Remember when the firmware on this device was updated. */
+			devc->fw_updated = upload->done;
+		else
+			sr_err("Firmware upload failed for "
+			       "device %d.", sdi->index);
+	}
+	g_slist_free_full(uploads, (GDestroyNotify)ezusb_fw_upload_free);
+
 	return devices;
 }
 
@@ -364,11 +381,12 @@ static GSList *dev_list(void)
 
 static int dev_open(struct sr_dev_inst *sdi)
 {
+	struct drv_context *drvc;
 	struct dev_context *devc;
 	struct sr_usb_dev_inst *usb;
-	int64_t timediff_us, timediff_ms;
 	int err;
 
+	drvc = di->priv;
 	devc = sdi->priv;
 	usb = sdi->conn;
 
@@ -376,21 +394,10 @@ static int dev_open(struct sr_dev_inst *sdi)
 	 * If the firmware was recently uploaded, wait up to MAX_RENUM_DELAY_MS
 	 * for the FX2 to renumerate.
 	 */
-	err = SR_ERR;
 	if (devc->fw_updated > 0) {
-		sr_info("Waiting for device to reset.");
-		/* Takes >= 300ms for the FX2 to be gone from the USB bus. */
-		g_usleep(300 * 1000);
-		timediff_ms = 0;
-		while (timediff_ms < MAX_RENUM_DELAY_MS) {
-			if ((err = dso_open(sdi)) == SR_OK)
-				break;
-			g_usleep(100 * 1000);
-			timediff_us = g_get_monotonic_time() - devc->fw_updated;
-			timediff_ms = timediff_us / 1000;
-			sr_spew("Waited %" PRIi64 " ms.", timediff_ms);
-		}
-		sr_info("Device came back after %d ms.", timediff_ms);
+		err = usb_wait_for_renumeration(drvc->sr_ctx, sdi,
+				devc->profile->fw_vid, devc->profile->fw_pid,
+				devc->fw_updated, MAX_RENUM_DELAY_MS, dso_open);
 	} else {
 		err = dso_open(sdi);
 	}
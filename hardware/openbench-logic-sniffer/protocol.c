@@ -403,6 +403,7 @@ SR_PRIV int ols_receive_data(int fd, int revents, void *cb_data)
 	if (revents == G_IO_IN && devc->num_samples < devc->limit_samples) {
 		if (serial_read_nonblocking(serial, &byte, 1) != 1)
 			return FALSE;
+		sdi->stats.bytes_received++;
 
 		/* Ignore it if we've read enough. */
 		if (devc->num_samples >= devc->limit_samples)
@@ -454,6 +454,10 @@ static int dev_open(struct sr_dev_inst *sdi)
 	if (rigol_ds_get_dev_cfg(sdi) != SR_OK)
 		return SR_ERR;
 
+	/* All settings are known now, there's no need to ask again. */
+	if (sr_config_cache_enable(sdi) != SR_OK)
+		return SR_ERR_MALLOC;
+
 	sdi->status = SR_ST_ACTIVE;
 
 	return SR_OK;
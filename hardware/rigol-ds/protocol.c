@@ -25,7 +25,6 @@
 #include <errno.h>
 #include <string.h>
 #include <math.h>
-#include <ctype.h>
 #include <time.h>
 #include <glib.h>
 #include "libsigrok.h"
@@ -361,46 +360,6 @@ SR_PRIV int rigol_ds_channel_start(const struct sr_dev_inst *sdi)
 	return SR_OK;
 }
 
-/* Read the header of a data block */
-static int rigol_ds_read_header(struct sr_scpi_dev_inst *scpi)
-{
-	char start[3], length[10];
-	int len, tmp;
-
-	/* Read the hashsign and length digit. */
-	tmp = sr_scpi_read_data(scpi, start, 2);
-	start[2] = '\0';
-	if (tmp != 2)
-	{
-		sr_err("Failed to read first two bytes of data block header.");
-		return -1;
-	}
-	if (start[0] != '#' || !isdigit(start[1]) || start[1] == '0')
-	{
-		sr_err("Received invalid data block header start '%s'.", start);
-		return -1;
-	}
-	len = atoi(start + 1);
-
-	/* Read the data length. */
-	tmp = sr_scpi_read_data(scpi, length, len);
-	length[len] = '\0';
-	if (tmp != len)
-	{
-		sr_err("Failed to read %d bytes of data block length.", len);
-		return -1;
-	}
-	if (parse_int(length, &len) != SR_OK)
-	{
-		sr_err("Received invalid data block length '%s'.", length);
-		return -1;
-	}
-
-	sr_dbg("Received data block header: %s%s -> block length %d", start, length, len);
-
-	return len;
-}
-
 SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 {
 	struct sr_dev_inst *sdi;
@@ -468,8 +427,9 @@ SR_PRIV int rigol_ds_receive(int fd, int revents, void *cb_data)
 				return TRUE;
 			if (devc->model->protocol == PROTOCOL_IEEE488_2) {
 				sr_dbg("New block header expected");
-				len = rigol_ds_read_header(scpi);
-				if (len == -1)
+				sr_scpi_block_init(&devc->block);
+				len = sr_scpi_block_read_header(scpi, &devc->block);
+				if (len < 0)
 					return TRUE;
 				/* At slow timebases in live capture the DS2072
 				 * sometimes returns "short" data blocks, with
@@ -650,135 +610,106 @@ static int get_cfg_int(const struct sr_dev_inst *sdi, char *cmd, int *i)
 	return SR_OK;
 }
 
-static int get_cfg_float(const struct sr_dev_inst *sdi, char *cmd, float *f)
-{
-	char buf[32], *e;
-
-	if (get_cfg(sdi, cmd, buf, sizeof(buf)) != SR_OK)
-		return SR_ERR;
-	*f = strtof(buf, &e);
-	if (e == buf || (fpclassify(*f) & (FP_ZERO | FP_NORMAL)) == 0) {
-		sr_dbg("failed to parse response to '%s': '%s'", cmd, buf);
-		return SR_ERR;
-	}
-
-	return SR_OK;
-}
-
-static int get_cfg_string(const struct sr_dev_inst *sdi, char *cmd, char **buf)
-{
-	if (!(*buf = g_try_malloc0(256)))
-		return SR_ERR_MALLOC;
-
-	if (get_cfg(sdi, cmd, *buf, 256) != SR_OK)
-		return SR_ERR;
-
-	return SR_OK;
-}
-
 SR_PRIV int rigol_ds_get_dev_cfg(const struct sr_dev_inst *sdi)
 {
 	struct dev_context *devc;
-	char *t_s, *cmd;
+	struct sr_scpi_batch *batch;
 	unsigned int i;
-	int res;
+	int ret;
 
 	devc = sdi->priv;
 
-	/* Analog channel state. */
+	/* Free the strings of a previous readout, they are read anew. */
 	for (i = 0; i < devc->model->analog_channels; i++) {
-		cmd = g_strdup_printf(":CHAN%d:DISP?", i + 1);
-		res = get_cfg_string(sdi, cmd, &t_s);
-		g_free(cmd);
-		if (res != SR_OK)
-			return SR_ERR;
-		devc->analog_channels[i] = !strcmp(t_s, "ON") || !strcmp(t_s, "1");
+		g_free(devc->coupling[i]);
+		devc->coupling[i] = NULL;
 	}
+	g_free(devc->trigger_source);
+	devc->trigger_source = NULL;
+	g_free(devc->trigger_slope);
+	devc->trigger_slope = NULL;
+
+	/* All settings are read in as few round trips as possible. */
+	batch = sr_scpi_batch_new();
+	for (i = 0; i < devc->model->analog_channels; i++)
+		sr_scpi_batch_add(batch, SCPI_BATCH_BOOL,
+				  &devc->analog_channels[i],
+				  ":CHAN%d:DISP?", i + 1);
+	if (devc->model->has_digital) {
+		for (i = 0; i < 16; i++)
+			sr_scpi_batch_add(batch, SCPI_BATCH_BOOL,
+					  &devc->digital_channels[i],
+					  ":DIG%d:TURN?", i + 1);
+	}
+	sr_scpi_batch_add(batch, SCPI_BATCH_FLOAT, &devc->timebase,
+			  ":TIM:SCAL?");
+	for (i = 0; i < devc->model->analog_channels; i++)
+		sr_scpi_batch_add(batch, SCPI_BATCH_FLOAT, &devc->vdiv[i],
+				  ":CHAN%d:SCAL?", i + 1);
+	if (devc->model->protocol == PROTOCOL_IEEE488_2) {
+		/* Vertical reference - not certain if this is the place to read it. */
+		for (i = 0; i < devc->model->analog_channels; i++) {
+			sr_scpi_batch_add(batch, SCPI_BATCH_CMD, NULL,
+					  ":WAV:SOUR CHAN%d", i + 1);
+			sr_scpi_batch_add(batch, SCPI_BATCH_INT,
+					  &devc->vert_reference[i],
+					  ":WAV:YREF?");
+		}
+	}
+	for (i = 0; i < devc->model->analog_channels; i++)
+		sr_scpi_batch_add(batch, SCPI_BATCH_FLOAT,
+				  &devc->vert_offset[i],
+				  ":CHAN%d:OFFS?", i + 1);
+	for (i = 0; i < devc->model->analog_channels; i++)
+		sr_scpi_batch_add(batch, SCPI_BATCH_STRING,
+				  &devc->coupling[i],
+				  ":CHAN%d:COUP?", i + 1);
+	sr_scpi_batch_add(batch, SCPI_BATCH_STRING, &devc->trigger_source,
+			  ":TRIG:EDGE:SOUR?");
+	sr_scpi_batch_add(batch, SCPI_BATCH_FLOAT, &devc->horiz_triggerpos,
+			  ":TIM:OFFS?");
+	sr_scpi_batch_add(batch, SCPI_BATCH_STRING, &devc->trigger_slope,
+			  ":TRIG:EDGE:SLOP?");
+
+	/* The legacy protocol predates compound messages. */
+	ret = sr_scpi_batch_run(sdi->conn, batch,
+			devc->model->protocol == PROTOCOL_IEEE488_2);
+	sr_scpi_batch_free(batch);
+	if (ret != SR_OK)
+		return SR_ERR;
+
 	sr_dbg("Current analog channel state:");
 	for (i = 0; i < devc->model->analog_channels; i++)
 		sr_dbg("CH%d %s", i + 1, devc->analog_channels[i] ? "on" : "off");
 
-	/* Digital channel state. */
 	if (devc->model->has_digital) {
 		sr_dbg("Current digital channel state:");
-		for (i = 0; i < 16; i++) {
-			cmd = g_strdup_printf(":DIG%d:TURN?", i + 1);
-			res = get_cfg_string(sdi, cmd, &t_s);
-			g_free(cmd);
-			if (res != SR_OK)
-				return SR_ERR;
-			devc->digital_channels[i] = !strcmp(t_s, "ON") ? TRUE : FALSE;
-			g_free(t_s);
+		for (i = 0; i < 16; i++)
 			sr_dbg("D%d: %s", i + 1, devc->digital_channels[i] ? "on" : "off");
-		}
 	}
 
-	/* Timebase. */
-	if (get_cfg_float(sdi, ":TIM:SCAL?", &devc->timebase) != SR_OK)
-		return SR_ERR;
 	sr_dbg("Current timebase %g", devc->timebase);
 
-	/* Vertical gain. */
-	for (i = 0; i < devc->model->analog_channels; i++) {
-		cmd = g_strdup_printf(":CHAN%d:SCAL?", i + 1);
-		res = get_cfg_float(sdi, cmd, &devc->vdiv[i]);
-		g_free(cmd);
-		if (res != SR_OK)
-			return SR_ERR;
-	}
 	sr_dbg("Current vertical gain:");
 	for (i = 0; i < devc->model->analog_channels; i++)
 		sr_dbg("CH%d %g", i + 1, devc->vdiv[i]);
 
-	sr_dbg("Current vertical reference:");
 	if (devc->model->protocol == PROTOCOL_IEEE488_2) {
-		/* Vertical reference - not certain if this is the place to read it. */
-		for (i = 0; i < devc->model->analog_channels; i++) {
-			if (sr_scpi_send(sdi->conn, ":WAV:SOUR CHAN%d", i + 1) != SR_OK)
-				return SR_ERR;
-			if (get_cfg_int(sdi, ":WAV:YREF?", &devc->vert_reference[i]) != SR_OK)
-				return SR_ERR;
+		sr_dbg("Current vertical reference:");
+		for (i = 0; i < devc->model->analog_channels; i++)
 			sr_dbg("CH%d %d", i + 1, devc->vert_reference[i]);
-		}
 	}
 
-	/* Vertical offset. */
-	for (i = 0; i < devc->model->analog_channels; i++) {
-		cmd = g_strdup_printf(":CHAN%d:OFFS?", i + 1);
-		res = get_cfg_float(sdi, cmd, &devc->vert_offset[i]);
-		g_free(cmd);
-		if (res != SR_OK)
-			return SR_ERR;
-	}
 	sr_dbg("Current vertical offset:");
 	for (i = 0; i < devc->model->analog_channels; i++)
 		sr_dbg("CH%d %g", i + 1, devc->vert_offset[i]);
 
-	/* Coupling. */
-	for (i = 0; i < devc->model->analog_channels; i++) {
-		cmd = g_strdup_printf(":CHAN%d:COUP?", i + 1);
-		res = get_cfg_string(sdi, cmd, &devc->coupling[i]);
-		g_free(cmd);
-		if (res != SR_OK)
-			return SR_ERR;
-	}
 	sr_dbg("Current coupling:");
 	for (i = 0; i < devc->model->analog_channels; i++)
 		sr_dbg("CH%d %s", i + 1, devc->coupling[i]);
 
-	/* Trigger source. */
-	if (get_cfg_string(sdi, ":TRIG:EDGE:SOUR?", &devc->trigger_source) != SR_OK)
-		return SR_ERR;
 	sr_dbg("Current trigger source %s", devc->trigger_source);
-
-	/* Horizontal trigger position. */
-	if (get_cfg_float(sdi, ":TIM:OFFS?", &devc->horiz_triggerpos) != SR_OK)
-		return SR_ERR;
 	sr_dbg("Current horizontal trigger position %g", devc->horiz_triggerpos);
-
-	/* Trigger slope. */
-	if (get_cfg_string(sdi, ":TRIG:EDGE:SLOP?", &devc->trigger_slope) != SR_OK)
-		return SR_ERR;
 	sr_dbg("Current trigger slope %s", devc->trigger_slope);
 
 	return SR_OK;
@@ -138,7 +138,8 @@ static GSList *scan(GSList *options)
 	struct sr_usb_dev_inst *usb;
 	struct sr_probe *probe;
 	struct sr_config *src;
-	GSList *l, *devices, *conn_devices;
+	struct ezusb_fw_upload *upload;
+	GSList *l, *devices, *conn_devices, *uploads;
 	struct libusb_device_descriptor des;
 	libusb_device **devlist;
 	int devcnt, ret, i, j;
@@ -162,7 +163,8 @@ static GSList *scan(GSList *options)
 
 	/* Find all Logic16 devices and upload firmware to them. */
 	devices = NULL;
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	uploads = NULL;
+	sr_usb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
 	for (i = 0; devlist[i]; i++) {
 		if (conn) {
 			usb = NULL;
@@ -217,21 +219,37 @@ static GSList *scan(GSList *options)
 				libusb_get_bus_number(devlist[i]),
 				libusb_get_device_address(devlist[i]), NULL);
 		} else {
-			if (ezusb_upload_firmware(devlist[i], USB_CONFIGURATION,
-						  FX2_FIRMWARE) == SR_OK)
-				/* Store when this device's FW was updated. */
-				devc->fw_updated = g_get_monotonic_time();
+			if ((upload = ezusb_fw_upload_new(devlist[i],
+					USB_CONFIGURATION, FX2_FIRMWARE, sdi)))
+				uploads = g_slist_append(uploads, upload);
 			else
 				sr_err("Firmware upload failed for "
 				       "device %d.", devcnt);
 			sdi->inst_type = SR_INST_USB;
 			sdi->conn = sr_usb_dev_inst_new(
 				libusb_get_bus_number(devlist[i]), 0xff, NULL);
+			if (sdi->conn)
+				usb_dev_inst_set_port_path(sdi->conn, devlist[i]);
 		}
 	}
 	libusb_free_device_list(devlist, 1);
 	g_slist_free_full(conn_devices, (GDestroyNotify)sr_usb_dev_inst_free);
 
+	/* Upload to all devices at once, they renumerate in parallel. */
+	ezusb_upload_firmware_all(uploads);
+	for (l = uploads; l; l = l->next) {
+		upload = l->data;
+		sdi = upload->user_data;
+		devc = sdi->priv;
+		if (upload->ret == SR_OK)
+			/* Store when this device's FW was updated. */
+			devc->fw_updated = upload->done;
+		else
+			sr_err("Firmware upload failed for "
+			       "device %d.", sdi->index);
+	}
+	g_slist_free_full(uploads, (GDestroyNotify)ezusb_fw_upload_free);
+
 	return devices;
 }
 
@@ -349,36 +367,21 @@ static int logic16_dev_open(struct sr_dev_inst *sdi)
 
 static int dev_open(struct sr_dev_inst *sdi)
 {
+	struct drv_context *drvc;
 	struct dev_context *devc;
 	int ret;
-	int64_t timediff_us, timediff_ms;
 
+	drvc = di->priv;
 	devc = sdi->priv;
 
 	/*
 	 * If the firmware was recently uploaded, wait up to MAX_RENUM_DELAY_MS
 	 * milliseconds for the FX2 to renumerate.
 	 */
-	ret = SR_ERR;
 	if (devc->fw_updated > 0) {
-		sr_info("Waiting for device to reset.");
-		/* Takes >= 300ms for the FX2 to be gone from the USB bus. */
-		g_usleep(300 * 1000);
-		timediff_ms = 0;
-		while (timediff_ms < MAX_RENUM_DELAY_MS) {
-			if ((ret = logic16_dev_open(sdi)) == SR_OK)
-				break;
-			g_usleep(100 * 1000);
-
-			timediff_us = g_get_monotonic_time() - devc->fw_updated;
-			timediff_ms = timediff_us / 1000;
-			sr_spew("Waited %" PRIi64 "ms.", timediff_ms);
-		}
-		if (ret != SR_OK) {
-			sr_err("Device failed to renumerate.");
-			return SR_ERR;
-		}
-		sr_info("Device came back after %" PRIi64 "ms.", timediff_ms);
+		ret = usb_wait_for_renumeration(drvc->sr_ctx, sdi,
+				LOGIC16_VID, LOGIC16_PID, devc->fw_updated,
+				MAX_RENUM_DELAY_MS, logic16_dev_open);
 	} else {
 		sr_info("Firmware upload was not needed.");
 		ret = logic16_dev_open(sdi);
@@ -428,6 +431,8 @@ static int cleanup(void)
 	g_free(drvc);
 	di->priv = NULL;
 
+	logic16_bitstream_cache_free();
+
 	return ret;
 }
 
@@ -579,6 +584,7 @@ static void abort_acquisition(struct dev_context *devc)
 
 	devc->num_samples = -1;
 
+	usb_source_stop_resubmit(devc->ctx);
 	for (i = devc->num_transfers - 1; i >= 0; i--) {
 		if (devc->transfers[i])
 			libusb_cancel_transfer(devc->transfers[i]);
@@ -674,8 +680,11 @@ static int receive_data(int fd, int revents, void *cb_data)
 	drvc = di->priv;
 	devc = sdi->priv;
 
-	tv.tv_sec = tv.tv_usec = 0;
-	libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+	/* Events are handled elsewhere when the USB event thread runs. */
+	if (!usb_event_thread_running(drvc->sr_ctx)) {
+		tv.tv_sec = tv.tv_usec = 0;
+		libusb_handle_events_timeout(drvc->sr_ctx->libusb_ctx, &tv);
+	}
 
 	if (devc->num_samples == -2) {
 		logic16_abort_acquisition(sdi);
@@ -709,6 +718,7 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 		return SR_ERR;
 	}
 
+	devc->ctx = drvc->sr_ctx;
 	devc->cb_data = cb_data;
 	devc->num_samples = 0;
 	devc->empty_transfer_count = 0;
@@ -769,9 +779,8 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 		devc->submitted_transfers++;
 	}
 
-	devc->ctx = drvc->sr_ctx;
-
-	usb_source_add(devc->ctx, timeout, receive_data, (void *)sdi);
+	usb_source_add_threaded(devc->ctx, timeout, receive_data, (void *)sdi,
+			logic16_receive_buffer, num_transfers, size);
 
 	/* Send header packet to the session bus. */
 	std_session_send_df_header(cb_data, LOG_PREFIX);
@@ -807,6 +816,7 @@ SR_PRIV struct sr_dev_driver saleae_logic16_driver_info = {
 	.init = init,
 	.cleanup = cleanup,
 	.scan = scan,
+	.scan_threadsafe = TRUE,
 	.dev_list = dev_list,
 	.dev_clear = dev_clear,
 	.config_get = config_get,
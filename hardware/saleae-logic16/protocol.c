@@ -323,16 +323,78 @@ static int configure_led(const struct sr_dev_inst *sdi)
 	return set_led_mode(sdi, 1, 6250, 0, 1);
 }
 
+/* A bitstream, pre-encoded as COMMAND_FPGA_UPLOAD_SEND_DATA packets. */
+struct bitstream {
+	uint8_t *packets;
+	int len;
+};
+
+/* Bitstreams are only read from disk once per process. */
+static struct bitstream bitstream_cache[2];
+
+static int load_fpga_bitstream(const char *filename, struct bitstream *bs)
+{
+	uint8_t *data, command[64];
+	gsize size, offset;
+	GError *error;
+	int len;
+
+	error = NULL;
+	if (!g_file_get_contents(filename, (gchar **)&data, &size, &error)) {
+		sr_err("Unable to read bitstream file %s: %s.",
+		       filename, error->message);
+		g_error_free(error);
+		return SR_ERR;
+	}
+
+	/*
+	 * Every 62 bytes of bitstream become one encrypted 64 byte EP1
+	 * packet. Only the last one may be short, so all of them can be
+	 * sent back to back in a single bulk transfer.
+	 */
+	if (!(bs->packets = g_try_malloc((size / 62 + 1) * 64))) {
+		sr_err("Bitstream buffer malloc failed.");
+		g_free(data);
+		return SR_ERR_MALLOC;
+	}
+	bs->len = 0;
+	for (offset = 0; offset < size; offset += 62) {
+		len = (offset + 62 > size ? size - offset : 62);
+		command[0] = COMMAND_FPGA_UPLOAD_SEND_DATA;
+		command[1] = len;
+		memcpy(command + 2, data + offset, len);
+		encrypt(bs->packets + bs->len, command, len + 2);
+		bs->len += len + 2;
+	}
+	g_free(data);
+
+	sr_dbg("Loaded %zu byte bitstream %s.", (size_t)size, filename);
+
+	return SR_OK;
+}
+
+SR_PRIV void logic16_bitstream_cache_free(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(bitstream_cache); i++) {
+		g_free(bitstream_cache[i].packets);
+		bitstream_cache[i].packets = NULL;
+	}
+}
+
 static int upload_fpga_bitstream(const struct sr_dev_inst *sdi,
 				 enum voltage_range vrange)
 {
 	struct dev_context *devc;
-	int offset, chunksize, ret;
+	struct sr_usb_dev_inst *usb;
+	struct bitstream *bs;
+	int offset, chunksize, xfer, ret;
 	const char *filename;
-	uint8_t len, buf[256 * 62], command[64];
-	FILE *fw;
+	uint8_t buf[1];
 
 	devc = sdi->priv;
+	usb = sdi->conn;
 
 	if (devc->cur_voltage_range == vrange)
 		return SR_OK;
@@ -340,49 +402,46 @@ static int upload_fpga_bitstream(const struct sr_dev_inst *sdi,
 	switch (vrange) {
 	case VOLTAGE_RANGE_18_33_V:
 		filename = FPGA_FIRMWARE_18;
+		bs = &bitstream_cache[0];
 		break;
 	case VOLTAGE_RANGE_5_V:
 		filename = FPGA_FIRMWARE_33;
+		bs = &bitstream_cache[1];
 		break;
 	default:
 		sr_err("Unsupported voltage range.");
 		return SR_ERR;
 	}
 
+	if (!bs->packets && (ret = load_fpga_bitstream(filename, bs)) != SR_OK)
+		return ret;
+
 	sr_info("Uploading FPGA bitstream at %s.", filename);
-	if ((fw = g_fopen(filename, "rb")) == NULL) {
-		sr_err("Unable to open bitstream file %s for reading: %s.",
-		       filename, strerror(errno));
-		return SR_ERR;
-	}
 
 	buf[0] = COMMAND_FPGA_UPLOAD_INIT;
-	if ((ret = do_ep1_command(sdi, buf, 1, NULL, 0)) != SR_OK) {
-		fclose(fw);
+	if ((ret = do_ep1_command(sdi, buf, 1, NULL, 0)) != SR_OK)
 		return ret;
-	}
-
-	while (1) {
-		chunksize = fread(buf, 1, sizeof(buf), fw);
-		if (chunksize == 0)
-			break;
 
-		for (offset = 0; offset < chunksize; offset += 62) {
-			len = (offset + 62 > chunksize ?
-				chunksize - offset : 62);
-			command[0] = COMMAND_FPGA_UPLOAD_SEND_DATA;
-			command[1] = len;
-			memcpy(command + 2, buf + offset, len);
-			ret = do_ep1_command(sdi, command, len + 2, NULL, 0);
-			if (ret != SR_OK) {
-				fclose(fw);
-				return ret;
-			}
+	/*
+	 * The packets need no reply, so send many of them per transfer
+	 * and let the host controller stream them to the device.
+	 */
+	for (offset = 0; offset < bs->len; offset += chunksize) {
+		chunksize = MIN(bs->len - offset, 256 * 64);
+		ret = libusb_bulk_transfer(usb->devhdl, 1, bs->packets + offset,
+					   chunksize, &xfer, 1000);
+		if (ret != 0) {
+			sr_err("Failed to send FPGA bitstream: %s.",
+			       libusb_error_name(ret));
+			return SR_ERR;
 		}
-
-		sr_info("Uploaded %d bytes.", chunksize);
+		if (xfer != chunksize) {
+			sr_err("Failed to send FPGA bitstream: incorrect "
+			       "length %d != %d.", xfer, chunksize);
+			return SR_ERR;
+		}
+		sr_spew("Uploaded %d bytes.", offset + chunksize);
 	}
-	fclose(fw);
 	sr_info("FPGA bitstream upload done.");
 
 	if ((ret = prime_fpga(sdi)) != SR_OK)
@@ -617,20 +676,28 @@ static void free_transfer(struct libusb_transfer *transfer)
 
 static void resubmit_transfer(struct libusb_transfer *transfer)
 {
+	struct dev_context *devc;
+	struct sr_dev_inst *sdi;
 	int ret;
 
-	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS)
+	devc = transfer->user_data;
+	sdi = devc->cb_data;
+
+	if ((ret = libusb_submit_transfer(transfer)) == LIBUSB_SUCCESS) {
+		sdi->stats.transfers_resubmitted++;
 		return;
+	}
 
 	free_transfer(transfer);
 	/* TODO: Stop session? */
+	sr_trace(SR_TRACE_USB_RESUBMIT_FAILED, ret, 0);
 
 	sr_err("%s: %s", __func__, libusb_error_name(ret));
 }
 
-static size_t convert_sample_data(struct dev_context *devc,
-				  uint8_t *dest, size_t destcnt,
-				  const uint8_t *src, size_t srccnt)
+SR_PRIV size_t logic16_convert_sample_data(struct dev_context *devc,
+			uint8_t *dest, size_t destcnt,
+			const uint8_t *src, size_t srccnt)
 {
 	uint16_t *channel_data;
 	int i, cur_channel;
@@ -671,15 +738,49 @@ static size_t convert_sample_data(struct dev_context *devc,
 	return ret;
 }
 
-SR_PRIV void logic16_receive_transfer(struct libusb_transfer *transfer)
+/*
+ * Convert a buffer of samples and send them to the session bus.
+ * Returns FALSE once the sample limit has been reached.
+ */
+static gboolean send_samples(struct dev_context *devc, const uint8_t *buf,
+		int len)
 {
-	gboolean packet_has_error = FALSE;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-	struct dev_context *devc;
 	size_t converted_length;
 
+	converted_length = logic16_convert_sample_data(devc, devc->convbuffer,
+				devc->convbuffer_size, buf, len);
+
+	if (converted_length > 0) {
+		/* Send the incoming transfer to the session bus. */
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.length = converted_length;
+		logic.unitsize = 2;
+		logic.data = devc->convbuffer;
+		sr_session_send(devc->cb_data, &packet);
+
+		devc->num_samples += converted_length / 2;
+		if (devc->limit_samples &&
+		    (uint64_t)devc->num_samples > devc->limit_samples)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+SR_PRIV void logic16_receive_transfer(struct libusb_transfer *transfer)
+{
+	gboolean packet_has_error = FALSE;
+	struct dev_context *devc;
+	struct sr_dev_inst *sdi;
+
 	devc = transfer->user_data;
+	sdi = devc->cb_data;
+
+	if (usb_transfer_defer(devc->ctx, transfer))
+		return;
 
 	/*
 	 * If acquisition has already ended, just free any queued up
@@ -692,6 +793,8 @@ SR_PRIV void logic16_receive_transfer(struct libusb_transfer *transfer)
 
 	sr_info("receive_transfer(): status %d received %d bytes.",
 		transfer->status, transfer->actual_length);
+	sr_trace(SR_TRACE_USB_TRANSFER, transfer->status,
+		 transfer->actual_length);
 
 	switch (transfer->status) {
 	case LIBUSB_TRANSFER_NO_DEVICE:
@@ -706,6 +809,14 @@ SR_PRIV void logic16_receive_transfer(struct libusb_transfer *transfer)
 		break;
 	}
 
+	sdi->stats.bytes_received += transfer->actual_length;
+	if (packet_has_error)
+		sdi->stats.transfers_failed++;
+	else if (transfer->actual_length == 0)
+		sdi->stats.transfers_empty++;
+	else
+		sdi->stats.transfers_completed++;
+
 	if (transfer->actual_length & 1) {
 		sr_err("Got an odd number of bytes from the device. "
 		       "This should not happen.");
@@ -731,27 +842,42 @@ SR_PRIV void logic16_receive_transfer(struct libusb_transfer *transfer)
 		devc->empty_transfer_count = 0;
 	}
 
-	converted_length = convert_sample_data(devc, devc->convbuffer,
-				devc->convbuffer_size, transfer->buffer,
-				transfer->actual_length);
+	if (!send_samples(devc, transfer->buffer, transfer->actual_length)) {
+		devc->num_samples = -2;
+		free_transfer(transfer);
+		return;
+	}
 
-	if (converted_length > 0) {
-		/* Send the incoming transfer to the session bus. */
-		packet.type = SR_DF_LOGIC;
-		packet.payload = &logic;
-		logic.length = converted_length;
-		logic.unitsize = 2;
-		logic.data = devc->convbuffer;
-		sr_session_send(devc->cb_data, &packet);
+	resubmit_transfer(transfer);
+}
 
-		devc->num_samples += converted_length / 2;
-		if (devc->limit_samples &&
-		    (uint64_t)devc->num_samples > devc->limit_samples) {
-			devc->num_samples = -2;
-			free_transfer(transfer);
-			return;
-		}
+/*
+ * Handle a buffer from a transfer the USB event thread has already
+ * resubmitted.
+ */
+SR_PRIV void logic16_receive_buffer(uint8_t *buf, int len, void *user_data)
+{
+	struct dev_context *devc;
+	struct sr_dev_inst *sdi;
+
+	devc = user_data;
+	sdi = devc->cb_data;
+
+	if (devc->num_samples < 0)
+		return;
+
+	sdi->stats.bytes_received += len;
+	sdi->stats.transfers_completed++;
+	sdi->stats.transfers_resubmitted++;
+
+	if (len & 1) {
+		sr_err("Got an odd number of bytes from the device. "
+		       "This should not happen.");
+		devc->num_samples = -2;
+		return;
 	}
 
-	resubmit_transfer(transfer);
+	devc->empty_transfer_count = 0;
+	if (!send_samples(devc, buf, len))
+		devc->num_samples = -2;
 }
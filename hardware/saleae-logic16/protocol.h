@@ -83,6 +83,11 @@ SR_PRIV int logic16_setup_acquisition(const struct sr_dev_inst *sdi,
 SR_PRIV int logic16_start_acquisition(const struct sr_dev_inst *sdi);
 SR_PRIV int logic16_abort_acquisition(const struct sr_dev_inst *sdi);
 SR_PRIV int logic16_init_device(const struct sr_dev_inst *sdi);
+SR_PRIV void logic16_bitstream_cache_free(void);
+SR_PRIV size_t logic16_convert_sample_data(struct dev_context *devc,
+			uint8_t *dest, size_t destcnt,
+			const uint8_t *src, size_t srccnt);
 SR_PRIV void logic16_receive_transfer(struct libusb_transfer *transfer);
+SR_PRIV void logic16_receive_buffer(uint8_t *buf, int len, void *user_data);
 
 #endif
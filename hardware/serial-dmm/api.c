@@ -316,35 +316,139 @@ static int init(struct sr_context *sr_ctx, int dmm)
 	return std_init(sr_ctx, dmms[dmm].di, LOG_PREFIX);
 }
 
-static GSList *sdmm_scan(const char *conn, const char *serialcomm, int dmm)
-{
-	struct sr_dev_inst *sdi;
-	struct drv_context *drvc;
-	struct dev_context *devc;
-	struct sr_probe *probe;
-	struct sr_serial_dev_inst *serial;
-	GSList *devices;
-	int dropped, ret;
+/* Bytes read from a port are reused by other models for this long. */
+#define PROBE_CACHE_MS 30000
+
+#define PROBE_BUFSIZE 128
+
+/*
+ * The data read while probing a port with a given serialcomm. Probing
+ * checks it for the packets of every model sending unrequested packets
+ * with that serialcomm, so scanning for those models on the same port
+ * doesn't have to wait for the DMM again.
+ */
+struct probe_result {
+	char *conn;
+	char *serialcomm;
+	int64_t time;
+	uint8_t buf[PROBE_BUFSIZE];
 	size_t len;
-	uint8_t buf[128];
+};
 
-	if (!(serial = sr_serial_dev_inst_new(conn, serialcomm)))
-		return NULL;
+static GSList *probe_results = NULL;
+
+static void probe_result_free(struct probe_result *pr)
+{
+	g_free(pr->conn);
+	g_free(pr->serialcomm);
+	g_free(pr);
+}
+
+static void probe_results_clear(void)
+{
+	g_slist_free_full(probe_results, (GDestroyNotify)probe_result_free);
+	probe_results = NULL;
+}
+
+static struct probe_result *probe_result_find(const char *conn,
+		const char *serialcomm)
+{
+	struct probe_result *pr, *found;
+	GSList *l, *next;
+	int64_t now;
+
+	now = g_get_monotonic_time();
+	found = NULL;
+	for (l = probe_results; l; l = next) {
+		next = l->next;
+		pr = l->data;
+		if (now - pr->time > PROBE_CACHE_MS * 1000) {
+			probe_results = g_slist_delete_link(probe_results, l);
+			probe_result_free(pr);
+		} else if (!strcmp(pr->conn, conn)
+				&& !strcmp(pr->serialcomm, serialcomm)) {
+			found = pr;
+		}
+	}
+
+	return found;
+}
+
+static void probe_result_add(const char *conn, const char *serialcomm,
+		const uint8_t *buf, size_t len)
+{
+	struct probe_result *pr;
+
+	if (!(pr = g_try_malloc(sizeof(struct probe_result))))
+		return;
+	pr->conn = g_strdup(conn);
+	pr->serialcomm = g_strdup(serialcomm);
+	pr->time = g_get_monotonic_time();
+	pr->len = MIN(len, PROBE_BUFSIZE);
+	memcpy(pr->buf, buf, pr->len);
+	probe_results = g_slist_prepend(probe_results, pr);
+}
+
+/* Look for a packet of the given model in data already read. */
+static int find_packet(const uint8_t *buf, size_t len, int dmm, size_t *end)
+{
+	size_t i;
+
+	for (i = 0; i + dmms[dmm].packet_size <= len; i++) {
+		if (dmms[dmm].packet_valid(&buf[i])) {
+			*end = i + dmms[dmm].packet_size;
+			return SR_OK;
+		}
+	}
+
+	return SR_ERR;
+}
+
+/*
+ * Read from the port until a packet of the given model shows up. Models
+ * which don't need their packets requested are all checked for in the
+ * same pass, and the data is kept for scanning them later.
+ */
+static int sdmm_probe(struct sr_serial_dev_inst *serial,
+		const char *serialcomm, int dmm, size_t *len)
+{
+	struct serial_packet_format formats[SERIAL_MAX_PACKET_FORMATS];
+	uint8_t buf[PROBE_BUFSIZE];
+	int num_formats, ret, i, j;
 
 	if (serial_open(serial, SERIAL_RDWR | SERIAL_NONBLOCK) != SR_OK)
-		return NULL;
+		return SR_ERR;
 
-	sr_info("Probing serial port %s.", conn);
+	sr_info("Probing serial port %s.", serial->port);
 
-	drvc = dmms[dmm].di->priv;
-	devices = NULL;
 	serial_flush(serial);
 
-	/* Request a packet if the DMM requires this. */
+	formats[0].packet_size = dmms[dmm].packet_size;
+	formats[0].is_valid = dmms[dmm].packet_valid;
+	num_formats = 1;
+
 	if (dmms[dmm].packet_request) {
+		/* Request a packet if the DMM requires this. */
 		if ((ret = dmms[dmm].packet_request(serial)) < 0) {
 			sr_err("Failed to request packet: %d.", ret);
-			return FALSE;
+			serial_close(serial);
+			return SR_ERR;
+		}
+	} else {
+		for (i = 0; i < (int)ARRAY_SIZE(dmms); i++) {
+			if (dmms[i].packet_request
+					|| strcmp(dmms[i].conn, serialcomm))
+				continue;
+			for (j = 0; j < num_formats; j++) {
+				if (formats[j].is_valid == dmms[i].packet_valid)
+					break;
+			}
+			if (j < num_formats
+					|| num_formats == SERIAL_MAX_PACKET_FORMATS)
+				continue;
+			formats[num_formats].packet_size = dmms[i].packet_size;
+			formats[num_formats].is_valid = dmms[i].packet_valid;
+			num_formats++;
 		}
 	}
 
@@ -355,12 +459,53 @@ static GSList *sdmm_scan(const char *conn, const char *serialcomm, int dmm)
 	 */
 
 	/* Let's get a bit of data and see if we can find a packet. */
-	len = sizeof(buf);
-	ret = serial_stream_detect(serial, buf, &len, dmms[dmm].packet_size,
-				   dmms[dmm].packet_valid, 3000,
-				   dmms[dmm].baudrate);
+	*len = sizeof(buf);
+	ret = serial_stream_detect_multi(serial, buf, len, formats,
+					 num_formats, 3000);
+
+	serial_close(serial);
+
+	/*
+	 * Only keep data in which some model was found, so a DMM switched
+	 * on after a failed scan is seen by the next one.
+	 */
+	if (!dmms[dmm].packet_request && ret >= 0)
+		probe_result_add(serial->port, serialcomm, buf, *len);
+
+	/*
+	 * Another model's packet is only reported after the whole buffer
+	 * was checked for ours, see serial_stream_detect_multi().
+	 */
+	return ret == 0 ? SR_OK : SR_ERR;
+}
+
+static GSList *sdmm_scan(const char *conn, const char *serialcomm, int dmm)
+{
+	struct sr_dev_inst *sdi;
+	struct drv_context *drvc;
+	struct dev_context *devc;
+	struct sr_probe *probe;
+	struct sr_serial_dev_inst *serial;
+	struct probe_result *pr;
+	GSList *devices;
+	int dropped, ret;
+	size_t len;
+
+	if (!(serial = sr_serial_dev_inst_new(conn, serialcomm)))
+		return NULL;
+
+	drvc = dmms[dmm].di->priv;
+	devices = NULL;
+
+	if (!dmms[dmm].packet_request
+			&& (pr = probe_result_find(conn, serialcomm))) {
+		sr_info("Checking data read from serial port %s.", conn);
+		ret = find_packet(pr->buf, pr->len, dmm, &len);
+	} else {
+		ret = sdmm_probe(serial, serialcomm, dmm, &len);
+	}
 	if (ret != SR_OK)
-		goto scan_cleanup;
+		return NULL;
 
 	/*
 	 * If we dropped more than two packets worth of data, something is
@@ -377,11 +522,11 @@ static GSList *sdmm_scan(const char *conn, const char *serialcomm, int dmm)
 
 	if (!(sdi = sr_dev_inst_new(0, SR_ST_INACTIVE, dmms[dmm].vendor,
 				    dmms[dmm].device, "")))
-		goto scan_cleanup;
+		return NULL;
 
 	if (!(devc = g_try_malloc0(sizeof(struct dev_context)))) {
 		sr_err("Device context malloc failed.");
-		goto scan_cleanup;
+		return NULL;
 	}
 
 	sdi->inst_type = SR_INST_SERIAL;
@@ -390,14 +535,11 @@ static GSList *sdmm_scan(const char *conn, const char *serialcomm, int dmm)
 	sdi->priv = devc;
 	sdi->driver = dmms[dmm].di;
 	if (!(probe = sr_probe_new(0, SR_PROBE_ANALOG, TRUE, "P1")))
-		goto scan_cleanup;
+		return NULL;
 	sdi->probes = g_slist_append(sdi->probes, probe);
 	drvc->instances = g_slist_append(drvc->instances, sdi);
 	devices = g_slist_append(devices, sdi);
 
-scan_cleanup:
-	serial_close(serial);
-
 	return devices;
 }
 
@@ -440,6 +582,8 @@ static GSList *dev_list(int dmm)
 
 static int cleanup(int dmm)
 {
+	probe_results_clear();
+
 	return dev_clear(dmm);
 }
 
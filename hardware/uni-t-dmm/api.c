@@ -57,21 +57,21 @@ SR_PRIV struct dmm_info udmms[] = {
 		FS9721_PACKET_SIZE,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
 		sr_fs9721_00_temp_c,
-		&tecpel_dmm_8061_driver_info, receive_data_TECPEL_DMM_8061,
+		&tecpel_dmm_8061_driver_info,
 	},
 	{
 		"UNI-T", "UT60A", 2400,
 		FS9721_PACKET_SIZE,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
 		NULL,
-		&uni_t_ut60a_driver_info, receive_data_UNI_T_UT60A,
+		&uni_t_ut60a_driver_info,
 	},
 	{
 		"UNI-T", "UT60E", 2400,
 		FS9721_PACKET_SIZE,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
 		sr_fs9721_00_temp_c,
-		&uni_t_ut60e_driver_info, receive_data_UNI_T_UT60E,
+		&uni_t_ut60e_driver_info,
 	},
 	{
 		/* The baudrate is actually 19230, see "Note 1" below. */
@@ -79,28 +79,28 @@ SR_PRIV struct dmm_info udmms[] = {
 		ES519XX_11B_PACKET_SIZE,
 		sr_es519xx_19200_11b_packet_valid, sr_es519xx_19200_11b_parse,
 		NULL,
-		&uni_t_ut60g_driver_info, receive_data_UNI_T_UT60G,
+		&uni_t_ut60g_driver_info,
 	},
 	{
 		"UNI-T", "UT61B", 2400,
 		FS9922_PACKET_SIZE,
 		sr_fs9922_packet_valid, sr_fs9922_parse,
 		NULL,
-		&uni_t_ut61b_driver_info, receive_data_UNI_T_UT61B,
+		&uni_t_ut61b_driver_info,
 	},
 	{
 		"UNI-T", "UT61C", 2400,
 		FS9922_PACKET_SIZE,
 		sr_fs9922_packet_valid, sr_fs9922_parse,
 		NULL,
-		&uni_t_ut61c_driver_info, receive_data_UNI_T_UT61C,
+		&uni_t_ut61c_driver_info,
 	},
 	{
 		"UNI-T", "UT61D", 2400,
 		FS9922_PACKET_SIZE,
 		sr_fs9922_packet_valid, sr_fs9922_parse,
 		NULL,
-		&uni_t_ut61d_driver_info, receive_data_UNI_T_UT61D,
+		&uni_t_ut61d_driver_info,
 	},
 	{
 		/* The baudrate is actually 19230, see "Note 1" below. */
@@ -108,14 +108,14 @@ SR_PRIV struct dmm_info udmms[] = {
 		ES519XX_14B_PACKET_SIZE,
 		sr_es519xx_19200_14b_packet_valid, sr_es519xx_19200_14b_parse,
 		NULL,
-		&uni_t_ut61e_driver_info, receive_data_UNI_T_UT61E,
+		&uni_t_ut61e_driver_info,
 	},
 	{
 		"Voltcraft", "VC-820", 2400,
 		FS9721_PACKET_SIZE,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
 		NULL,
-		&voltcraft_vc820_driver_info, receive_data_VOLTCRAFT_VC820,
+		&voltcraft_vc820_driver_info,
 	},
 	{
 		/*
@@ -127,21 +127,21 @@ SR_PRIV struct dmm_info udmms[] = {
 		FS9922_PACKET_SIZE,
 		sr_fs9922_packet_valid, sr_fs9922_parse,
 		&sr_fs9922_z1_diode,
-		&voltcraft_vc830_driver_info, receive_data_VOLTCRAFT_VC830,
+		&voltcraft_vc830_driver_info,
 	},
 	{
 		"Voltcraft", "VC-840", 2400,
 		FS9721_PACKET_SIZE,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
 		sr_fs9721_00_temp_c,
-		&voltcraft_vc840_driver_info, receive_data_VOLTCRAFT_VC840,
+		&voltcraft_vc840_driver_info,
 	},
 	{
 		"Tenma", "72-7745", 2400,
 		FS9721_PACKET_SIZE,
 		sr_fs9721_packet_valid, sr_fs9721_parse,
 		sr_fs9721_00_temp_c,
-		&tenma_72_7745_driver_info, receive_data_TENMA_72_7745,
+		&tenma_72_7745_driver_info,
 	},
 	{
 		/* The baudrate is actually 19230, see "Note 1" below. */
@@ -149,7 +149,7 @@ SR_PRIV struct dmm_info udmms[] = {
 		ES519XX_11B_PACKET_SIZE,
 		sr_es519xx_19200_11b_packet_valid, sr_es519xx_19200_11b_parse,
 		NULL,
-		&tenma_72_7750_driver_info, receive_data_TENMA_72_7750,
+		&tenma_72_7750_driver_info,
 	},
 };
 
@@ -213,6 +213,7 @@ static GSList *scan(GSList *options, int dmm)
 		}
 
 		devc->first_run = TRUE;
+		devc->dmm = dmm;
 
 		if (!(sdi = sr_dev_inst_new(0, SR_ST_INACTIVE,
 				udmms[dmm].vendor, udmms[dmm].device, NULL))) {
@@ -332,37 +333,33 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi,
 				    void *cb_data, int dmm)
 {
 	struct dev_context *devc;
+	int ret;
+
+	(void)dmm;
 
 	devc = sdi->priv;
 
 	devc->cb_data = cb_data;
+	devc->num_samples = 0;
 
 	devc->starttime = g_get_monotonic_time();
 
+	ret = uni_t_dmm_acquisition_start((struct sr_dev_inst *)sdi);
+	if (ret != SR_OK)
+		return ret;
+
 	/* Send header packet to the session bus. */
 	std_session_send_df_header(cb_data, LOG_PREFIX);
 
-	sr_source_add(0, 0, 10 /* poll_timeout */,
-		      udmms[dmm].receive_data, (void *)sdi);
-
 	return SR_OK;
 }
 
 static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
 {
-	struct sr_datafeed_packet packet;
-
-	(void)sdi;
-
-	sr_dbg("Stopping acquisition.");
-
-	/* Send end packet to the session bus. */
-	sr_dbg("Sending SR_DF_END.");
-	packet.type = SR_DF_END;
-	sr_session_send(cb_data, &packet);
+	(void)cb_data;
 
-	/* TODO? */
-	sr_source_remove(0);
+	/* SR_DF_END is sent once all transfers have come back. */
+	uni_t_dmm_acquisition_stop(sdi);
 
 	return SR_OK;
 }
@@ -53,20 +53,32 @@ extern struct dmm_info udmms[];
  *  f1 d1 00 00 00 00 00 00 (1 data byte, 0xd1)
  */
 
-static void decode_packet(struct sr_dev_inst *sdi, int dmm, const uint8_t *buf,
-			  void *info)
+/* Parser state for whichever DMM chip the subdriver uses. */
+union dmm_chip_info {
+	struct fs9721_info fs9721;
+	struct fs9922_info fs9922;
+	struct es519xx_info es519xx;
+};
+
+/* Devices currently acquiring, across all subdrivers. */
+static GSList *running_devs = NULL;
+
+static void decode_packet(struct sr_dev_inst *sdi, const uint8_t *buf)
 {
 	struct dev_context *devc;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_analog analog;
+	union dmm_chip_info info;
 	float floatval;
-	int ret;
+	int dmm, ret;
 
 	devc = sdi->priv;
+	dmm = devc->dmm;
 	memset(&analog, 0, sizeof(struct sr_datafeed_analog));
+	memset(&info, 0, sizeof(union dmm_chip_info));
 
 	/* Parse the protocol packet. */
-	ret = udmms[dmm].packet_parse(buf, &floatval, &analog, info);
+	ret = udmms[dmm].packet_parse(buf, &floatval, &analog, &info);
 	if (ret != SR_OK) {
 		sr_dbg("Invalid DMM packet, ignoring.");
 		return;
@@ -74,7 +86,7 @@ static void decode_packet(struct sr_dev_inst *sdi, int dmm, const uint8_t *buf,
 
 	/* If this DMM needs additional handling, call the resp. function. */
 	if (udmms[dmm].dmm_details)
-		udmms[dmm].dmm_details(&analog, info);
+		udmms[dmm].dmm_details(&analog, &info);
 
 	/* Send a sample packet with one analog value. */
 	analog.probes = sdi->probes;
@@ -171,56 +183,30 @@ static void log_dmm_packet(const uint8_t *buf)
 	       buf[7], buf[8], buf[9], buf[10], buf[11], buf[12], buf[13]);
 }
 
-static int get_and_handle_data(struct sr_dev_inst *sdi, int dmm, void *info)
+static void handle_chunk(struct sr_dev_inst *sdi, const uint8_t *buf)
 {
 	struct dev_context *devc;
-	uint8_t buf[CHUNK_SIZE], *pbuf;
-	int i, ret, len, num_databytes_in_chunk;
-	struct sr_usb_dev_inst *usb;
+	uint8_t *pbuf;
+	int i, dmm, offset, num_databytes_in_chunk;
 
 	devc = sdi->priv;
-	usb = sdi->conn;
+	dmm = devc->dmm;
 	pbuf = devc->protocol_buf;
 
-	/* On the first run, we need to init the HID chip. */
-	if (devc->first_run) {
-		if ((ret = hid_chip_init(sdi, udmms[dmm].baudrate)) != SR_OK) {
-			sr_err("HID chip init failed: %d.", ret);
-			return SR_ERR;
-		}
-		memset(pbuf, 0x00, DMM_BUFSIZE);
-		devc->first_run = FALSE;
-	}
-
-	memset(&buf, 0x00, CHUNK_SIZE);
-
-	/* Get data from EP2 using an interrupt transfer. */
-	ret = libusb_interrupt_transfer(
-		usb->devhdl, /* libusb device handle */
-		LIBUSB_ENDPOINT_IN | 2, /* EP2, IN */
-		(unsigned char *)&buf, /* receive buffer */
-		CHUNK_SIZE, /* wLength */
-		&len, /* actually received byte count */
-		1000 /* timeout (ms) */);
-
-	if (ret < 0) {
-		sr_err("USB receive error: %s.", libusb_error_name(ret));
-		return SR_ERR;
-	}
-
-	if (len != CHUNK_SIZE) {
-		sr_err("Short packet: received %d/%d bytes.", len, CHUNK_SIZE);
-		/* TODO: Print the bytes? */
-		return SR_ERR;
-	}
-
-	log_8byte_chunk((const uint8_t *)&buf);
+	log_8byte_chunk(buf);
 
 	/* If there are no data bytes just return (without error). */
-	if (buf[0] == 0xf0)
-		return SR_OK;
+	num_databytes_in_chunk = buf[0] & 0x0f;
+	if (num_databytes_in_chunk == 0)
+		return;
+	if (num_databytes_in_chunk > CHUNK_SIZE - 1) {
+		sr_dbg("Invalid chunk header 0x%02x, ignoring.", buf[0]);
+		return;
+	}
 
-	devc->bufoffset = 0;
+	/* No packet in a full buffer, it's garbage. */
+	if (devc->buflen + num_databytes_in_chunk > DMM_BUFSIZE)
+		devc->buflen = 0;
 
 	/*
 	 * Append the 1-7 data bytes of this chunk to pbuf.
@@ -234,82 +220,245 @@ static int get_and_handle_data(struct sr_dev_inst *sdi, int dmm, void *info)
 	 * be removed in order for the actual ES51922 protocol parser to
 	 * work properly.
 	 */
-	num_databytes_in_chunk = buf[0] & 0x0f;
-	for (i = 0; i < num_databytes_in_chunk; i++, devc->buflen++) {
-		pbuf[devc->buflen] = buf[1 + i];
-		if (udmms[dmm].packet_parse == sr_es519xx_19200_14b_parse)
-			pbuf[devc->buflen] &= ~(1 << 7);
+	memcpy(pbuf + devc->buflen, buf + 1, num_databytes_in_chunk);
+	if (udmms[dmm].packet_parse == sr_es519xx_19200_14b_parse) {
+		for (i = 0; i < num_databytes_in_chunk; i++)
+			pbuf[devc->buflen + i] &= ~(1 << 7);
 	}
+	devc->buflen += num_databytes_in_chunk;
 
 	/* Now look for packets in that data. */
-	while ((devc->buflen - devc->bufoffset) >= udmms[dmm].packet_size) {
-		if (udmms[dmm].packet_valid(pbuf + devc->bufoffset)) {
-			log_dmm_packet(pbuf + devc->bufoffset);
-			decode_packet(sdi, dmm, pbuf + devc->bufoffset, info);
-			devc->bufoffset += udmms[dmm].packet_size;
+	offset = 0;
+	while ((devc->buflen - offset) >= udmms[dmm].packet_size) {
+		if (udmms[dmm].packet_valid(pbuf + offset)) {
+			log_dmm_packet(pbuf + offset);
+			decode_packet(sdi, pbuf + offset);
+			offset += udmms[dmm].packet_size;
 		} else {
-			devc->bufoffset++;
+			offset++;
 		}
 	}
 
 	/* Move remaining bytes to beginning of buffer. */
-	for (i = 0; i < devc->buflen - devc->bufoffset; i++)
-		pbuf[i] = pbuf[devc->bufoffset + i];
-	devc->buflen -= devc->bufoffset;
+	if (offset > 0) {
+		memmove(pbuf, pbuf + offset, devc->buflen - offset);
+		devc->buflen -= offset;
+	}
+}
 
-	return SR_OK;
+/* Called once the last transfer of a stopping device has come back. */
+static void acquisition_done(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct drv_context *drvc;
+	struct sr_datafeed_packet packet;
+
+	devc = sdi->priv;
+	drvc = sdi->driver->priv;
+
+	sr_dbg("Sending SR_DF_END.");
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	sr_session_send(devc->cb_data, &packet);
+
+	running_devs = g_slist_remove(running_devs, sdi);
+	if (!running_devs)
+		usb_source_remove(drvc->sr_ctx);
 }
 
-static int receive_data(int fd, int revents, int dmm, void *info, void *cb_data)
+static void free_transfer(struct libusb_transfer *transfer)
 {
-	int ret;
 	struct sr_dev_inst *sdi;
 	struct dev_context *devc;
-	int64_t time_ms;
+	int i;
 
-	(void)fd;
-	(void)revents;
+	sdi = transfer->user_data;
+	devc = sdi->priv;
+
+	for (i = 0; i < NUM_TRANSFERS; i++) {
+		if (devc->transfers[i] == transfer)
+			devc->transfers[i] = NULL;
+	}
+	libusb_free_transfer(transfer);
+
+	if (--devc->num_transfers == 0)
+		acquisition_done(sdi);
+}
+
+static void receive_transfer(struct libusb_transfer *transfer)
+{
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	int ret;
 
-	sdi = cb_data;
+	sdi = transfer->user_data;
 	devc = sdi->priv;
 
-	if ((ret = get_and_handle_data(sdi, dmm, info)) != SR_OK)
-		return FALSE;
+	switch (transfer->status) {
+	case LIBUSB_TRANSFER_COMPLETED:
+		if (devc->stopping)
+			break;
+		if (transfer->actual_length != CHUNK_SIZE) {
+			sr_err("Short packet: received %d/%d bytes.",
+			       transfer->actual_length, CHUNK_SIZE);
+			break;
+		}
+		handle_chunk(sdi, transfer->buffer);
+		/* Abort acquisition if we acquired enough samples. */
+		if (devc->limit_samples &&
+		    devc->num_samples >= devc->limit_samples) {
+			sr_info("Requested number of samples reached.");
+			uni_t_dmm_acquisition_stop(sdi);
+		}
+		break;
+	case LIBUSB_TRANSFER_CANCELLED:
+		break;
+	case LIBUSB_TRANSFER_NO_DEVICE:
+		sr_err("Device disconnected.");
+		uni_t_dmm_acquisition_stop(sdi);
+		break;
+	default:
+		if (!devc->stopping) {
+			sr_err("USB receive error: transfer status %d.",
+			       transfer->status);
+			uni_t_dmm_acquisition_stop(sdi);
+		}
+		break;
+	}
 
-	/* Abort acquisition if we acquired enough samples. */
-	if (devc->limit_samples && devc->num_samples >= devc->limit_samples) {
-		sr_info("Requested number of samples reached.");
-		sdi->driver->dev_acquisition_stop(sdi, cb_data);
+	if (devc->stopping) {
+		free_transfer(transfer);
+		return;
 	}
 
-	if (devc->limit_msec) {
-		time_ms = (g_get_monotonic_time() - devc->starttime) / 1000;
+	if ((ret = libusb_submit_transfer(transfer)) != 0) {
+		sr_err("Unable to resubmit transfer: %s.",
+		       libusb_error_name(ret));
+		uni_t_dmm_acquisition_stop(sdi);
+		free_transfer(transfer);
+	}
+}
+
+/*
+ * The USB event source is shared by every device of every UNI-T
+ * subdriver, since there can only be one per libsigrok context.
+ */
+static int handle_events(int fd, int revents, void *cb_data)
+{
+	struct sr_context *sr_ctx;
+	struct sr_dev_inst *sdi;
+	struct dev_context *devc;
+	struct timeval tv;
+	GSList *l;
+	int64_t now, time_ms;
+
+	(void)fd;
+	(void)revents;
+
+	sr_ctx = cb_data;
+
+	now = g_get_monotonic_time();
+	for (l = running_devs; l; l = l->next) {
+		sdi = l->data;
+		devc = sdi->priv;
+		if (!devc->limit_msec || devc->stopping)
+			continue;
+		time_ms = (now - devc->starttime) / 1000;
 		if (time_ms > (int64_t)devc->limit_msec) {
 			sr_info("Requested time limit reached.");
-			sdi->driver->dev_acquisition_stop(sdi, cb_data);
-			return TRUE;
+			uni_t_dmm_acquisition_stop(sdi);
 		}
 	}
 
+	tv.tv_sec = tv.tv_usec = 0;
+	libusb_handle_events_timeout_completed(sr_ctx->libusb_ctx, &tv, NULL);
+
 	return TRUE;
 }
 
-#define RECEIVE_DATA(ID_UPPER, DMM_DRIVER) \
-SR_PRIV int receive_data_##ID_UPPER(int fd, int revents, void *cb_data) { \
-	struct DMM_DRIVER##_info info; \
-	return receive_data(fd, revents, ID_UPPER, &info, cb_data); }
-
-/* Driver-specific receive_data() wrappers */
-RECEIVE_DATA(TECPEL_DMM_8061, fs9721)
-RECEIVE_DATA(UNI_T_UT60A, fs9721)
-RECEIVE_DATA(UNI_T_UT60E, fs9721)
-RECEIVE_DATA(UNI_T_UT60G, es519xx)
-RECEIVE_DATA(UNI_T_UT61B, fs9922)
-RECEIVE_DATA(UNI_T_UT61C, fs9922)
-RECEIVE_DATA(UNI_T_UT61D, fs9922)
-RECEIVE_DATA(UNI_T_UT61E, es519xx)
-RECEIVE_DATA(VOLTCRAFT_VC820, fs9721)
-RECEIVE_DATA(VOLTCRAFT_VC830, fs9922)
-RECEIVE_DATA(VOLTCRAFT_VC840, fs9721)
-RECEIVE_DATA(TENMA_72_7745, es519xx)
-RECEIVE_DATA(TENMA_72_7750, es519xx)
+SR_PRIV int uni_t_dmm_acquisition_start(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	struct drv_context *drvc;
+	struct sr_usb_dev_inst *usb;
+	struct libusb_transfer *transfer;
+	int dmm, ret, i;
+
+	devc = sdi->priv;
+	drvc = sdi->driver->priv;
+	usb = sdi->conn;
+	dmm = devc->dmm;
+
+	/* On the first run, we need to init the HID chip. */
+	if (devc->first_run) {
+		if ((ret = hid_chip_init(sdi, udmms[dmm].baudrate)) != SR_OK) {
+			sr_err("HID chip init failed: %d.", ret);
+			return SR_ERR;
+		}
+		devc->first_run = FALSE;
+	}
+	devc->buflen = 0;
+	devc->stopping = FALSE;
+
+	if (!running_devs) {
+		if ((ret = usb_source_add(drvc->sr_ctx, 100,
+				handle_events, drvc->sr_ctx)) != SR_OK)
+			return ret;
+	}
+	running_devs = g_slist_append(running_devs, sdi);
+
+	/*
+	 * Keep several transfers queued on EP2, so no chunk is lost while
+	 * the previous one is being handled.
+	 */
+	for (i = 0; i < NUM_TRANSFERS; i++) {
+		if (!(transfer = libusb_alloc_transfer(0))) {
+			sr_err("USB transfer malloc failed.");
+			ret = SR_ERR_MALLOC;
+			break;
+		}
+		libusb_fill_interrupt_transfer(transfer, usb->devhdl,
+				LIBUSB_ENDPOINT_IN | 2, devc->transfer_buf[i],
+				CHUNK_SIZE, receive_transfer, sdi, 0);
+		if ((ret = libusb_submit_transfer(transfer)) != 0) {
+			sr_err("Unable to submit transfer: %s.",
+			       libusb_error_name(ret));
+			libusb_free_transfer(transfer);
+			ret = SR_ERR;
+			break;
+		}
+		devc->transfers[i] = transfer;
+		devc->num_transfers++;
+		ret = SR_OK;
+	}
+
+	if (ret != SR_OK) {
+		if (devc->num_transfers > 0) {
+			/* SR_DF_END is sent once they have come back. */
+			uni_t_dmm_acquisition_stop(sdi);
+			return SR_OK;
+		}
+		running_devs = g_slist_remove(running_devs, sdi);
+		if (!running_devs)
+			usb_source_remove(drvc->sr_ctx);
+	}
+
+	return ret;
+}
+
+SR_PRIV void uni_t_dmm_acquisition_stop(struct sr_dev_inst *sdi)
+{
+	struct dev_context *devc;
+	int i;
+
+	devc = sdi->priv;
+	if (devc->stopping)
+		return;
+
+	sr_dbg("Stopping acquisition.");
+	devc->stopping = TRUE;
+	for (i = 0; i < NUM_TRANSFERS; i++) {
+		if (devc->transfers[i])
+			libusb_cancel_transfer(devc->transfers[i]);
+	}
+}
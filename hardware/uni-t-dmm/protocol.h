@@ -55,13 +55,14 @@ struct dmm_info {
 			    struct sr_datafeed_analog *, void *);
 	void (*dmm_details)(struct sr_datafeed_analog *, void *);
 	struct sr_dev_driver *di;
-	int (*receive_data)(int, int, void *);
 };
 
 #define CHUNK_SIZE		8
 
 #define DMM_BUFSIZE		256
 
+#define NUM_TRANSFERS		4
+
 /** Private, per-device-instance driver context. */
 struct dev_context {
 	/** The current sampling limit (in number of samples). */
@@ -73,6 +74,9 @@ struct dev_context {
 	/** Opaque pointer passed in by the frontend. */
 	void *cb_data;
 
+	/** The subdriver (index into udmms[]) this device belongs to. */
+	int dmm;
+
 	/** The current number of already received samples. */
 	uint64_t num_samples;
 
@@ -81,22 +85,16 @@ struct dev_context {
 	gboolean first_run;
 
 	uint8_t protocol_buf[DMM_BUFSIZE];
-	uint8_t bufoffset;
-	uint8_t buflen;
+	int buflen;
+
+	/** Queued interrupt transfers, NULL once they have come back. */
+	struct libusb_transfer *transfers[NUM_TRANSFERS];
+	uint8_t transfer_buf[NUM_TRANSFERS][CHUNK_SIZE];
+	int num_transfers;
+	gboolean stopping;
 };
 
-SR_PRIV int receive_data_TECPEL_DMM_8061(int fd, int revents, void *cb_data);
-SR_PRIV int receive_data_UNI_T_UT60A(int fd, int revents, void *cb_data);
-SR_PRIV int receive_data_UNI_T_UT60E(int fd, int revents, void *cb_data);
-SR_PRIV int receive_data_UNI_T_UT60G(int fd, int revents, void *cb_data);
-SR_PRIV int receive_data_UNI_T_UT61B(int fd, int revents, void *cb_data);
-SR_PRIV int receive_data_UNI_T_UT61C(int fd, int revents, void *cb_data);
-SR_PRIV int receive_data_UNI_T_UT61D(int fd, int revents, void *cb_data);
-SR_PRIV int receive_data_UNI_T_UT61E(int fd, int revents, void *cb_data);
-SR_PRIV int receive_data_VOLTCRAFT_VC820(int fd, int revents, void *cb_data);
-SR_PRIV int receive_data_VOLTCRAFT_VC830(int fd, int revents, void *cb_data);
-SR_PRIV int receive_data_VOLTCRAFT_VC840(int fd, int revents, void *cb_data);
-SR_PRIV int receive_data_TENMA_72_7745(int fd, int revents, void *cb_data);
-SR_PRIV int receive_data_TENMA_72_7750(int fd, int revents, void *cb_data);
+SR_PRIV int uni_t_dmm_acquisition_start(struct sr_dev_inst *sdi);
+SR_PRIV void uni_t_dmm_acquisition_stop(struct sr_dev_inst *sdi);
 
 #endif
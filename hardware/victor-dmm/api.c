@@ -72,7 +72,7 @@ static GSList *scan(GSList *options)
 	drvc = di->priv;
 
 	devices = NULL;
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
+	sr_usb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist);
 	for (i = 0; devlist[i]; i++) {
 		if ((ret = libusb_get_device_descriptor(devlist[i], &des)) != 0) {
 			sr_warn("Failed to get device descriptor: %s",
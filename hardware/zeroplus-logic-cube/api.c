@@ -269,7 +269,7 @@ static GSList *scan(GSList *options)
 
 	/* Find all ZEROPLUS analyzers and add them to device list. */
 	devcnt = 0;
-	libusb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist); /* TODO: Errors. */
+	sr_usb_get_device_list(drvc->sr_ctx->libusb_ctx, &devlist); /* TODO: Errors. */
 
 	for (i = 0; devlist[i]; i++) {
 		ret = libusb_get_device_descriptor(devlist[i], &des);
@@ -100,6 +100,10 @@ static struct sr_config_info sr_config_info_data[] = {
 		"Number of logic probes", NULL},
 	{SR_CONF_NUM_ANALOG_PROBES, SR_T_INT32, "analog_probes",
 		"Number of analog probes", NULL},
+	{SR_CONF_MAX_THROUGHPUT, SR_T_BOOL, "max_throughput",
+		"Maximum throughput mode", NULL},
+	{SR_CONF_ACQ_STATS, SR_T_KEYVALUE, "acq_stats",
+		"Acquisition counters", NULL},
 	{0, 0, NULL, NULL, NULL},
 };
 
@@ -431,6 +435,9 @@ SR_API int sr_driver_init(struct sr_context *ctx, struct sr_dev_driver *driver)
 		return SR_ERR_ARG;
 	}
 
+	/* A reinitialized driver has forgotten its devices. */
+	sr_scan_cache_clear(ctx);
+
 	sr_spew("Initializing driver '%s'.", driver->name);
 	if ((ret = driver->init(ctx)) < 0)
 		sr_err("Failed to initialize the driver: %d.", ret);
@@ -438,6 +445,28 @@ SR_API int sr_driver_init(struct sr_context *ctx, struct sr_dev_driver *driver)
 	return ret;
 }
 
+/** The scan of one driver, by sr_driver_scan_all(). */
+struct scan_job {
+	struct sr_dev_driver *driver;
+	GSList *options;
+	GSList *devices;
+	/** Next job scanned by the same thread, if any. */
+	struct scan_job *next;
+	GThread *thread;
+};
+
+static GSList *driver_scan(struct sr_dev_driver *driver, GSList *options)
+{
+	GSList *l;
+
+	l = driver->scan(options);
+
+	sr_spew("Scan of '%s' found %d devices.", driver->name,
+		g_slist_length(l));
+
+	return l;
+}
+
 /**
  * Tell a hardware driver to scan for devices.
  *
@@ -463,7 +492,7 @@ SR_API int sr_driver_init(struct sr_context *ctx, struct sr_dev_driver *driver)
  */
 SR_API GSList *sr_driver_scan(struct sr_dev_driver *driver, GSList *options)
 {
-	GSList *l;
+	struct drv_context *drvc;
 
 	if (!driver) {
 		sr_err("Invalid driver, can't scan for devices.");
@@ -475,12 +504,234 @@ SR_API GSList *sr_driver_scan(struct sr_dev_driver *driver, GSList *options)
 		return NULL;
 	}
 
-	l = driver->scan(options);
+	/* The driver's device list changes, so forget sr_driver_scan_all(). */
+	drvc = driver->priv;
+	sr_scan_cache_clear(drvc->sr_ctx);
 
-	sr_spew("Scan of '%s' found %d devices.", driver->name,
-		g_slist_length(l));
+	return driver_scan(driver, options);
+}
 
-	return l;
+static gpointer scan_thread(gpointer data)
+{
+	struct scan_job *job;
+
+	for (job = data; job; job = job->next)
+		job->devices = driver_scan(job->driver, job->options);
+
+	return NULL;
+}
+
+/* Run a chain of scan jobs in a thread, or right here if there is none. */
+static void scan_thread_start(struct scan_job *job)
+{
+	job->thread = g_thread_try_new("scan", scan_thread, job, NULL);
+	if (!job->thread)
+		scan_thread(job);
+}
+
+/*
+ * The cache key: the drivers scanned, the scan options, and every
+ * device on the USB bus(es). A replugged device gets a new address.
+ */
+static char *scan_cache_key(struct sr_context *ctx, GSList *drivers,
+		GSList *options)
+{
+	struct sr_dev_driver *driver;
+	struct sr_config *src;
+	GString *key;
+	GSList *l;
+	char *s;
+#ifdef HAVE_LIBUSB_1_0
+	struct libusb_device **devlist;
+	struct libusb_device_descriptor des;
+	int i;
+#endif
+
+	key = g_string_sized_new(256);
+	for (l = drivers; l; l = l->next) {
+		driver = l->data;
+		g_string_append_printf(key, "%s,", driver->name);
+	}
+	for (l = options; l; l = l->next) {
+		src = l->data;
+		s = g_variant_print(src->data, TRUE);
+		g_string_append_printf(key, ";%d=%s", src->key, s);
+		g_free(s);
+	}
+#ifdef HAVE_LIBUSB_1_0
+	if (sr_usb_get_device_list(ctx->libusb_ctx, &devlist) >= 0) {
+		for (i = 0; devlist[i]; i++) {
+			if (libusb_get_device_descriptor(devlist[i], &des) != 0)
+				continue;
+			g_string_append_printf(key, ";%d.%d:%04x.%04x",
+					libusb_get_bus_number(devlist[i]),
+					libusb_get_device_address(devlist[i]),
+					des.idVendor, des.idProduct);
+		}
+		libusb_free_device_list(devlist, 1);
+	}
+#else
+	(void)ctx;
+#endif
+
+	return g_string_free(key, FALSE);
+}
+
+/*
+ * Cached devices may have been freed by a driver since. Only compare the
+ * pointers against the instances of the drivers, never dereference them.
+ */
+static gboolean scan_cache_valid(GSList *devices)
+{
+	struct sr_dev_driver **drivers;
+	struct drv_context *drvc;
+	GSList *l;
+	int i;
+
+	for (l = devices; l; l = l->next) {
+		drivers = sr_driver_list();
+		for (i = 0; drivers[i]; i++) {
+			drvc = drivers[i]->priv;
+			if (drvc && g_slist_find(drvc->instances, l->data))
+				break;
+		}
+		if (!drivers[i])
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+/**
+ * Scan for devices with all initialized drivers at once.
+ *
+ * Drivers which set scan_threadsafe scan in a thread of their own. Most
+ * drivers keep state shared with others or with their previous scans
+ * (e.g. probe caches), so all other drivers scan one after another, in
+ * one more thread. The USB bus is only enumerated once for all of them.
+ * If options contains SR_CONF_CONN, all drivers scan one after another,
+ * since they would all probe the same port.
+ *
+ * With use_cache, a scan with the same drivers and options returns the
+ * previous result right away, as long as the devices on the USB bus
+ * are unchanged, and none of the devices found were cleared. Devices
+ * on serial ports or the network are not detected as changed.
+ *
+ * This must not be called while other scans are in progress.
+ *
+ * @param ctx A libsigrok context object allocated by a previous call to
+ *            sr_init(). Must not be NULL.
+ * @param options A list of 'struct sr_config' options to pass to the
+ *                scanners. Can be NULL/empty.
+ * @param use_cache TRUE to return the previous result if nothing changed.
+ *
+ * @return A GSList * of 'struct sr_dev_inst', in the order of
+ *         sr_driver_list(), or NULL if no devices were found. This list
+ *         must be freed by the caller using g_slist_free(), but without
+ *         freeing the data pointed to in the list.
+ *
+ * @since 0.3.0
+ */
+SR_API GSList *sr_driver_scan_all(struct sr_context *ctx, GSList *options,
+		gboolean use_cache)
+{
+	struct sr_dev_driver **drivers, *driver;
+	struct scan_job *jobs, *serial, **tail;
+	struct sr_config *src;
+	GSList *drvlist, *devices, *l;
+	gboolean conn;
+	char *key;
+	int num_jobs, i;
+
+	if (!ctx) {
+		sr_err("Invalid libsigrok context, can't scan for devices.");
+		return NULL;
+	}
+
+	drvlist = NULL;
+	drivers = sr_driver_list();
+	for (i = 0; drivers[i]; i++) {
+		if (drivers[i]->priv)
+			drvlist = g_slist_append(drvlist, drivers[i]);
+	}
+	if (!drvlist)
+		return NULL;
+
+	conn = FALSE;
+	for (l = options; l; l = l->next) {
+		src = l->data;
+		if (src->key == SR_CONF_CONN)
+			conn = TRUE;
+	}
+
+#ifdef HAVE_LIBUSB_1_0
+	usb_devlist_snapshot_take(ctx->libusb_ctx);
+#endif
+
+	key = scan_cache_key(ctx, drvlist, options);
+	if (use_cache && ctx->scan_cache_key
+			&& !strcmp(key, ctx->scan_cache_key)
+			&& scan_cache_valid(ctx->scan_cache)) {
+		sr_dbg("Nothing changed, returning cached scan result.");
+		devices = g_slist_copy(ctx->scan_cache);
+		g_free(key);
+		goto done;
+	}
+
+	num_jobs = g_slist_length(drvlist);
+	if (!(jobs = g_try_malloc0(num_jobs * sizeof(struct scan_job)))) {
+		sr_err("Scan job malloc failed.");
+		devices = NULL;
+		g_free(key);
+		goto done;
+	}
+	serial = NULL;
+	tail = &serial;
+	for (i = 0, l = drvlist; l; i++, l = l->next) {
+		driver = l->data;
+		jobs[i].driver = driver;
+		jobs[i].options = options;
+		if (!conn && driver->scan_threadsafe) {
+			scan_thread_start(&jobs[i]);
+		} else {
+			*tail = &jobs[i];
+			tail = &jobs[i].next;
+		}
+	}
+	if (serial)
+		scan_thread_start(serial);
+
+	devices = NULL;
+	for (i = 0; i < num_jobs; i++) {
+		if (jobs[i].thread)
+			g_thread_join(jobs[i].thread);
+		devices = g_slist_concat(devices, jobs[i].devices);
+	}
+	g_free(jobs);
+
+	sr_scan_cache_clear(ctx);
+	ctx->scan_cache_key = key;
+	ctx->scan_cache = g_slist_copy(devices);
+
+done:
+#ifdef HAVE_LIBUSB_1_0
+	usb_devlist_snapshot_release();
+#endif
+	g_slist_free(drvlist);
+
+	return devices;
+}
+
+/** @private */
+SR_PRIV void sr_scan_cache_clear(struct sr_context *ctx)
+{
+	if (!ctx)
+		return;
+
+	g_free(ctx->scan_cache_key);
+	ctx->scan_cache_key = NULL;
+	g_slist_free(ctx->scan_cache);
+	ctx->scan_cache = NULL;
 }
 
 /** @private */
@@ -524,6 +775,149 @@ SR_PRIV void sr_config_free(struct sr_config *src)
 
 }
 
+/** A cached result of a config_get() or config_list() driver call. */
+struct config_cache_entry {
+	int key;
+	const struct sr_probe_group *probe_group;
+	/** TRUE for config_list(), FALSE for config_get(). */
+	gboolean list;
+	GVariant *data;
+};
+
+struct sr_config_cache {
+	/** struct config_cache_entry */
+	GSList *entries;
+};
+
+static void config_cache_entry_free(struct config_cache_entry *entry)
+{
+	g_variant_unref(entry->data);
+	g_free(entry);
+}
+
+/**
+ * Cache the configuration of a device instance.
+ *
+ * Results of sr_config_get() and sr_config_list() are then kept until
+ * they are invalidated, and frontends polling them no longer cause any
+ * driver calls. Every sr_config_set() invalidates its key, and
+ * starting an acquisition the whole cache. Any other changes, such as a
+ * key changing the value of another one, must be reported by the driver
+ * with sr_config_cache_invalidate() or sr_config_cache_clear().
+ *
+ * Drivers opt in by calling this, usually when the device is opened.
+ *
+ * @param sdi The device instance.
+ *
+ * @return SR_OK upon success, SR_ERR_MALLOC upon memory allocation errors.
+ *
+ * @private
+ */
+SR_PRIV int sr_config_cache_enable(struct sr_dev_inst *sdi)
+{
+	if (sdi->config_cache) {
+		sr_config_cache_clear(sdi);
+		return SR_OK;
+	}
+
+	if (!(sdi->config_cache = g_try_malloc0(sizeof(struct sr_config_cache)))) {
+		sr_err("%s: config cache malloc failed", __func__);
+		return SR_ERR_MALLOC;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Drop all cached values of a key, for all probe groups.
+ *
+ * @private
+ */
+SR_PRIV void sr_config_cache_invalidate(const struct sr_dev_inst *sdi,
+		int key)
+{
+	struct sr_config_cache *cache;
+	struct config_cache_entry *entry;
+	GSList *l, *next;
+
+	if (!sdi || !(cache = sdi->config_cache))
+		return;
+
+	for (l = cache->entries; l; l = next) {
+		next = l->next;
+		entry = l->data;
+		if (entry->key != key)
+			continue;
+		cache->entries = g_slist_delete_link(cache->entries, l);
+		config_cache_entry_free(entry);
+	}
+}
+
+/**
+ * Drop all cached values of a device instance.
+ *
+ * @private
+ */
+SR_PRIV void sr_config_cache_clear(const struct sr_dev_inst *sdi)
+{
+	struct sr_config_cache *cache;
+
+	if (!sdi || !(cache = sdi->config_cache))
+		return;
+
+	g_slist_free_full(cache->entries,
+			  (GDestroyNotify)config_cache_entry_free);
+	cache->entries = NULL;
+}
+
+/** @private */
+SR_PRIV void sr_config_cache_free(struct sr_dev_inst *sdi)
+{
+	sr_config_cache_clear(sdi);
+	g_free(sdi->config_cache);
+	sdi->config_cache = NULL;
+}
+
+static GVariant *config_cache_lookup(const struct sr_dev_inst *sdi,
+		const struct sr_probe_group *probe_group, int key,
+		gboolean list)
+{
+	struct config_cache_entry *entry;
+	GSList *l;
+
+	if (!sdi || !sdi->config_cache)
+		return NULL;
+
+	for (l = sdi->config_cache->entries; l; l = l->next) {
+		entry = l->data;
+		if (entry->key == key && entry->probe_group == probe_group
+		    && entry->list == list)
+			return entry->data;
+	}
+
+	return NULL;
+}
+
+static void config_cache_store(const struct sr_dev_inst *sdi,
+		const struct sr_probe_group *probe_group, int key,
+		gboolean list, GVariant *data)
+{
+	struct sr_config_cache *cache;
+	struct config_cache_entry *entry;
+
+	if (!sdi || !(cache = sdi->config_cache))
+		return;
+
+	/* Not being able to cache a value is no error. */
+	if (!(entry = g_try_malloc(sizeof(struct config_cache_entry))))
+		return;
+	entry->key = key;
+	entry->probe_group = probe_group;
+	entry->list = list;
+	entry->data = g_variant_ref(data);
+	cache->entries = g_slist_prepend(cache->entries, entry);
+}
+
 /**
  * Returns information about the given driver or device instance.
  *
@@ -550,6 +944,7 @@ SR_API int sr_config_get(const struct sr_dev_driver *driver,
 		const struct sr_probe_group *probe_group,
 		int key, GVariant **data)
 {
+	GVariant *cached;
 	int ret;
 
 	if (!driver || !data)
@@ -558,10 +953,16 @@ SR_API int sr_config_get(const struct sr_dev_driver *driver,
 	if (!driver->config_get)
 		return SR_ERR_ARG;
 
+	if ((cached = config_cache_lookup(sdi, probe_group, key, FALSE))) {
+		*data = g_variant_ref(cached);
+		return SR_OK;
+	}
+
 	if ((ret = driver->config_get(key, data, sdi, probe_group)) == SR_OK) {
 		/* Got a floating reference from the driver. Sink it here,
 		 * caller will need to unref when done with it. */
 		g_variant_ref_sink(*data);
+		config_cache_store(sdi, probe_group, key, FALSE, *data);
 	}
 
 	return ret;
@@ -595,8 +996,11 @@ SR_API int sr_config_set(const struct sr_dev_inst *sdi,
 		ret = SR_ERR;
 	else if (!sdi->driver->config_set)
 		ret = SR_ERR_ARG;
-	else
+	else {
 		ret = sdi->driver->config_set(key, data, sdi, probe_group);
+		/* Even a failed attempt may have changed the setting. */
+		sr_config_cache_invalidate(sdi, key);
+	}
 
 	g_variant_unref(data);
 
@@ -628,14 +1032,20 @@ SR_API int sr_config_list(const struct sr_dev_driver *driver,
 		const struct sr_probe_group *probe_group,
 		int key, GVariant **data)
 {
+	GVariant *cached;
 	int ret;
 
 	if (!driver || !data)
 		ret = SR_ERR;
 	else if (!driver->config_list)
 		ret = SR_ERR_ARG;
-	else if ((ret = driver->config_list(key, data, sdi, probe_group)) == SR_OK)
+	else if ((cached = config_cache_lookup(sdi, probe_group, key, TRUE))) {
+		*data = g_variant_ref(cached);
+		ret = SR_OK;
+	} else if ((ret = driver->config_list(key, data, sdi, probe_group)) == SR_OK) {
 		g_variant_ref_sink(*data);
+		config_cache_store(sdi, probe_group, key, TRUE, *data);
+	}
 
 	return ret;
 }
@@ -94,10 +94,16 @@
 #endif
 
 struct sr_context {
+	/* Result of the last sr_driver_scan_all(), and what it depends on. */
+	char *scan_cache_key;
+	GSList *scan_cache;
 #ifdef HAVE_LIBUSB_1_0
 	libusb_context *libusb_ctx;
 	gboolean usb_source_present;
-#ifdef _WIN32
+	gboolean usb_event_thread;
+#ifndef _WIN32
+	struct sr_usb_event_thread *usb_evt;
+#else
 	GThread *usb_thread;
 	gboolean usb_thread_running;
 	GMutex usb_mutex;
@@ -118,6 +124,12 @@ struct sr_usb_dev_inst {
 	uint8_t address;
 	/** libusb device handle */
 	struct libusb_device_handle *devhdl;
+	/**
+	 * Port numbers from the root hub, if known (port_path_len > 0).
+	 * Unlike the address, they stay the same across a renumeration.
+	 */
+	uint8_t port_path[7];
+	int port_path_len;
 };
 #endif
 
@@ -155,6 +167,15 @@ struct drv_context {
 
 /*--- log.c -----------------------------------------------------------------*/
 
+extern SR_PRIV int sr_loglevel;
+extern SR_PRIV struct sr_trace_entry *sr_trace_buf;
+
+/* Record a trace event, at the cost of a single check while disabled. */
+#define sr_trace(event, arg1, arg2) do { \
+	if (G_UNLIKELY(sr_trace_buf != NULL)) \
+		sr_trace_add(event, arg1, arg2); \
+} while (0)
+
 SR_PRIV int sr_log(int loglevel, const char *format, ...);
 SR_PRIV int sr_spew(const char *format, ...);
 SR_PRIV int sr_dbg(const char *format, ...);
@@ -162,14 +183,27 @@ SR_PRIV int sr_info(const char *format, ...);
 SR_PRIV int sr_warn(const char *format, ...);
 SR_PRIV int sr_err(const char *format, ...);
 
-/* Message logging helpers with subsystem-specific prefix string. */
+/*
+ * Message logging helpers with subsystem-specific prefix string.
+ * The arguments are only evaluated if the message's loglevel is enabled.
+ * The loglevel of sr_log() itself is evaluated exactly once.
+ */
 #ifndef NO_LOG_WRAPPERS
-#define sr_log(l, s, args...) sr_log(l, "%s: " s, LOG_PREFIX, ## args)
-#define sr_spew(s, args...) sr_spew("%s: " s, LOG_PREFIX, ## args)
-#define sr_dbg(s, args...) sr_dbg("%s: " s, LOG_PREFIX, ## args)
-#define sr_info(s, args...) sr_info("%s: " s, LOG_PREFIX, ## args)
-#define sr_warn(s, args...) sr_warn("%s: " s, LOG_PREFIX, ## args)
-#define sr_err(s, args...) sr_err("%s: " s, LOG_PREFIX, ## args)
+#define sr_log(l, s, args...) ({ \
+	int sr_log_level_ = (l); \
+	sr_log_level_ <= sr_loglevel ? \
+		sr_log(sr_log_level_, "%s: " s, LOG_PREFIX, ## args) : SR_OK; \
+})
+#define sr_spew(s, args...) (SR_LOG_SPEW <= sr_loglevel ? \
+	sr_spew("%s: " s, LOG_PREFIX, ## args) : SR_OK)
+#define sr_dbg(s, args...) (SR_LOG_DBG <= sr_loglevel ? \
+	sr_dbg("%s: " s, LOG_PREFIX, ## args) : SR_OK)
+#define sr_info(s, args...) (SR_LOG_INFO <= sr_loglevel ? \
+	sr_info("%s: " s, LOG_PREFIX, ## args) : SR_OK)
+#define sr_warn(s, args...) (SR_LOG_WARN <= sr_loglevel ? \
+	sr_warn("%s: " s, LOG_PREFIX, ## args) : SR_OK)
+#define sr_err(s, args...) (SR_LOG_ERR <= sr_loglevel ? \
+	sr_err("%s: " s, LOG_PREFIX, ## args) : SR_OK)
 #endif
 
 /*--- device.c --------------------------------------------------------------*/
@@ -204,11 +238,17 @@ SR_PRIV void sr_usbtmc_dev_inst_free(struct sr_usbtmc_dev_inst *usbtmc);
 /*--- hwdriver.c ------------------------------------------------------------*/
 
 SR_PRIV void sr_hw_cleanup_all(void);
+SR_PRIV void sr_scan_cache_clear(struct sr_context *ctx);
 SR_PRIV struct sr_config *sr_config_new(int key, GVariant *data);
 SR_PRIV void sr_config_free(struct sr_config *src);
 SR_PRIV int sr_source_remove(int fd);
 SR_PRIV int sr_source_add(int fd, int events, int timeout,
 		sr_receive_data_callback_t cb, void *cb_data);
+SR_PRIV int sr_config_cache_enable(struct sr_dev_inst *sdi);
+SR_PRIV void sr_config_cache_invalidate(const struct sr_dev_inst *sdi,
+		int key);
+SR_PRIV void sr_config_cache_clear(const struct sr_dev_inst *sdi);
+SR_PRIV void sr_config_cache_free(struct sr_dev_inst *sdi);
 
 /*--- session.c -------------------------------------------------------------*/
 
@@ -221,16 +261,38 @@ struct sr_session {
 	gboolean running;
 
 	unsigned int num_sources;
+	/** Allocated size of the sources, pollfds, timeouts and ready arrays. */
+	unsigned int sources_size;
 
 	/*
 	 * Both "sources" and "pollfds" are of the same size and contain pairs
 	 * of descriptor and callback function. We can not embed the GPollFD
 	 * into the source struct since we want to be able to pass the array
-	 * of all poll descriptors to g_poll().
+	 * of all poll descriptors to g_poll(). Removing a source moves the
+	 * last pair into its slot, so the order is not preserved.
 	 */
-	struct source *sources;
+	struct source **sources;
 	GPollFD *pollfds;
-	int source_timeout;
+	/** Sources by poll object, for removing them without a search. */
+	GHashTable *poll_objects;
+	/** Binary min-heap of the sources with a timeout, by due time. */
+	struct source **timeouts;
+	unsigned int num_timeouts;
+	/** Sources to be dispatched in the current iteration. */
+	struct source **ready;
+	unsigned int num_ready;
+	/** Sources removed while dispatching, freed afterwards. */
+	GSList *dead_sources;
+	gboolean dispatching;
+	/** epoll instance, or -1 when g_poll() is used. */
+	int epoll_fd;
+
+	/** Counters summed over all devices. */
+	struct sr_acq_stats stats;
+	/** Interval for sending counters in SR_DF_META packets, in us. */
+	int64_t stats_interval;
+	/** When each device's counters are due next. */
+	GHashTable *stats_due;
 
 	/*
 	 * These are our synchronization primitives for stopping the session in
@@ -246,8 +308,26 @@ struct sr_session {
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		const struct sr_datafeed_packet *packet);
 SR_PRIV int sr_session_stop_sync(void);
+SR_PRIV void sr_session_stats_queue_depth(unsigned int depth);
 SR_PRIV int sr_sessionfile_check(const char *filename);
 
+/*--- session_file.c --------------------------------------------------------*/
+
+/** Size of the header at the start of every analog capture file chunk. */
+#define SR_SESSION_ANALOG_HEADER_SIZE 16
+
+SR_PRIV int sr_session_analog_size(int format);
+SR_PRIV void sr_session_analog_decode(int format, float scale, float offset,
+		const uint8_t *in, float *out, int num_samples);
+
+/*--- session_driver.c ------------------------------------------------------*/
+
+SR_PRIV int sr_session_vdev_analog_add(const struct sr_dev_inst *sdi,
+		struct sr_probe *probe, int num, int format, float scale,
+		float offset);
+SR_PRIV int sr_session_vdev_start_time_set(const struct sr_dev_inst *sdi,
+		int64_t start_time);
+
 /*--- std.c -----------------------------------------------------------------*/
 
 typedef int (*dev_close_t)(struct sr_dev_inst *sdi);
@@ -274,6 +354,34 @@ SR_PRIV int sr_atoi(const char *str, int *ret);
 SR_PRIV int sr_atod(const char *str, double *ret);
 SR_PRIV int sr_atof(const char *str, float *ret);
 
+/*--- output/output.c ------------------------------------------------------*/
+
+SR_PRIV int sr_output_receive_compat(struct sr_output *o,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, GString **out);
+
+/** State of output modules which only write samples that changed. */
+struct sr_output_changes {
+	/** The last sample seen. */
+	uint8_t *prevsample;
+	unsigned int unitsize;
+	/** Number of samples seen so far. */
+	uint64_t num_samples;
+	/** Index of the last sample written. */
+	uint64_t last_written;
+};
+
+SR_PRIV char *sr_output_put_decimal(char *p, uint64_t value);
+SR_PRIV int sr_output_changes_begin(struct sr_output_changes *ch,
+		unsigned int unitsize, const uint8_t **prev);
+SR_PRIV gboolean sr_output_changes_check(struct sr_output_changes *ch,
+		const uint8_t **prev, const uint8_t *sample, uint64_t offset);
+SR_PRIV void sr_output_changes_end(struct sr_output_changes *ch,
+		const uint8_t *prev, uint64_t num_samples);
+SR_PRIV const uint8_t *sr_output_changes_last(struct sr_output_changes *ch,
+		uint64_t *index);
+SR_PRIV void sr_output_changes_free(struct sr_output_changes *ch);
+
 /*--- hardware/common/serial.c ----------------------------------------------*/
 
 #ifdef HAVE_LIBSERIALPORT
@@ -285,6 +393,16 @@ enum {
 
 typedef gboolean (*packet_valid_t)(const uint8_t *buf);
 
+/** Maximum number of formats serial_stream_detect_multi() can probe. */
+#define SERIAL_MAX_PACKET_FORMATS 32
+
+struct serial_packet_format {
+	/** Size of a packet in bytes. */
+	size_t packet_size;
+	/** Callback checking whether a packet is valid. */
+	packet_valid_t is_valid;
+};
+
 SR_PRIV int serial_open(struct sr_serial_dev_inst *serial, int flags);
 SR_PRIV int serial_close(struct sr_serial_dev_inst *serial);
 SR_PRIV int serial_flush(struct sr_serial_dev_inst *serial);
@@ -310,6 +428,10 @@ SR_PRIV int serial_stream_detect(struct sr_serial_dev_inst *serial,
 				 uint8_t *buf, size_t *buflen,
 				 size_t packet_size, packet_valid_t is_valid,
 				 uint64_t timeout_ms, int baudrate);
+SR_PRIV int serial_stream_detect_multi(struct sr_serial_dev_inst *serial,
+		uint8_t *buf, size_t *buflen,
+		const struct serial_packet_format *formats, int num_formats,
+		uint64_t timeout_ms);
 SR_PRIV int sr_serial_extract_options(GSList *options, const char **serial_device,
 				      const char **serial_options);
 SR_PRIV int serial_source_add(struct sr_serial_dev_inst *serial, int events,
@@ -325,6 +447,25 @@ SR_PRIV int ezusb_install_firmware(libusb_device_handle *hdl,
 				   const char *filename);
 SR_PRIV int ezusb_upload_firmware(libusb_device *dev, int configuration,
 				  const char *filename);
+
+/** A firmware upload, run concurrently by ezusb_upload_firmware_all(). */
+struct ezusb_fw_upload {
+	libusb_device *dev;
+	int configuration;
+	const char *filename;
+	/** For the caller, e.g. the device instance being set up. */
+	void *user_data;
+	/** Result of the upload. */
+	int ret;
+	/** Monotonic time when the upload finished. */
+	int64_t done;
+	GThread *thread;
+};
+
+SR_PRIV struct ezusb_fw_upload *ezusb_fw_upload_new(libusb_device *dev,
+		int configuration, const char *filename, void *user_data);
+SR_PRIV void ezusb_fw_upload_free(struct ezusb_fw_upload *upload);
+SR_PRIV void ezusb_upload_firmware_all(GSList *uploads);
 #endif
 
 /*--- hardware/common/usb.c -------------------------------------------------*/
@@ -332,11 +473,54 @@ SR_PRIV int ezusb_upload_firmware(libusb_device *dev, int configuration,
 #ifdef HAVE_LIBUSB_1_0
 SR_PRIV GSList *sr_usb_find(libusb_context *usb_ctx, const char *conn);
 SR_PRIV int sr_usb_open(libusb_context *usb_ctx, struct sr_usb_dev_inst *usb);
+SR_PRIV ssize_t usb_devlist_snapshot_take(libusb_context *usb_ctx);
+SR_PRIV void usb_devlist_snapshot_release(void);
+SR_PRIV ssize_t sr_usb_get_device_list(libusb_context *usb_ctx,
+		libusb_device ***list);
+SR_PRIV void usb_dev_inst_set_port_path(struct sr_usb_dev_inst *usb,
+		libusb_device *dev);
+SR_PRIV int usb_wait_for_renumeration(struct sr_context *ctx,
+		struct sr_dev_inst *sdi, int vid, int pid, int64_t fw_updated,
+		int timeout_ms, int (*open_cb)(struct sr_dev_inst *sdi));
 SR_PRIV int usb_source_add(struct sr_context *ctx, int timeout,
 		sr_receive_data_callback_t cb, void *cb_data);
 SR_PRIV int usb_source_remove(struct sr_context *ctx);
+typedef void (*sr_usb_buffer_callback_t)(uint8_t *buf, int len,
+		void *user_data);
+SR_PRIV int usb_source_add_threaded(struct sr_context *ctx, int timeout,
+		sr_receive_data_callback_t cb, void *cb_data,
+		sr_usb_buffer_callback_t buffer_cb, unsigned int num_transfers,
+		size_t buffer_size);
+SR_PRIV gboolean usb_event_thread_running(struct sr_context *ctx);
+SR_PRIV gboolean usb_transfer_defer(struct sr_context *ctx,
+		struct libusb_transfer *transfer);
+SR_PRIV void usb_source_stop_resubmit(struct sr_context *ctx);
 #endif
 
+/*--- hardware/common/trigger.c ---------------------------------------------*/
+
+#define SR_SOFT_TRIGGER_MAX_STAGES 8
+
+/** Multi-stage software trigger on 8 or 16-bit logic samples. */
+struct sr_soft_trigger {
+	/** Sample size in bytes, 1 or 2. */
+	int unitsize;
+	int num_stages;
+	uint16_t mask[SR_SOFT_TRIGGER_MAX_STAGES];
+	uint16_t value[SR_SOFT_TRIGGER_MAX_STAGES];
+	/** Number of stages matched so far. */
+	int stage;
+	/** The samples matching each stage so far, unitsize bytes each. */
+	uint8_t matched[SR_SOFT_TRIGGER_MAX_STAGES * 2];
+};
+
+SR_PRIV void sr_soft_trigger_init(struct sr_soft_trigger *st, int unitsize);
+SR_PRIV int sr_soft_trigger_add_stage(struct sr_soft_trigger *st,
+		uint16_t mask, uint16_t value);
+SR_PRIV void sr_soft_trigger_reset(struct sr_soft_trigger *st);
+SR_PRIV int sr_soft_trigger_scan(struct sr_soft_trigger *st,
+		const uint8_t *buf, int num_samples);
+
 /*--- hardware/common/scpi.c ------------------------------------------------*/
 
 #define SCPI_CMD_IDN "*IDN?"
@@ -366,6 +550,18 @@ enum {
 	SCPI_CMD_GET_DIG_DATA,
 };
 
+/** Types of the commands and queries of a struct sr_scpi_batch. */
+enum {
+	SCPI_BATCH_CMD,
+	SCPI_BATCH_STRING,
+	SCPI_BATCH_BOOL,
+	SCPI_BATCH_INT,
+	SCPI_BATCH_FLOAT,
+	SCPI_BATCH_DOUBLE,
+};
+
+struct sr_scpi_batch;
+
 struct sr_scpi_hw_info {
 	char *manufacturer;
 	char *model;
@@ -373,6 +569,17 @@ struct sr_scpi_hw_info {
 	char *firmware_version;
 };
 
+/** Parser state for an IEEE 488.2 definite length arbitrary block. */
+struct sr_scpi_block {
+	/** Header bytes ("#<n><length>") received so far. */
+	char header[12];
+	int header_len;
+	/** Length of the block data, or -1 while the header is incomplete. */
+	int length;
+	/** Number of data bytes read so far. */
+	int pos;
+};
+
 struct sr_scpi_dev_inst {
 	int (*open)(void *priv);
 	int (*source_add)(void *priv, int events,
@@ -385,6 +592,12 @@ struct sr_scpi_dev_inst {
 	int (*close)(void *priv);
 	void (*free)(void *priv);
 	void *priv;
+	/*
+	 * The transport passes the terminating linefeed on to read_data()
+	 * without knowing where a response ends, so read_complete() can't
+	 * tell it apart from a 0x0a byte in block data.
+	 */
+	gboolean unframed;
 };
 
 SR_PRIV int sr_scpi_open(struct sr_scpi_dev_inst *scpi);
@@ -416,6 +629,21 @@ SR_PRIV int sr_scpi_get_floatv(struct sr_scpi_dev_inst *scpi,
 			const char *command, GArray **scpi_response);
 SR_PRIV int sr_scpi_get_uint8v(struct sr_scpi_dev_inst *scpi,
 			const char *command, GArray **scpi_response);
+SR_PRIV int sr_scpi_get_block(struct sr_scpi_dev_inst *scpi,
+			const char *command, GByteArray *scpi_response);
+SR_PRIV struct sr_scpi_batch *sr_scpi_batch_new(void);
+SR_PRIV void sr_scpi_batch_add(struct sr_scpi_batch *batch, int type,
+			void *result, const char *format, ...)
+			G_GNUC_PRINTF(4, 5);
+SR_PRIV int sr_scpi_batch_run(struct sr_scpi_dev_inst *scpi,
+			struct sr_scpi_batch *batch, gboolean compound);
+SR_PRIV void sr_scpi_batch_free(struct sr_scpi_batch *batch);
+SR_PRIV void sr_scpi_block_init(struct sr_scpi_block *block);
+SR_PRIV int sr_scpi_block_read(struct sr_scpi_dev_inst *scpi,
+			struct sr_scpi_block *block, char *buf, int maxlen);
+SR_PRIV gboolean sr_scpi_block_complete(const struct sr_scpi_block *block);
+SR_PRIV int sr_scpi_block_read_header(struct sr_scpi_dev_inst *scpi,
+			struct sr_scpi_block *block);
 SR_PRIV int sr_scpi_get_hw_id(struct sr_scpi_dev_inst *scpi,
 			struct sr_scpi_hw_info **scpi_response);
 SR_PRIV void sr_scpi_hw_info_free(struct sr_scpi_hw_info *hw_info);
@@ -101,6 +101,33 @@ enum {
 	SR_LOG_SPEW = 5, /**< Output very noisy debug messages. */
 };
 
+/** Trace buffer event IDs, see sr_trace_enable(). */
+enum {
+	/** A packet was sent to the session bus. arg1: type, arg2: samples. */
+	SR_TRACE_SESSION_SEND = 1,
+	/** A session source's callback ran. arg1: fd, arg2: revents. */
+	SR_TRACE_SOURCE_DISPATCH,
+	/** A USB transfer completed. arg1: status, arg2: length received. */
+	SR_TRACE_USB_TRANSFER,
+	/** Resubmitting a USB transfer failed. arg1: libusb error code. */
+	SR_TRACE_USB_RESUBMIT_FAILED,
+
+	/** Event IDs from here on are free for use by frontends. */
+	SR_TRACE_USER = 0x10000,
+};
+
+/** An entry in the trace buffer. */
+struct sr_trace_entry {
+	/** Monotonic time of the event, in microseconds. */
+	int64_t timestamp;
+	/** Event ID, SR_TRACE_SESSION_SEND etc. */
+	uint32_t event;
+	/** Event-specific payload. */
+	uint32_t arg1;
+	/** Event-specific payload. */
+	uint64_t arg2;
+};
+
 /*
  * Use SR_API to mark public API symbols, and SR_PRIV for private symbols.
  *
@@ -428,6 +455,12 @@ struct sr_input_format {
 	int (*loadfile) (struct sr_input *in, const char *filename);
 };
 
+/**
+ * Destination for the output of an output module, see sr_output_send().
+ * Opaque to frontends.
+ */
+struct sr_output_sink;
+
 /** Output (file) format struct. */
 struct sr_output {
 	/**
@@ -534,6 +567,36 @@ struct sr_output_format {
 		     uint64_t length_in, uint8_t **data_out,
 		     uint64_t *length_out);
 
+	/**
+	 * Optional zero-copy variant of data(), for modules whose output
+	 * is (part of) their input, or lives in a buffer the module keeps
+	 * anyway.
+	 *
+	 * Instead of allocating its output, the module points
+	 * <code>data_out</code> into <code>data_in</code> or into its own
+	 * memory. The caller must not alter or g_free() the output, which
+	 * is only valid until the next call into the module, or until
+	 * <code>data_in</code> goes away, whichever comes first. If there
+	 * is no output, NULL is stored in <code>data_out</code>.
+	 *
+	 * Frontends which write the output out right away should prefer
+	 * this over data() when a module implements it.
+	 *
+	 * @param o Pointer to the respective 'struct sr_output'.
+	 * @param data_in Pointer to the input data buffer.
+	 * @param length_in Length of the input.
+	 * @param data_out Pointer to the borrowed output.
+	 * @param length_out Length (in bytes) of the output.
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 *
+	 * @since 0.3.0
+	 */
+	int (*data_borrow) (struct sr_output *o, const uint8_t *data_in,
+			    uint64_t length_in, const uint8_t **data_out,
+			    uint64_t *length_out);
+
 	/**
 	 * This function is called when an event occurs in the datafeed
 	 * which the output module may need to be aware of. No data is
@@ -586,6 +649,29 @@ struct sr_output_format {
 	int (*receive) (struct sr_output *o, const struct sr_dev_inst *sdi,
 			const struct sr_datafeed_packet *packet, GString **out);
 
+	/**
+	 * Like receive(), but any output is appended to <code>out</code>,
+	 * which is owned by the caller and reused across packets. Nothing
+	 * is appended for packets not of interest to the module.
+	 *
+	 * Modules implementing this should set receive() to
+	 * sr_output_receive_compat(), for frontends not using
+	 * sr_output_send().
+	 *
+	 * @param o Pointer to the respective 'struct sr_output'.
+	 * @param sdi The device instance that generated the packet.
+	 * @param packet The complete packet.
+	 * @param out The buffer to append the output to.
+	 *
+	 * @retval SR_OK Success
+	 * @retval other Negative error code.
+	 *
+	 * @since 0.3.0
+	 */
+	int (*receive_append) (struct sr_output *o,
+			const struct sr_dev_inst *sdi,
+			const struct sr_datafeed_packet *packet, GString *out);
+
 	/**
 	 * This function is called after the caller is finished using
 	 * the output module, and can be used to free any internal
@@ -807,6 +893,12 @@ enum {
 	/** The device supports setting the number of analog probes. */
 	SR_CONF_NUM_ANALOG_PROBES,
 
+	/**
+	 * The device supports generating data as fast as possible, without
+	 * pacing it to the samplerate. Useful for benchmarking consumers.
+	 */
+	SR_CONF_MAX_THROUGHPUT,
+
 	/*--- Special stuff -------------------------------------------------*/
 
 	/** Scan options supported by the driver. */
@@ -839,6 +931,13 @@ enum {
 	 * is always the default. */
 	SR_CONF_DATA_SOURCE,
 
+	/**
+	 * Acquisition counters, as sent in SR_DF_META packets when enabled
+	 * with sr_session_stats_interval_set(). The value is a dictionary
+	 * (GVariant type "a{st}") of the struct sr_acq_stats fields by name.
+	 */
+	SR_CONF_ACQ_STATS,
+
 	/*--- Acquisition modes ---------------------------------------------*/
 
 	/**
@@ -871,6 +970,40 @@ enum {
 	SR_CONF_DATALOG,
 };
 
+/**
+ * Acquisition counters of a device or a whole session.
+ *
+ * All counters are reset when the session starts. Drivers only fill in
+ * the ones that apply to them, the rest stay 0.
+ */
+struct sr_acq_stats {
+	/** Bytes received from the device. */
+	uint64_t bytes_received;
+	/** USB transfers which completed with data. */
+	uint64_t transfers_completed;
+	/** USB transfers which completed without any data. */
+	uint64_t transfers_empty;
+	/** USB transfers which failed. */
+	uint64_t transfers_failed;
+	/** USB transfers which were resubmitted after completion. */
+	uint64_t transfers_resubmitted;
+	/** Packets sent to the session bus. */
+	uint64_t packets_sent;
+	/** Logic and analog samples sent to the session bus. */
+	uint64_t samples_delivered;
+	/** Time spent in datafeed callbacks, in microseconds. */
+	uint64_t dispatch_time;
+	/** Longest time a single packet spent in the callbacks, in us. */
+	uint64_t dispatch_time_max;
+	/**
+	 * Most completed transfers the USB event thread had queued up for
+	 * the session thread at once. Only counted per session.
+	 */
+	uint64_t queue_high_water;
+};
+
+struct sr_config_cache;
+
 /** Device instance data
  */
 struct sr_dev_inst {
@@ -896,6 +1029,10 @@ struct sr_dev_inst {
 	void *conn;
 	/** Device instance private data (used?) */
 	void *priv;
+	/** Acquisition counters, see sr_dev_stats_get(). */
+	struct sr_acq_stats stats;
+	/** Cached configuration, or NULL if the driver doesn't use one. */
+	struct sr_config_cache *config_cache;
 };
 
 /** Types of device instance, struct sr_dev_inst.type */
@@ -937,6 +1074,11 @@ struct sr_dev_driver {
 	int (*cleanup) (void);
 	/** Scan for devices */
 	GSList *(*scan) (GSList *options);
+	/**
+	 * TRUE if scan() only touches state of this driver, so that
+	 * sr_driver_scan_all() may run it concurrently with other scans.
+	 */
+	gboolean scan_threadsafe;
 	/** Get device list */
 	GSList *(*dev_list) (void);
 	int (*dev_clear) (void);
@@ -975,6 +1117,25 @@ struct sr_dev_driver {
  */
 struct sr_session;
 
+/**
+ * @struct sr_session_save_stream
+ *
+ * Opaque data structure for saving a session file while the data is being
+ * acquired, see sr_session_save_stream_new(). None of the fields of this
+ * structure are meant to be accessed directly.
+ */
+struct sr_session_save_stream;
+
+/** Storage formats for analog probes in session files. */
+enum {
+	/** 32-bit IEEE 754 floating point values. */
+	SR_SESSION_ANALOG_FLOAT32,
+	/** Signed integers, the value is raw * scale + offset. */
+	SR_SESSION_ANALOG_INT8,
+	SR_SESSION_ANALOG_INT16,
+	SR_SESSION_ANALOG_INT32,
+};
+
 #include "proto.h"
 #include "version.h"
 
@@ -38,8 +38,11 @@
  * @{
  */
 
-/* Currently selected libsigrok loglevel. Default: SR_LOG_WARN. */
-static int sr_loglevel = SR_LOG_WARN; /* Show errors+warnings per default. */
+/*
+ * Currently selected libsigrok loglevel. Default: SR_LOG_WARN.
+ * The logging macros check it before evaluating their arguments.
+ */
+SR_PRIV int sr_loglevel = SR_LOG_WARN; /* Show errors+warnings per default. */
 
 /* Function prototype. */
 static int sr_logv(void *cb_data, int loglevel, const char *format,
@@ -219,12 +222,136 @@ static int sr_logv(void *cb_data, int loglevel, const char *format, va_list args
 	return ret;
 }
 
+/*
+ * The trace buffer, NULL while tracing is disabled. Writers claim entries
+ * by atomically incrementing trace_pos, so no lock is needed.
+ */
+SR_PRIV struct sr_trace_entry *sr_trace_buf = NULL;
+static unsigned int trace_size = 0;
+static volatile gint trace_pos = 0;
+
+/**
+ * Enable or disable the trace buffer.
+ *
+ * The trace buffer is a fixed size in-memory ring of binary events
+ * (struct sr_trace_entry), which libsigrok records at a few points of the
+ * acquisition path. Unlike debug logging, recording an event only takes
+ * a few nanoseconds, so it can stay enabled in production and be dumped
+ * with sr_trace_get() after something went wrong. When the buffer is
+ * full, the oldest events are overwritten.
+ *
+ * This must not be called while a session is running.
+ *
+ * @param num_entries Size of the buffer, rounded up to a power of two.
+ *                    0 disables tracing and frees the buffer.
+ *
+ * @return SR_OK upon success, SR_ERR_MALLOC upon memory allocation errors.
+ *
+ * @since 0.3.0
+ */
+SR_API int sr_trace_enable(unsigned int num_entries)
+{
+	struct sr_trace_entry *buf;
+	unsigned int size;
+
+	buf = sr_trace_buf;
+	sr_trace_buf = NULL;
+	g_free(buf);
+
+	if (num_entries == 0)
+		return SR_OK;
+
+	for (size = 1; size < num_entries; size <<= 1);
+	if (!(buf = g_try_malloc0(size * sizeof(struct sr_trace_entry)))) {
+		sr_err("Trace buffer malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+	trace_size = size;
+	g_atomic_int_set(&trace_pos, 0);
+	sr_trace_buf = buf;
+
+	return SR_OK;
+}
+
+/**
+ * Record an event in the trace buffer.
+ *
+ * This is safe to call from any thread. Frontends can use event IDs
+ * starting at SR_TRACE_USER to mark their own events.
+ *
+ * @param event Event ID.
+ * @param arg1 Event-specific payload.
+ * @param arg2 Event-specific payload.
+ *
+ * @return SR_OK upon success, SR_ERR if tracing is disabled.
+ *
+ * @since 0.3.0
+ */
+SR_API int sr_trace_add(uint32_t event, uint32_t arg1, uint64_t arg2)
+{
+	struct sr_trace_entry *buf, *entry;
+	unsigned int pos;
+
+	if (!(buf = sr_trace_buf))
+		return SR_ERR;
+
+	pos = g_atomic_int_add(&trace_pos, 1);
+	entry = &buf[pos & (trace_size - 1)];
+	entry->timestamp = g_get_monotonic_time();
+	entry->event = event;
+	entry->arg1 = arg1;
+	entry->arg2 = arg2;
+
+	return SR_OK;
+}
+
+/**
+ * Get a copy of the trace buffer.
+ *
+ * @param entries Will be set to a newly allocated array of the recorded
+ *                events, oldest first. The caller must g_free() it.
+ * @param num_entries Will be set to the number of events in the array.
+ *
+ * @return SR_OK upon success, SR_ERR if tracing is disabled, SR_ERR_ARG
+ *         upon invalid arguments, SR_ERR_MALLOC upon memory allocation
+ *         errors.
+ *
+ * @since 0.3.0
+ */
+SR_API int sr_trace_get(struct sr_trace_entry **entries,
+		unsigned int *num_entries)
+{
+	struct sr_trace_entry *buf;
+	unsigned int pos, num, i;
+
+	if (!entries || !num_entries)
+		return SR_ERR_ARG;
+
+	if (!(buf = sr_trace_buf))
+		return SR_ERR;
+
+	pos = g_atomic_int_get(&trace_pos);
+	num = MIN(pos, trace_size);
+	if (!(*entries = g_try_malloc(MAX(num, 1) * sizeof(struct sr_trace_entry)))) {
+		sr_err("Trace buffer copy malloc failed.");
+		return SR_ERR_MALLOC;
+	}
+	for (i = 0; i < num; i++)
+		(*entries)[i] = buf[(pos - num + i) & (trace_size - 1)];
+	*num_entries = num;
+
+	return SR_OK;
+}
+
 /** @private */
 SR_PRIV int sr_log(int loglevel, const char *format, ...)
 {
 	int ret;
 	va_list args;
 
+	if (loglevel > sr_loglevel)
+		return SR_OK;
+
 	va_start(args, format);
 	ret = sr_log_callback(sr_log_callback_data, loglevel, format, args);
 	va_end(args);
@@ -238,6 +365,9 @@ SR_PRIV int sr_spew(const char *format, ...)
 	int ret;
 	va_list args;
 
+	if (SR_LOG_SPEW > sr_loglevel)
+		return SR_OK;
+
 	va_start(args, format);
 	ret = sr_log_callback(sr_log_callback_data, SR_LOG_SPEW, format, args);
 	va_end(args);
@@ -251,6 +381,9 @@ SR_PRIV int sr_dbg(const char *format, ...)
 	int ret;
 	va_list args;
 
+	if (SR_LOG_DBG > sr_loglevel)
+		return SR_OK;
+
 	va_start(args, format);
 	ret = sr_log_callback(sr_log_callback_data, SR_LOG_DBG, format, args);
 	va_end(args);
@@ -264,6 +397,9 @@ SR_PRIV int sr_info(const char *format, ...)
 	int ret;
 	va_list args;
 
+	if (SR_LOG_INFO > sr_loglevel)
+		return SR_OK;
+
 	va_start(args, format);
 	ret = sr_log_callback(sr_log_callback_data, SR_LOG_INFO, format, args);
 	va_end(args);
@@ -277,6 +413,9 @@ SR_PRIV int sr_warn(const char *format, ...)
 	int ret;
 	va_list args;
 
+	if (SR_LOG_WARN > sr_loglevel)
+		return SR_OK;
+
 	va_start(args, format);
 	ret = sr_log_callback(sr_log_callback_data, SR_LOG_WARN, format, args);
 	va_end(args);
@@ -290,6 +429,9 @@ SR_PRIV int sr_err(const char *format, ...)
 	int ret;
 	va_list args;
 
+	if (SR_LOG_ERR > sr_loglevel)
+		return SR_OK;
+
 	va_start(args, format);
 	ret = sr_log_callback(sr_log_callback_data, SR_LOG_ERR, format, args);
 	va_end(args);
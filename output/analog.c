@@ -206,8 +206,8 @@ static void fancyprint(int unit, int mqflags, float value, GString *out)
 	g_string_append_c(out, '\n');
 }
 
-static int receive(struct sr_output *o, const struct sr_dev_inst *sdi,
-		const struct sr_datafeed_packet *packet, GString **out)
+static int receive_append(struct sr_output *o, const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, GString *out)
 {
 	const struct sr_datafeed_analog *analog;
 	struct sr_probe *probe;
@@ -217,27 +217,25 @@ static int receive(struct sr_output *o, const struct sr_dev_inst *sdi,
 
 	(void)sdi;
 
-	*out = NULL;
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 
 	switch (packet->type) {
 	case SR_DF_FRAME_BEGIN:
-		*out = g_string_new("FRAME-BEGIN\n");
+		g_string_append(out, "FRAME-BEGIN\n");
 		break;
 	case SR_DF_FRAME_END:
-		*out = g_string_new("FRAME-END\n");
+		g_string_append(out, "FRAME-END\n");
 		break;
 	case SR_DF_ANALOG:
 		analog = packet->payload;
 		fdata = (const float *)analog->data;
-		*out = g_string_sized_new(512);
 		for (i = 0; i < analog->num_samples; i++) {
 			for (l = analog->probes, p = 0; l; l = l->next, p++) {
 				probe = l->data;
-				g_string_append_printf(*out, "%s: ", probe->name);
+				g_string_append_printf(out, "%s: ", probe->name);
 				fancyprint(analog->unit, analog->mqflags,
-						fdata[i + p], *out);
+						fdata[i + p], out);
 			}
 		}
 		break;
@@ -266,6 +264,7 @@ SR_PRIV struct sr_output_format output_analog = {
 	.description = "Analog data",
 	.df_type = SR_DF_ANALOG,
 	.init = init,
-	.receive = receive,
+	.receive = sr_output_receive_compat,
+	.receive_append = receive_append,
 	.cleanup = cleanup
 };
@@ -48,7 +48,7 @@ static int data(struct sr_output *o, const uint8_t *data_in,
 		return SR_ERR_ARG;
 	}
 
-	if (!(outbuf = g_try_malloc0(length_in))) {
+	if (!(outbuf = g_try_malloc(length_in))) {
 		sr_err("%s: outbuf malloc failed", __func__);
 		return SR_ERR_MALLOC;
 	}
@@ -60,11 +60,30 @@ static int data(struct sr_output *o, const uint8_t *data_in,
 	return SR_OK;
 }
 
+/* The output is the input, so just hand it back. */
+static int data_borrow(struct sr_output *o, const uint8_t *data_in,
+		uint64_t length_in, const uint8_t **data_out,
+		uint64_t *length_out)
+{
+	(void)o;
+
+	if (!data_out || !length_out) {
+		sr_err("%s: data_out or length_out was NULL", __func__);
+		return SR_ERR_ARG;
+	}
+
+	*data_out = length_in ? data_in : NULL;
+	*length_out = length_in;
+
+	return SR_OK;
+}
+
 SR_PRIV struct sr_output_format output_binary = {
 	.id = "binary",
 	.description = "Raw binary",
 	.df_type = SR_DF_LOGIC,
 	.init = NULL,
 	.data = data,
+	.data_borrow = data_borrow,
 	.event = NULL,
 };
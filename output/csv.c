@@ -27,26 +27,150 @@
 
 #define LOG_PREFIX "output/csv"
 
+/* Rows are assembled in blocks of this many samples. */
+#define ROWS_PER_BLOCK		1024
+
+/*
+ * A run of consecutive columns whose bits are all in the same byte of
+ * a sample. The table holds the "0,1,...," text of the run for all 256
+ * values of that byte.
+ */
+struct column_run {
+	unsigned int byte;
+	unsigned int len;
+	char *table;
+};
+
 struct context {
 	unsigned int num_enabled_probes;
-	unsigned int unitsize;
 	uint64_t samplerate;
 	GString *header;
 	char separator;
+	struct column_run *runs;
+	unsigned int num_runs;
+	/* Maximum length of a row, including index column and newline. */
+	unsigned int max_rowlen;
+	gboolean index_column;
+	gboolean changes_only;
+	struct sr_output_changes changes;
 };
 
 /*
+ * Options, passed as a comma-separated list in the module parameter:
+ *  - index: Prepend the sample number to every row.
+ *  - changes: Only print samples which differ from the previous one
+ *    (and the last one), implies index.
+ *
  * TODO:
  *  - Option to specify delimiter character and/or string.
  *  - Option to (not) print metadata as comments.
  *  - Option to specify the comment character(s), e.g. # or ; or C/C++-style.
- *  - Option to (not) print samplenumber / time as extra column.
- *  - Option to "compress" output (only print changed samples, VCD-like).
  *  - Option to print comma-separated bits, or whole bytes/words (for 8/16
  *    probe LAs) as ASCII/hex etc. etc.
  *  - Trigger support.
  */
 
+static int parse_param(struct context *ctx, const char *param)
+{
+	char **tokens;
+	int i, ret;
+
+	if (!param || !param[0])
+		return SR_OK;
+
+	ret = SR_OK;
+	tokens = g_strsplit(param, ",", 0);
+	for (i = 0; tokens[i]; i++) {
+		if (!strcmp(tokens[i], "index")) {
+			ctx->index_column = TRUE;
+		} else if (!strcmp(tokens[i], "changes")) {
+			ctx->changes_only = TRUE;
+			ctx->index_column = TRUE;
+		} else {
+			sr_err("Unknown option '%s'.", tokens[i]);
+			ret = SR_ERR_ARG;
+		}
+	}
+	g_strfreev(tokens);
+
+	return ret;
+}
+
+static void free_runs(struct context *ctx)
+{
+	unsigned int i;
+
+	for (i = 0; i < ctx->num_runs; i++)
+		g_free(ctx->runs[i].table);
+	g_free(ctx->runs);
+	ctx->runs = NULL;
+	ctx->num_runs = 0;
+}
+
+/*
+ * Build the lookup tables. Columns are in probe order, and the bit of
+ * each probe in a sample is given by its index, so probes may be
+ * disabled and there may be any number of them.
+ */
+static int build_runs(struct context *ctx, const struct sr_dev_inst *sdi)
+{
+	struct sr_probe *probe;
+	struct column_run *run;
+	GSList *l;
+	unsigned int col, v;
+	char *entry;
+
+	if (ctx->num_enabled_probes == 0)
+		return SR_OK;
+
+	if (!(ctx->runs = g_try_malloc0(ctx->num_enabled_probes
+			* sizeof(struct column_run)))) {
+		sr_err("%s: runs malloc failed", __func__);
+		return SR_ERR_MALLOC;
+	}
+
+	run = NULL;
+	for (l = sdi->probes; l; l = l->next) {
+		probe = l->data;
+		if (probe->type != SR_PROBE_LOGIC || !probe->enabled)
+			continue;
+		if (!run || run->byte != (unsigned int)probe->index / 8) {
+			run = &ctx->runs[ctx->num_runs++];
+			run->byte = probe->index / 8;
+		}
+		run->len += 2;
+	}
+
+	/* Second pass, now that the length of each run is known. */
+	run = ctx->runs;
+	col = 0;
+	for (l = sdi->probes; l; l = l->next) {
+		probe = l->data;
+		if (probe->type != SR_PROBE_LOGIC || !probe->enabled)
+			continue;
+		if (col == run->len) {
+			run++;
+			col = 0;
+		}
+		if (!run->table && !(run->table = g_try_malloc(256 * run->len))) {
+			sr_err("%s: table malloc failed", __func__);
+			return SR_ERR_MALLOC;
+		}
+		for (v = 0; v < 256; v++) {
+			entry = run->table + v * run->len + col;
+			entry[0] = (v >> (probe->index % 8)) & 1 ? '1' : '0';
+			entry[1] = ctx->separator;
+		}
+		col += 2;
+	}
+
+	ctx->max_rowlen = 2 * ctx->num_enabled_probes + 1;
+	if (ctx->index_column)
+		ctx->max_rowlen += 20 + 1;
+
+	return SR_OK;
+}
+
 static int init(struct sr_output *o)
 {
 	struct context *ctx;
@@ -72,8 +196,15 @@ static int init(struct sr_output *o)
 	}
 
 	o->internal = ctx;
+	ctx->separator = ',';
 
-	/* Get the number of probes, and the unitsize. */
+	if (parse_param(ctx, o->param) != SR_OK) {
+		g_free(ctx);
+		o->internal = NULL;
+		return SR_ERR_ARG;
+	}
+
+	/* Get the number of probes. */
 	for (l = o->sdi->probes; l; l = l->next) {
 		probe = l->data;
 		if (probe->type != SR_PROBE_LOGIC)
@@ -83,7 +214,12 @@ static int init(struct sr_output *o)
 		ctx->num_enabled_probes++;
 	}
 
-	ctx->unitsize = (ctx->num_enabled_probes + 7) / 8;
+	if (build_runs(ctx, o->sdi) != SR_OK) {
+		free_runs(ctx);
+		g_free(ctx);
+		o->internal = NULL;
+		return SR_ERR_MALLOC;
+	}
 
 	num_probes = g_slist_length(o->sdi->probes);
 
@@ -94,7 +230,6 @@ static int init(struct sr_output *o)
 	} else
 		ctx->samplerate = 0;
 
-	ctx->separator = ',';
 	ctx->header = g_string_sized_new(512);
 
 	t = time(NULL);
@@ -108,6 +243,8 @@ static int init(struct sr_output *o)
 	/* Columns / channels */
 	g_string_append_printf(ctx->header, "; Channels (%d/%d): ",
 			       ctx->num_enabled_probes, num_probes);
+	if (ctx->index_column)
+		g_string_append(ctx->header, "sample, ");
 	for (l = o->sdi->probes; l; l = l->next) {
 		probe = l->data;
 		if (probe->type != SR_PROBE_LOGIC)
@@ -117,61 +254,89 @@ static int init(struct sr_output *o)
 		g_string_append_printf(ctx->header, "%s, ", probe->name);
 	}
 	g_string_append_printf(ctx->header, "\n");
+	if (ctx->changes_only)
+		g_string_append(ctx->header, "; Only changed samples\n");
 
 	return SR_OK;
 }
 
-static int event(struct sr_output *o, int event_type, uint8_t **data_out,
-		 uint64_t *length_out)
+static char *write_row(const struct context *ctx, char *p,
+		const uint8_t *sample, unsigned int unitsize, uint64_t index)
 {
-	struct context *ctx;
+	const struct column_run *run;
+	unsigned int i;
+	uint8_t v;
 
-	if (!o) {
-		sr_err("%s: o was NULL", __func__);
-		return SR_ERR_ARG;
+	if (ctx->index_column) {
+		p = sr_output_put_decimal(p, index);
+		*p++ = ctx->separator;
 	}
 
-	if (!(ctx = o->internal)) {
-		sr_err("%s: o->internal was NULL", __func__);
-		return SR_ERR_ARG;
+	for (i = 0; i < ctx->num_runs; i++) {
+		run = &ctx->runs[i];
+		v = run->byte < unitsize ? sample[run->byte] : 0;
+		memcpy(p, run->table + v * run->len, run->len);
+		p += run->len;
 	}
+	*p++ = '\n';
 
-	if (!data_out) {
-		sr_err("%s: data_out was NULL", __func__);
+	return p;
+}
+
+static int logic_append(struct context *ctx,
+		const struct sr_datafeed_logic *logic, GString *out)
+{
+	const uint8_t *data, *prev, *sample;
+	uint64_t i, num_samples, block_end;
+	unsigned int unitsize;
+	gsize pos;
+	char *p;
+	int ret;
+
+	unitsize = logic->unitsize;
+	if (unitsize == 0)
 		return SR_ERR_ARG;
+	num_samples = logic->length / unitsize;
+	if (num_samples == 0)
+		return SR_OK;
+
+	prev = NULL;
+	if (ctx->changes_only && (ret = sr_output_changes_begin(&ctx->changes,
+			unitsize, &prev)) != SR_OK)
+		return ret;
+
+	data = logic->data;
+	for (i = 0; i < num_samples; i = block_end) {
+		block_end = MIN(i + ROWS_PER_BLOCK, num_samples);
+		pos = out->len;
+		g_string_set_size(out, pos + (block_end - i) * ctx->max_rowlen);
+		p = out->str + pos;
+		for (; i < block_end; i++) {
+			sample = data + i * unitsize;
+			if (ctx->changes_only && !sr_output_changes_check(
+					&ctx->changes, &prev, sample, i))
+				continue;
+			p = write_row(ctx, p, sample, unitsize,
+				      ctx->changes.num_samples + i);
+		}
+		g_string_truncate(out, p - out->str);
 	}
 
-	switch (event_type) {
-	case SR_DF_TRIGGER:
-		sr_dbg("%s: SR_DF_TRIGGER event", __func__);
-		/* TODO */
-		*data_out = NULL;
-		*length_out = 0;
-		break;
-	case SR_DF_END:
-		sr_dbg("%s: SR_DF_END event", __func__);
-		/* TODO */
-		*data_out = NULL;
-		*length_out = 0;
-		g_free(o->internal);
-		o->internal = NULL;
-		break;
-	default:
-		sr_err("%s: unsupported event type: %d", __func__, event_type);
-		*data_out = NULL;
-		*length_out = 0;
-		break;
-	}
+	sr_output_changes_end(&ctx->changes, prev, num_samples);
 
 	return SR_OK;
 }
 
-static int data(struct sr_output *o, const uint8_t *data_in,
-		uint64_t length_in, uint8_t **data_out, uint64_t *length_out)
+static int receive_append(struct sr_output *o, const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, GString *out)
 {
 	struct context *ctx;
-	GString *outstr;
-	uint64_t sample, i, j;
+	const uint8_t *sample;
+	uint64_t index;
+	gsize pos;
+	char *p;
+
+	(void)sdi;
 
 	if (!o) {
 		sr_err("%s: o was NULL", __func__);
@@ -183,32 +348,50 @@ static int data(struct sr_output *o, const uint8_t *data_in,
 		return SR_ERR_ARG;
 	}
 
-	if (!data_in) {
-		sr_err("%s: data_in was NULL", __func__);
-		return SR_ERR_ARG;
+	switch (packet->type) {
+	case SR_DF_TRIGGER:
+		sr_dbg("%s: SR_DF_TRIGGER event", __func__);
+		/* TODO */
+		return SR_OK;
+	case SR_DF_LOGIC:
+		break;
+	case SR_DF_END:
+		if (ctx->changes_only && (sample = sr_output_changes_last(
+				&ctx->changes, &index))) {
+			pos = out->len;
+			g_string_set_size(out, pos + ctx->max_rowlen);
+			p = write_row(ctx, out->str + pos, sample,
+				      ctx->changes.unitsize, index);
+			g_string_truncate(out, p - out->str);
+		}
+		return SR_OK;
+	default:
+		return SR_OK;
 	}
 
 	if (ctx->header) {
 		/* First data packet. */
-		outstr = ctx->header;
+		g_string_append_len(out, ctx->header->str, ctx->header->len);
+		g_string_free(ctx->header, TRUE);
 		ctx->header = NULL;
-	} else {
-		outstr = g_string_sized_new(512);
 	}
 
-	for (i = 0; i <= length_in - ctx->unitsize; i += ctx->unitsize) {
-		memcpy(&sample, data_in + i, ctx->unitsize);
-		for (j = 0; j < ctx->num_enabled_probes; j++) {
-			g_string_append_printf(outstr, "%d%c",
-				(int)((sample & (1 << j)) >> j),
-				ctx->separator);
-		}
-		g_string_append_printf(outstr, "\n");
-	}
+	return logic_append(ctx, packet->payload, out);
+}
+
+static int cleanup(struct sr_output *o)
+{
+	struct context *ctx;
+
+	if (!o || !(ctx = o->internal))
+		return SR_ERR_ARG;
 
-	*data_out = (uint8_t *)outstr->str;
-	*length_out = outstr->len;
-	g_string_free(outstr, FALSE);
+	if (ctx->header)
+		g_string_free(ctx->header, TRUE);
+	free_runs(ctx);
+	sr_output_changes_free(&ctx->changes);
+	g_free(ctx);
+	o->internal = NULL;
 
 	return SR_OK;
 }
@@ -218,6 +401,7 @@ SR_PRIV struct sr_output_format output_csv = {
 	.description = "Comma-separated values (CSV)",
 	.df_type = SR_DF_LOGIC,
 	.init = init,
-	.data = data,
-	.event = event,
+	.receive = sr_output_receive_compat,
+	.receive_append = receive_append,
+	.cleanup = cleanup,
 };
@@ -35,30 +35,29 @@
 
 struct context {
 	uint64_t samplerate;
-	uint64_t num_samples;
+	struct sr_output_changes changes;
 };
 
+static const char hexdigits[] = "0123456789abcdef";
+
 static int init(struct sr_output *o)
 {
 	struct context *ctx;
 
-	if (!(ctx = g_try_malloc(sizeof(struct context)))) {
+	if (!(ctx = g_try_malloc0(sizeof(struct context)))) {
 		sr_err("%s: ctx malloc failed", __func__);
 		return SR_ERR_MALLOC;
 	}
 	o->internal = ctx;
 
-	ctx->samplerate = 0;
-	ctx->num_samples = 0;
-
 	return SR_OK;
 }
 
-static GString *gen_header(const struct sr_dev_inst *sdi, struct context *ctx)
+static void gen_header(const struct sr_dev_inst *sdi, struct context *ctx,
+		GString *s)
 {
 	struct sr_probe *probe;
 	GSList *l;
-	GString *s;
 	GVariant *gvar;
 	int num_enabled_probes;
 
@@ -78,28 +77,82 @@ static GString *gen_header(const struct sr_dev_inst *sdi, struct context *ctx)
 		num_enabled_probes++;
 	}
 
-	s = g_string_sized_new(512);
 	g_string_append_printf(s, ";Rate: %"PRIu64"\n", ctx->samplerate);
 	g_string_append_printf(s, ";Channels: %d\n", num_enabled_probes);
 	g_string_append_printf(s, ";EnabledChannels: -1\n");
 	g_string_append_printf(s, ";Compressed: true\n");
 	g_string_append_printf(s, ";CursorEnabled: false\n");
+}
+
+/* Append a "<hex value>@<index>" line, without going through printf. */
+static void append_sample(GString *out, const uint8_t *sample,
+		unsigned int unitsize, uint64_t index)
+{
+	char *p;
+	gsize pos;
+	int j;
+
+	pos = out->len;
+	g_string_set_size(out, pos + 2 * unitsize + 1 + 20 + 1);
+	p = out->str + pos;
+	/* The OLS format wants the samples presented MSB first. */
+	for (j = unitsize - 1; j >= 0; j--) {
+		*p++ = hexdigits[sample[j] >> 4];
+		*p++ = hexdigits[sample[j] & 0x0f];
+	}
+	*p++ = '@';
+	p = sr_output_put_decimal(p, index);
+	*p++ = '\n';
+	g_string_truncate(out, p - out->str);
+}
+
+/*
+ * Only samples differing from the one before are written, each value
+ * holds until the index of the next line. Whole samples are compared.
+ */
+static int logic_append(struct context *ctx,
+		const struct sr_datafeed_logic *logic, GString *out)
+{
+	const uint8_t *data, *prev, *sample;
+	uint64_t i, num_samples;
+	unsigned int unitsize;
+	int ret;
+
+	unitsize = logic->unitsize;
+	if (unitsize == 0)
+		return SR_ERR_ARG;
+	num_samples = logic->length / unitsize;
+	if (num_samples == 0)
+		return SR_OK;
+
+	if ((ret = sr_output_changes_begin(&ctx->changes, unitsize,
+			&prev)) != SR_OK)
+		return ret;
+
+	data = logic->data;
+	for (i = 0; i < num_samples; i++) {
+		sample = data + i * unitsize;
+		if (sr_output_changes_check(&ctx->changes, &prev, sample, i))
+			append_sample(out, sample, unitsize,
+				      ctx->changes.num_samples + i);
+	}
 
-	return s;
+	sr_output_changes_end(&ctx->changes, prev, num_samples);
+
+	return SR_OK;
 }
 
-static int receive(struct sr_output *o, const struct sr_dev_inst *sdi,
-		const struct sr_datafeed_packet *packet, GString **out)
+static int receive_append(struct sr_output *o, const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, GString *out)
 {
 	struct context *ctx;
 	const struct sr_datafeed_meta *meta;
 	const struct sr_datafeed_logic *logic;
 	const struct sr_config *src;
+	const uint8_t *sample;
+	uint64_t index;
 	GSList *l;
-	unsigned int i, j;
-	uint8_t c;
 
-	*out = NULL;
 	if (!o || !o->sdi)
 		return SR_ERR_ARG;
 	ctx = o->internal;
@@ -115,19 +168,14 @@ static int receive(struct sr_output *o, const struct sr_dev_inst *sdi,
 		break;
 	case SR_DF_LOGIC:
 		logic = packet->payload;
-		if (ctx->num_samples == 0) {
+		if (ctx->changes.num_samples == 0) {
 			/* First logic packet in the feed. */
-			*out = gen_header(sdi, ctx);
-		} else
-			*out = g_string_sized_new(512);
-		for (i = 0; i <= logic->length - logic->unitsize; i += logic->unitsize) {
-			for (j = 0; j < logic->unitsize; j++) {
-				/* The OLS format wants the samples presented MSB first. */
-				c = *((uint8_t *)logic->data + i + logic->unitsize - 1 - j);
-				g_string_append_printf(*out, "%02x", c);
-			}
-			g_string_append_printf(*out, "@%"PRIu64"\n", ctx->num_samples++);
+			gen_header(sdi, ctx, out);
 		}
+		return logic_append(ctx, logic, out);
+	case SR_DF_END:
+		if ((sample = sr_output_changes_last(&ctx->changes, &index)))
+			append_sample(out, sample, ctx->changes.unitsize, index);
 		break;
 	}
 
@@ -142,6 +190,7 @@ static int cleanup(struct sr_output *o)
 		return SR_ERR_ARG;
 
 	ctx = o->internal;
+	sr_output_changes_free(&ctx->changes);
 	g_free(ctx);
 	o->internal = NULL;
 
@@ -153,6 +202,7 @@ SR_PRIV struct sr_output_format output_ols = {
 	.description = "OpenBench Logic Sniffer",
 	.df_type = SR_DF_LOGIC,
 	.init = init,
-	.receive = receive,
+	.receive = sr_output_receive_compat,
+	.receive_append = receive_append,
 	.cleanup = cleanup
 };
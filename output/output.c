@@ -17,9 +17,15 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
 #include "libsigrok.h"
 #include "libsigrok-internal.h"
 
+#define LOG_PREFIX "output"
+
 /**
  * @file
  *
@@ -45,6 +51,17 @@
  * the allocated memory back to the caller. The caller is then expected to
  * free this memory when finished with it.
  *
+ * Modules which can pass their input through unchanged, or otherwise
+ * already have their output in memory, may also implement data_borrow(),
+ * which hands out a pointer to that memory instead of a copy.
+ *
+ * Frontends can also hand the output off to an output sink with
+ * sr_output_send(). A sink either collects the output in one reusable
+ * buffer, or passes it to a write callback (e.g. straight to a file
+ * descriptor) in large blocks. Modules implementing receive_append()
+ * write directly into the sink's buffer, without any allocation per
+ * packet.
+ *
  * @{
  */
 
@@ -77,9 +94,449 @@ static struct sr_output_format *output_module_list[] = {
 	NULL,
 };
 
+/* Output is handed to the write callback once this much has piled up. */
+#define SINK_FLUSH_SIZE		(64 * 1024)
+
+struct sr_output_sink {
+	GString *buf;
+	sr_output_write_callback_t cb;
+	void *cb_data;
+};
+
 SR_API struct sr_output_format **sr_output_list(void)
 {
 	return output_module_list;
 }
 
+/**
+ * Create a new output sink.
+ *
+ * @param cb Callback which is passed the output, or NULL to only collect
+ *           the output in the sink's buffer, see sr_output_sink_buffer().
+ * @param cb_data Data passed to cb.
+ *
+ * @return The new sink, or NULL upon errors. The caller must free it
+ *         with sr_output_sink_free().
+ *
+ * @since 0.3.0
+ */
+SR_API struct sr_output_sink *sr_output_sink_new(sr_output_write_callback_t cb,
+		void *cb_data)
+{
+	struct sr_output_sink *sink;
+
+	if (!(sink = g_try_malloc(sizeof(struct sr_output_sink)))) {
+		sr_err("Output sink malloc failed.");
+		return NULL;
+	}
+	sink->buf = g_string_sized_new(SINK_FLUSH_SIZE);
+	sink->cb = cb;
+	sink->cb_data = cb_data;
+
+	return sink;
+}
+
+static int write_fd(const uint8_t *buf, size_t len, void *cb_data)
+{
+	ssize_t ret;
+	int fd;
+
+	fd = GPOINTER_TO_INT(cb_data);
+	while (len > 0) {
+		if ((ret = write(fd, buf, len)) < 0) {
+			if (errno == EINTR)
+				continue;
+			sr_err("Output write failed: %s.", strerror(errno));
+			return SR_ERR;
+		}
+		buf += ret;
+		len -= ret;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Create a new output sink which writes to a file descriptor.
+ *
+ * The file descriptor is not closed when the sink is freed.
+ *
+ * @param fd The file descriptor, opened for writing.
+ *
+ * @return The new sink, or NULL upon errors. The caller must free it
+ *         with sr_output_sink_free().
+ *
+ * @since 0.3.0
+ */
+SR_API struct sr_output_sink *sr_output_sink_fd_new(int fd)
+{
+	if (fd < 0)
+		return NULL;
+
+	return sr_output_sink_new(write_fd, GINT_TO_POINTER(fd));
+}
+
+/**
+ * Get the buffer of an output sink.
+ *
+ * For a sink without a write callback, all output ends up here. The
+ * caller may consume and truncate it at any time, the memory is reused.
+ *
+ * @param sink The sink.
+ *
+ * @return The sink's buffer, or NULL if sink was NULL. The buffer is
+ *         owned by the sink and remains valid until sr_output_sink_free(),
+ *         it must not be freed by the caller.
+ *
+ * @since 0.3.0
+ */
+SR_API GString *sr_output_sink_buffer(struct sr_output_sink *sink)
+{
+	return sink ? sink->buf : NULL;
+}
+
+/**
+ * Pass any buffered output to the sink's write callback.
+ *
+ * The buffer is emptied, even if the callback failed. Without a write
+ * callback, this does nothing.
+ *
+ * @param sink The sink.
+ *
+ * @return SR_OK upon success, SR_ERR_ARG if sink was NULL, or the error
+ *         returned by the callback.
+ *
+ * @since 0.3.0
+ */
+SR_API int sr_output_sink_flush(struct sr_output_sink *sink)
+{
+	int ret;
+
+	if (!sink)
+		return SR_ERR_ARG;
+	if (!sink->cb || sink->buf->len == 0)
+		return SR_OK;
+
+	ret = sink->cb((const uint8_t *)sink->buf->str, sink->buf->len,
+		       sink->cb_data);
+	g_string_truncate(sink->buf, 0);
+
+	return ret;
+}
+
+/**
+ * Free an output sink, along with its buffer. Buffered output which was
+ * not flushed is lost.
+ *
+ * Sinks created by sr_output_sink_new() or sr_output_sink_fd_new() must
+ * be freed by the caller with this function.
+ *
+ * @param sink The sink. If NULL, nothing is done.
+ *
+ * @since 0.3.0
+ */
+SR_API void sr_output_sink_free(struct sr_output_sink *sink)
+{
+	if (!sink)
+		return;
+
+	g_string_free(sink->buf, TRUE);
+	g_free(sink);
+}
+
+/* Add module output to the sink, bypassing the buffer if possible. */
+static int sink_put(struct sr_output_sink *sink, const uint8_t *buf,
+		uint64_t len)
+{
+	int ret;
+
+	if (!buf || len == 0)
+		return SR_OK;
+
+	if (sink->cb && len >= SINK_FLUSH_SIZE) {
+		if ((ret = sr_output_sink_flush(sink)) != SR_OK)
+			return ret;
+		return sink->cb(buf, len, sink->cb_data);
+	}
+
+	g_string_append_len(sink->buf, (const char *)buf, len);
+
+	return SR_OK;
+}
+
+/* Feed a packet to a module implementing the data() and event() calls. */
+static int send_legacy(struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink)
+{
+	const struct sr_datafeed_logic *logic;
+	const uint8_t *borrowed;
+	uint8_t *out;
+	uint64_t outlen;
+	int ret;
+
+	out = NULL;
+	outlen = 0;
+	switch (packet->type) {
+	case SR_DF_LOGIC:
+		if (o->format->df_type != SR_DF_LOGIC)
+			return SR_OK;
+		logic = packet->payload;
+		if (logic->length == 0)
+			return SR_OK;
+		if (o->format->data_borrow) {
+			ret = o->format->data_borrow(o, logic->data,
+					logic->length, &borrowed, &outlen);
+			if (ret == SR_OK)
+				ret = sink_put(sink, borrowed, outlen);
+			return ret;
+		}
+		if (!o->format->data)
+			return SR_OK;
+		ret = o->format->data(o, logic->data, logic->length,
+				      &out, &outlen);
+		break;
+	case SR_DF_TRIGGER:
+	case SR_DF_END:
+		if (!o->format->event)
+			return SR_OK;
+		ret = o->format->event(o, packet->type, &out, &outlen);
+		break;
+	default:
+		return SR_OK;
+	}
+
+	if (ret == SR_OK)
+		ret = sink_put(sink, out, outlen);
+	g_free(out);
+
+	return ret;
+}
+
+/**
+ * Feed a datafeed packet to an output module, and hand its output to
+ * a sink.
+ *
+ * This works with every output module, whichever of its calls it
+ * implements. For sinks with a write callback, output is buffered and
+ * written in large blocks. All of it has been written once the
+ * SR_DF_END packet has been sent.
+ *
+ * @param o The output instance, already initialized by the frontend.
+ * @param packet The packet.
+ * @param sink The sink receiving the output.
+ *
+ * @return SR_OK upon success, a negative error code otherwise.
+ *
+ * @since 0.3.0
+ */
+SR_API int sr_output_send(struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink)
+{
+	GString *out;
+	gsize pos;
+	int ret;
+
+	if (!o || !o->format || !packet || !sink)
+		return SR_ERR_ARG;
+
+	if (o->format->receive_append) {
+		pos = sink->buf->len;
+		ret = o->format->receive_append(o, o->sdi, packet, sink->buf);
+		/* Don't pass on output of a failed call with the next packet. */
+		if (ret != SR_OK)
+			g_string_truncate(sink->buf, pos);
+	} else if (o->format->receive) {
+		out = NULL;
+		ret = o->format->receive(o, o->sdi, packet, &out);
+		if (out) {
+			if (ret == SR_OK)
+				g_string_append_len(sink->buf, out->str, out->len);
+			g_string_free(out, TRUE);
+		}
+	} else {
+		ret = send_legacy(o, packet, sink);
+	}
+	if (ret != SR_OK)
+		return ret;
+
+	if (sink->cb && (sink->buf->len >= SINK_FLUSH_SIZE
+			|| packet->type == SR_DF_END))
+		ret = sr_output_sink_flush(sink);
+
+	return ret;
+}
+
+/**
+ * Implementation of receive() for modules implementing receive_append(),
+ * for frontends still using receive().
+ *
+ * @private
+ */
+SR_PRIV int sr_output_receive_compat(struct sr_output *o,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, GString **out)
+{
+	int ret;
+
+	*out = NULL;
+	if (!o || !o->format || !o->format->receive_append)
+		return SR_ERR_ARG;
+
+	*out = g_string_new(NULL);
+	ret = o->format->receive_append(o, sdi, packet, *out);
+	if (ret != SR_OK || (*out)->len == 0) {
+		g_string_free(*out, TRUE);
+		*out = NULL;
+	}
+
+	return ret;
+}
+
+/**
+ * Write the decimal representation of a value, without going through
+ * printf. At most 20 characters are written, no terminating NUL.
+ *
+ * @param p Where to write the digits.
+ * @param value The value.
+ *
+ * @return Pointer just past the last digit written.
+ *
+ * @private
+ */
+SR_PRIV char *sr_output_put_decimal(char *p, uint64_t value)
+{
+	char digits[20];
+	int n;
+
+	n = 0;
+	do {
+		digits[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value);
+	while (n > 0)
+		*p++ = digits[--n];
+
+	return p;
+}
+
+/**
+ * Prepare for checking the samples of a logic packet for changes.
+ *
+ * The state must be zeroed before the first packet. If the unitsize
+ * changed since the previous packet, the first sample is always taken
+ * as changed.
+ *
+ * @param ch The changes state of the output module.
+ * @param unitsize Unitsize of the packet's samples.
+ * @param prev Set to the sample to compare the first one against, to be
+ *             passed to sr_output_changes_check().
+ *
+ * @return SR_OK upon success, SR_ERR_MALLOC upon memory allocation errors.
+ *
+ * @private
+ */
+SR_PRIV int sr_output_changes_begin(struct sr_output_changes *ch,
+		unsigned int unitsize, const uint8_t **prev)
+{
+	if (unitsize != ch->unitsize) {
+		g_free(ch->prevsample);
+		if (!(ch->prevsample = g_try_malloc(unitsize))) {
+			sr_err("%s: prevsample malloc failed", __func__);
+			ch->unitsize = 0;
+			return SR_ERR_MALLOC;
+		}
+		ch->unitsize = unitsize;
+		*prev = NULL;
+	} else {
+		*prev = ch->num_samples ? ch->prevsample : NULL;
+	}
+
+	return SR_OK;
+}
+
+/**
+ * Check whether a sample differs from the one before it. Whole samples
+ * are compared. A changed sample is recorded as written.
+ *
+ * @param ch The changes state of the output module.
+ * @param prev The previous sample, updated to this one.
+ * @param sample The sample.
+ * @param offset Offset of the sample in the current packet, in samples.
+ *
+ * @return TRUE if the sample should be written, FALSE otherwise.
+ *
+ * @private
+ */
+SR_PRIV gboolean sr_output_changes_check(struct sr_output_changes *ch,
+		const uint8_t **prev, const uint8_t *sample, uint64_t offset)
+{
+	gboolean changed;
+
+	changed = !*prev || memcmp(sample, *prev, ch->unitsize);
+	*prev = sample;
+	if (changed)
+		ch->last_written = ch->num_samples + offset;
+
+	return changed;
+}
+
+/**
+ * Finish a logic packet.
+ *
+ * @param ch The changes state of the output module.
+ * @param prev The last sample of the packet, or NULL if the samples were
+ *             not checked for changes.
+ * @param num_samples Number of samples in the packet.
+ *
+ * @private
+ */
+SR_PRIV void sr_output_changes_end(struct sr_output_changes *ch,
+		const uint8_t *prev, uint64_t num_samples)
+{
+	if (prev)
+		memcpy(ch->prevsample, prev, ch->unitsize);
+	ch->num_samples += num_samples;
+}
+
+/**
+ * Get the last sample, if it has to be written at the end of the feed.
+ * It is repeated so the capture length is kept, and is then recorded
+ * as written.
+ *
+ * @param ch The changes state of the output module.
+ * @param index Set to the index of the last sample.
+ *
+ * @return The last sample, or NULL if it need not be written.
+ *
+ * @private
+ */
+SR_PRIV const uint8_t *sr_output_changes_last(struct sr_output_changes *ch,
+		uint64_t *index)
+{
+	if (ch->num_samples == 0 || !ch->prevsample
+			|| ch->last_written == ch->num_samples - 1)
+		return NULL;
+
+	ch->last_written = ch->num_samples - 1;
+	*index = ch->last_written;
+
+	return ch->prevsample;
+}
+
+/**
+ * Free the memory held by the changes state.
+ *
+ * @param ch The changes state of the output module.
+ *
+ * @private
+ */
+SR_PRIV void sr_output_changes_free(struct sr_output_changes *ch)
+{
+	g_free(ch->prevsample);
+	ch->prevsample = NULL;
+	ch->unitsize = 0;
+}
+
 /** @} */
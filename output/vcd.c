@@ -147,8 +147,8 @@ static int init(struct sr_output *o)
 	return SR_OK;
 }
 
-static int receive(struct sr_output *o, const struct sr_dev_inst *sdi,
-		const struct sr_datafeed_packet *packet, GString **out)
+static int receive_append(struct sr_output *o, const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, GString *out)
 {
 	const struct sr_datafeed_logic *logic;
 	struct context *ctx;
@@ -159,23 +159,21 @@ static int receive(struct sr_output *o, const struct sr_dev_inst *sdi,
 
 	(void)sdi;
 
-	*out = NULL;
 	if (!o || !o->internal)
 		return SR_ERR_ARG;
 	ctx = o->internal;
 
 	if (packet->type == SR_DF_END) {
-		*out = g_string_new("$dumpoff\n$end\n");
+		g_string_append(out, "$dumpoff\n$end\n");
 		return SR_OK;
 	} else if (packet->type != SR_DF_LOGIC)
 		return SR_OK;
 
 	if (ctx->header) {
 		/* The header is still here, this must be the first packet. */
-		*out = ctx->header;
+		g_string_append_len(out, ctx->header->str, ctx->header->len);
+		g_string_free(ctx->header, TRUE);
 		ctx->header = NULL;
-	} else {
-		*out = g_string_sized_new(512);
 	}
 
 	logic = packet->payload;
@@ -194,7 +192,7 @@ static int receive(struct sr_output *o, const struct sr_dev_inst *sdi,
 				continue;
 
 			/* Output which signal changed to which value. */
-			g_string_append_printf(*out, "#%" PRIu64 "\n%i%c\n",
+			g_string_append_printf(out, "#%" PRIu64 "\n%i%c\n",
 					(uint64_t)(((float)samplecount / ctx->samplerate)
 					* ctx->period), curbit, (char)('!' + p));
 		}
@@ -223,6 +221,7 @@ struct sr_output_format output_vcd = {
 	.description = "Value Change Dump (VCD)",
 	.df_type = SR_DF_LOGIC,
 	.init = init,
-	.receive = receive,
+	.receive = sr_output_receive_compat,
+	.receive_append = receive_append,
 	.cleanup = cleanup,
 };
@@ -30,6 +30,7 @@
 
 SR_API int sr_init(struct sr_context **ctx);
 SR_API int sr_exit(struct sr_context *ctx);
+SR_API int sr_usb_event_thread_set(struct sr_context *ctx, gboolean enable);
 
 /*--- log.c -----------------------------------------------------------------*/
 
@@ -40,6 +41,10 @@ SR_API int sr_log_loglevel_set(int loglevel);
 SR_API int sr_log_loglevel_get(void);
 SR_API int sr_log_callback_set(sr_log_callback_t cb, void *cb_data);
 SR_API int sr_log_callback_set_default(void);
+SR_API int sr_trace_enable(unsigned int num_entries);
+SR_API int sr_trace_add(uint32_t event, uint32_t arg1, uint64_t arg2);
+SR_API int sr_trace_get(struct sr_trace_entry **entries,
+		unsigned int *num_entries);
 SR_API int sr_log_logdomain_set(const char *logdomain);
 SR_API char *sr_log_logdomain_get(void);
 
@@ -56,6 +61,8 @@ SR_API GSList *sr_dev_list(const struct sr_dev_driver *driver);
 SR_API int sr_dev_clear(const struct sr_dev_driver *driver);
 SR_API int sr_dev_open(struct sr_dev_inst *sdi);
 SR_API int sr_dev_close(struct sr_dev_inst *sdi);
+SR_API int sr_dev_stats_get(const struct sr_dev_inst *sdi,
+		struct sr_acq_stats *stats);
 
 /*--- filter.c --------------------------------------------------------------*/
 
@@ -70,6 +77,8 @@ SR_API struct sr_dev_driver **sr_driver_list(void);
 SR_API int sr_driver_init(struct sr_context *ctx,
 		struct sr_dev_driver *driver);
 SR_API GSList *sr_driver_scan(struct sr_dev_driver *driver, GSList *options);
+SR_API GSList *sr_driver_scan_all(struct sr_context *ctx, GSList *options,
+		gboolean use_cache);
 SR_API int sr_config_get(const struct sr_dev_driver *driver,
 		const struct sr_dev_inst *sdi,
 		const struct sr_probe_group *probe_group,
@@ -106,12 +115,22 @@ SR_API int sr_session_datafeed_callback_add(sr_datafeed_callback_t cb,
 SR_API int sr_session_start(void);
 SR_API int sr_session_run(void);
 SR_API int sr_session_stop(void);
+SR_API int sr_session_stats_get(struct sr_acq_stats *stats);
+SR_API int sr_session_stats_interval_set(uint64_t interval_ms);
 SR_API int sr_session_save(const char *filename, const struct sr_dev_inst *sdi,
-		unsigned char *buf, int unitsize, int units);
+		unsigned char *buf, int unitsize, uint64_t units);
 SR_API int sr_session_save_init(const char *filename, uint64_t samplerate,
 		char **probes);
 SR_API int sr_session_append(const char *filename, unsigned char *buf,
-		int unitsize, int units);
+		int unitsize, uint64_t units);
+SR_API struct sr_session_save_stream *sr_session_save_stream_new(
+		const char *filename, uint64_t chunk_size);
+SR_API int sr_session_save_stream_analog_format(
+		struct sr_session_save_stream *stream, const char *probe_name,
+		int format, float scale, float offset);
+SR_API void sr_session_save_stream_feed(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data);
+SR_API int sr_session_save_stream_free(struct sr_session_save_stream *stream);
 SR_API int sr_session_source_add(int fd, int events, int timeout,
 		sr_receive_data_callback_t cb, void *cb_data);
 SR_API int sr_session_source_add_pollfd(GPollFD *pollfd, int timeout,
@@ -128,7 +147,19 @@ SR_API struct sr_input_format **sr_input_list(void);
 
 /*--- output/output.c -------------------------------------------------------*/
 
+typedef int (*sr_output_write_callback_t)(const uint8_t *buf, size_t len,
+		void *cb_data);
+
 SR_API struct sr_output_format **sr_output_list(void);
+SR_API struct sr_output_sink *sr_output_sink_new(sr_output_write_callback_t cb,
+		void *cb_data);
+SR_API struct sr_output_sink *sr_output_sink_fd_new(int fd);
+SR_API GString *sr_output_sink_buffer(struct sr_output_sink *sink);
+SR_API int sr_output_sink_flush(struct sr_output_sink *sink);
+SR_API void sr_output_sink_free(struct sr_output_sink *sink);
+SR_API int sr_output_send(struct sr_output *o,
+		const struct sr_datafeed_packet *packet,
+		struct sr_output_sink *sink);
 
 /*--- strutil.c -------------------------------------------------------------*/
 
@@ -21,9 +21,14 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <stddef.h>
+#include <errno.h>
 #include <glib.h>
 #include "libsigrok.h"
 #include "libsigrok-internal.h"
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 
 #define LOG_PREFIX "session"
 
@@ -50,8 +55,27 @@ struct source {
 	 * being polled and will be used to match the source when removing it again.
 	 */
 	gintptr poll_object;
+
+	/* Index in session->sources and session->pollfds. */
+	unsigned int index;
+	/* Index in the session->timeouts heap, -1 without a timeout. */
+	int heap_index;
+	/* Monotonic time at which the timeout expires. */
+	int64_t due;
+	/* Next source with the same poll object, in order of addition. */
+	struct source *same_object;
+	/* The fd registered with session->epoll_fd for this source, or -1. */
+	int epoll_registered;
+
+	/* Dispatch state for the current iteration. */
+	gboolean ready;
+	int revents;
+	gboolean removed;
 };
 
+/* Number of epoll events handled per session iteration. */
+#define MAX_EPOLL_EVENTS	32
+
 struct datafeed_callback {
 	sr_datafeed_callback_t cb;
 	void *cb_data;
@@ -77,11 +101,20 @@ SR_API struct sr_session *sr_session_new(void)
 		return NULL;
 	}
 
-	session->source_timeout = -1;
 	session->running = FALSE;
 	session->abort_session = FALSE;
 	g_mutex_init(&session->stop_mutex);
 
+	session->poll_objects = g_hash_table_new(g_direct_hash, g_direct_equal);
+	session->stats_due = g_hash_table_new_full(g_direct_hash,
+			g_direct_equal, NULL, g_free);
+#ifdef HAVE_SYS_EPOLL_H
+	if ((session->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		sr_dbg("epoll unavailable (%s), using poll.", strerror(errno));
+#else
+	session->epoll_fd = -1;
+#endif
+
 	return session;
 }
 
@@ -94,6 +127,8 @@ SR_API struct sr_session *sr_session_new(void)
  */
 SR_API int sr_session_destroy(void)
 {
+	unsigned int i;
+
 	if (!session) {
 		sr_err("%s: session was NULL", __func__);
 		return SR_ERR_BUG;
@@ -105,6 +140,19 @@ SR_API int sr_session_destroy(void)
 
 	g_mutex_clear(&session->stop_mutex);
 
+	for (i = 0; i < session->num_sources; i++)
+		g_free(session->sources[i]);
+	g_free(session->sources);
+	g_free(session->pollfds);
+	g_free(session->timeouts);
+	g_free(session->ready);
+	g_hash_table_destroy(session->poll_objects);
+	g_hash_table_destroy(session->stats_due);
+#ifdef HAVE_SYS_EPOLL_H
+	if (session->epoll_fd >= 0)
+		close(session->epoll_fd);
+#endif
+
 	g_free(session);
 	session = NULL;
 
@@ -268,6 +316,148 @@ SR_API int sr_session_datafeed_callback_add(sr_datafeed_callback_t cb, void *cb_
 	return SR_OK;
 }
 
+static void heap_swap(unsigned int i, unsigned int j)
+{
+	struct source *tmp;
+
+	tmp = session->timeouts[i];
+	session->timeouts[i] = session->timeouts[j];
+	session->timeouts[j] = tmp;
+	session->timeouts[i]->heap_index = i;
+	session->timeouts[j]->heap_index = j;
+}
+
+static void heap_up(unsigned int i)
+{
+	unsigned int parent;
+
+	while (i > 0) {
+		parent = (i - 1) / 2;
+		if (session->timeouts[parent]->due <= session->timeouts[i]->due)
+			break;
+		heap_swap(i, parent);
+		i = parent;
+	}
+}
+
+static void heap_down(unsigned int i)
+{
+	unsigned int child, min;
+
+	while (TRUE) {
+		min = i;
+		child = 2 * i + 1;
+		if (child < session->num_timeouts && session->timeouts[child]->due
+				< session->timeouts[min]->due)
+			min = child;
+		child++;
+		if (child < session->num_timeouts && session->timeouts[child]->due
+				< session->timeouts[min]->due)
+			min = child;
+		if (min == i)
+			break;
+		heap_swap(i, min);
+		i = min;
+	}
+}
+
+static void heap_remove(struct source *s)
+{
+	unsigned int i, last;
+
+	i = s->heap_index;
+	last = --session->num_timeouts;
+	if (i != last) {
+		session->timeouts[i] = session->timeouts[last];
+		session->timeouts[i]->heap_index = i;
+		heap_up(i);
+		heap_down(session->timeouts[i]->heap_index);
+	}
+	s->heap_index = -1;
+}
+
+/* Queue a source for dispatching in the current iteration. */
+static void source_ready(struct source *s, int revents)
+{
+	if (!s->ready) {
+		s->ready = TRUE;
+		s->revents = 0;
+		session->ready[session->num_ready++] = s;
+	}
+	s->revents |= revents;
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+/* Whether another source registered the same fd number with epoll. */
+static gboolean epoll_fd_reused(const struct source *s)
+{
+	unsigned int i;
+
+	for (i = 0; i < session->num_sources; i++) {
+		if (session->sources[i] != s && session->sources[i]
+				->epoll_registered == s->epoll_registered)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+#endif
+
+static void source_remove(struct source *s)
+{
+	struct source *first, *prev;
+	gpointer key;
+	unsigned int last;
+
+	key = (gpointer)s->poll_object;
+	first = g_hash_table_lookup(session->poll_objects, key);
+	if (first == s) {
+		if (s->same_object)
+			g_hash_table_insert(session->poll_objects, key,
+					    s->same_object);
+		else
+			g_hash_table_remove(session->poll_objects, key);
+	} else {
+		for (prev = first; prev->same_object != s; prev = prev->same_object);
+		prev->same_object = s->same_object;
+	}
+
+	if (s->heap_index >= 0)
+		heap_remove(s);
+
+#ifdef HAVE_SYS_EPOLL_H
+	/*
+	 * If the driver closed the fd before removing the source, its number
+	 * may already be registered again for a newer source. Leave that
+	 * registration alone. Otherwise, the DEL fails harmlessly if the fd
+	 * was already closed.
+	 */
+	if (session->epoll_fd >= 0 && s->epoll_registered >= 0
+			&& !epoll_fd_reused(s)
+			&& epoll_ctl(session->epoll_fd, EPOLL_CTL_DEL,
+				     s->epoll_registered, NULL) < 0
+			&& errno != EBADF && errno != ENOENT)
+		sr_dbg("Failed to remove fd %d from epoll: %s.",
+		       s->epoll_registered, strerror(errno));
+#endif
+
+	/* Move the last source into the hole. */
+	last = --session->num_sources;
+	if (s->index != last) {
+		session->sources[s->index] = session->sources[last];
+		session->sources[s->index]->index = s->index;
+		session->pollfds[s->index] = session->pollfds[last];
+	}
+
+	if (session->dispatching) {
+		/* It may still be queued in session->ready. */
+		s->removed = TRUE;
+		session->dead_sources = g_slist_prepend(session->dead_sources, s);
+	} else {
+		g_free(s);
+	}
+}
+
 /**
  * Call every device in the session's callback.
  *
@@ -279,32 +469,82 @@ SR_API int sr_session_datafeed_callback_add(sr_datafeed_callback_t cb, void *cb_
  *              sources to fire an event on the file descriptors, or
  *              any of their timeouts to activate. In other words, this
  *              can be used as a select loop.
- *              If FALSE, all sources have their callback run, regardless
- *              of file descriptor or timeout status.
+ *              If FALSE, only the sources with pending events or
+ *              expired timeouts have their callback run, without waiting.
  *
  * @retval SR_OK Success.
  * @retval SR_ERR Error occured.
  */
 static int sr_session_iteration(gboolean block)
 {
+	struct source *s;
+	int64_t now, wait;
 	unsigned int i;
+	int timeout, fd;
+#ifdef HAVE_SYS_EPOLL_H
+	struct epoll_event events[MAX_EPOLL_EVENTS];
 	int ret;
+#endif
 
-	ret = g_poll(session->pollfds, session->num_sources,
-			block ? session->source_timeout : 0);
-	for (i = 0; i < session->num_sources; i++) {
-		if (session->pollfds[i].revents > 0 || (ret == 0
-			&& session->source_timeout == session->sources[i].timeout)) {
-			/*
-			 * Invoke the source's callback on an event,
-			 * or if the poll timed out and this source
-			 * asked for that timeout.
-			 */
-			if (!session->sources[i].cb(session->pollfds[i].fd,
-					session->pollfds[i].revents,
-					session->sources[i].cb_data))
-				sr_session_source_remove(session->sources[i].poll_object);
+	/* Wait until the earliest timeout at most. */
+	timeout = block ? -1 : 0;
+	if (block && session->num_timeouts > 0) {
+		wait = session->timeouts[0]->due - g_get_monotonic_time();
+		timeout = wait > 0 ? (wait + 999) / 1000 : 0;
+	}
+
+	session->num_ready = 0;
+#ifdef HAVE_SYS_EPOLL_H
+	if (session->epoll_fd >= 0) {
+		ret = epoll_wait(session->epoll_fd, events, MAX_EPOLL_EVENTS,
+				 timeout);
+		/* epoll uses the poll() event bits, as does GLib on Unix. */
+		for (i = 0; ret > 0 && i < (unsigned int)ret; i++)
+			source_ready(events[i].data.ptr, events[i].events);
+	} else
+#endif
+	{
+		g_poll(session->pollfds, session->num_sources, timeout);
+		for (i = 0; i < session->num_sources; i++) {
+			if (session->pollfds[i].revents > 0)
+				source_ready(session->sources[i],
+					     session->pollfds[i].revents);
+		}
+	}
+
+	/* Only sources whose own timeout expired are called without events. */
+	now = g_get_monotonic_time();
+	while (session->num_timeouts > 0
+			&& session->timeouts[0]->due <= now) {
+		s = session->timeouts[0];
+		source_ready(s, 0);
+		s->due = now + s->timeout * 1000;
+		heap_down(0);
+	}
+
+	session->dispatching = TRUE;
+	for (i = 0; i < session->num_ready; i++) {
+		s = session->ready[i];
+		s->ready = FALSE;
+		/* An earlier callback in this iteration may have removed it. */
+		if (s->removed)
+			continue;
+
+		/* The timeout restarts whenever the callback runs. */
+		if (s->heap_index >= 0) {
+			s->due = now + s->timeout * 1000;
+			heap_down(s->heap_index);
 		}
+
+		/*
+		 * Invoke the source's callback on an event,
+		 * or if the source's own timeout expired.
+		 */
+		fd = session->pollfds[s->index].fd;
+		sr_trace(SR_TRACE_SOURCE_DISPATCH, fd, s->revents);
+		if (!s->cb(fd, s->revents, s->cb_data) && !s->removed)
+			source_remove(s);
+
 		/*
 		 * We want to take as little time as possible to stop
 		 * the session if we have been told to do so. Therefore,
@@ -319,6 +559,10 @@ static int sr_session_iteration(gboolean block)
 		}
 		g_mutex_unlock(&session->stop_mutex);
 	}
+	session->dispatching = FALSE;
+
+	g_slist_free_full(session->dead_sources, g_free);
+	session->dead_sources = NULL;
 
 	return SR_OK;
 }
@@ -351,6 +595,15 @@ SR_API int sr_session_start(void)
 
 	sr_info("Starting.");
 
+	memset(&session->stats, 0, sizeof(struct sr_acq_stats));
+	g_hash_table_remove_all(session->stats_due);
+	for (l = session->devs; l; l = l->next) {
+		sdi = l->data;
+		memset(&sdi->stats, 0, sizeof(struct sr_acq_stats));
+		/* Starting an acquisition may change any setting. */
+		sr_config_cache_clear(sdi);
+	}
+
 	ret = SR_OK;
 	for (l = session->devs; l; l = l->next) {
 		sdi = l->data;
@@ -394,7 +647,7 @@ SR_API int sr_session_run(void)
 	if (session->num_sources == 1 && session->pollfds[0].fd == -1) {
 		/* Dummy source, freewheel over it. */
 		while (session->num_sources)
-			session->sources[0].cb(-1, 0, session->sources[0].cb_data);
+			session->sources[0]->cb(-1, 0, session->sources[0]->cb_data);
 	} else {
 		/* Real sources, use g_poll() main loop. */
 		while (session->num_sources)
@@ -515,6 +768,110 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 	}
 }
 
+static const struct {
+	const char *name;
+	size_t offset;
+} stats_fields[] = {
+	{"bytes_received", offsetof(struct sr_acq_stats, bytes_received)},
+	{"transfers_completed", offsetof(struct sr_acq_stats, transfers_completed)},
+	{"transfers_empty", offsetof(struct sr_acq_stats, transfers_empty)},
+	{"transfers_failed", offsetof(struct sr_acq_stats, transfers_failed)},
+	{"transfers_resubmitted", offsetof(struct sr_acq_stats, transfers_resubmitted)},
+	{"packets_sent", offsetof(struct sr_acq_stats, packets_sent)},
+	{"samples_delivered", offsetof(struct sr_acq_stats, samples_delivered)},
+	{"dispatch_time", offsetof(struct sr_acq_stats, dispatch_time)},
+	{"dispatch_time_max", offsetof(struct sr_acq_stats, dispatch_time_max)},
+	{"queue_high_water", offsetof(struct sr_acq_stats, queue_high_water)},
+};
+
+static void datafeed_dispatch(const struct sr_dev_inst *sdi,
+			      const struct sr_datafeed_packet *packet)
+{
+	GSList *l;
+	struct datafeed_callback *cb_struct;
+
+	if (sr_loglevel >= SR_LOG_DBG)
+		datafeed_dump(packet);
+
+	for (l = session->datafeed_callbacks; l; l = l->next) {
+		cb_struct = l->data;
+		cb_struct->cb(sdi, packet, cb_struct->cb_data);
+	}
+}
+
+/* Send a device's counters as an SR_DF_META packet. */
+static void send_stats(const struct sr_dev_inst *sdi)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_meta meta;
+	struct sr_config src;
+	GVariantBuilder b;
+	unsigned int i;
+
+	g_variant_builder_init(&b, G_VARIANT_TYPE("a{st}"));
+	for (i = 0; i < ARRAY_SIZE(stats_fields); i++)
+		g_variant_builder_add(&b, "{st}", stats_fields[i].name,
+			*(const uint64_t *)((const char *)&sdi->stats
+					    + stats_fields[i].offset));
+
+	src.key = SR_CONF_ACQ_STATS;
+	src.data = g_variant_ref_sink(g_variant_builder_end(&b));
+	meta.config = g_slist_append(NULL, &src);
+	packet.type = SR_DF_META;
+	packet.payload = &meta;
+	datafeed_dispatch(sdi, &packet);
+	g_slist_free(meta.config);
+	g_variant_unref(src.data);
+}
+
+/* Account for a packet, and send the counters if they're due. */
+static void update_stats(const struct sr_dev_inst *sdi,
+			 const struct sr_datafeed_packet *packet,
+			 int64_t start, int64_t end)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	struct sr_acq_stats *stats[2];
+	uint64_t samples;
+	int64_t *due;
+	int i;
+
+	samples = 0;
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		samples = logic->length / logic->unitsize;
+	} else if (packet->type == SR_DF_ANALOG) {
+		analog = packet->payload;
+		samples = analog->num_samples;
+	}
+	sr_trace(SR_TRACE_SESSION_SEND, packet->type, samples);
+
+	/* The counters are not part of the device's configuration. */
+	stats[0] = (struct sr_acq_stats *)&sdi->stats;
+	stats[1] = &session->stats;
+	for (i = 0; i < 2; i++) {
+		stats[i]->packets_sent++;
+		stats[i]->samples_delivered += samples;
+		stats[i]->dispatch_time += end - start;
+		if ((uint64_t)(end - start) > stats[i]->dispatch_time_max)
+			stats[i]->dispatch_time_max = end - start;
+	}
+
+	/* Only sample packets can trigger this, never the header. */
+	if (!session->stats_interval || !samples)
+		return;
+
+	if (!(due = g_hash_table_lookup(session->stats_due, sdi))) {
+		if (!(due = g_try_malloc(sizeof(int64_t))))
+			return;
+		*due = end + session->stats_interval;
+		g_hash_table_insert(session->stats_due, (gpointer)sdi, due);
+	} else if (end >= *due) {
+		send_stats(sdi);
+		*due = end + session->stats_interval;
+	}
+}
+
 /**
  * Send a packet to whatever is listening on the datafeed bus.
  *
@@ -531,8 +888,7 @@ static void datafeed_dump(const struct sr_datafeed_packet *packet)
 SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 			    const struct sr_datafeed_packet *packet)
 {
-	GSList *l;
-	struct datafeed_callback *cb_struct;
+	int64_t start;
 
 	if (!sdi) {
 		sr_err("%s: sdi was NULL", __func__);
@@ -544,16 +900,123 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 		return SR_ERR_ARG;
 	}
 
-	for (l = session->datafeed_callbacks; l; l = l->next) {
-		if (sr_log_loglevel_get() >= SR_LOG_DBG)
-			datafeed_dump(packet);
-		cb_struct = l->data;
-		cb_struct->cb(sdi, packet, cb_struct->cb_data);
+	start = g_get_monotonic_time();
+	datafeed_dispatch(sdi, packet);
+	update_stats(sdi, packet, start, g_get_monotonic_time());
+
+	return SR_OK;
+}
+
+/**
+ * Record how many completed USB transfers were waiting for the session
+ * thread, for the queue_high_water counter.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_stats_queue_depth(unsigned int depth)
+{
+	if (session && depth > session->stats.queue_high_water)
+		session->stats.queue_high_water = depth;
+}
+
+/**
+ * Get the acquisition counters of the current session.
+ *
+ * The counters are summed over all devices in the session, and reset
+ * when the session is started. While the session is running in another
+ * thread, the values are a snapshot which may be slightly inconsistent.
+ *
+ * @param stats Where to store the counters. Must not be NULL.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_ARG Invalid argument.
+ * @retval SR_ERR_BUG No session exists.
+ *
+ * @since 0.3.0
+ */
+SR_API int sr_session_stats_get(struct sr_acq_stats *stats)
+{
+	const struct sr_dev_inst *sdi;
+	GSList *l;
+
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	if (!stats)
+		return SR_ERR_ARG;
+
+	/* Bus counters are kept per session, driver counters per device. */
+	*stats = session->stats;
+	for (l = session->devs; l; l = l->next) {
+		sdi = l->data;
+		stats->bytes_received += sdi->stats.bytes_received;
+		stats->transfers_completed += sdi->stats.transfers_completed;
+		stats->transfers_empty += sdi->stats.transfers_empty;
+		stats->transfers_failed += sdi->stats.transfers_failed;
+		stats->transfers_resubmitted += sdi->stats.transfers_resubmitted;
 	}
 
 	return SR_OK;
 }
 
+/**
+ * Periodically send each device's acquisition counters on the datafeed bus.
+ *
+ * While a device is sending samples, an SR_DF_META packet with an
+ * SR_CONF_ACQ_STATS entry is sent for it at most every interval_ms.
+ *
+ * @param interval_ms The interval in milliseconds, 0 to disable.
+ *
+ * @retval SR_OK Success.
+ * @retval SR_ERR_BUG No session exists.
+ *
+ * @since 0.3.0
+ */
+SR_API int sr_session_stats_interval_set(uint64_t interval_ms)
+{
+	if (!session) {
+		sr_err("%s: session was NULL", __func__);
+		return SR_ERR_BUG;
+	}
+
+	session->stats_interval = interval_ms * 1000;
+	g_hash_table_remove_all(session->stats_due);
+
+	return SR_OK;
+}
+
+/* Make room for more sources, doubling the size of the arrays. */
+static int sources_grow(void)
+{
+	unsigned int size;
+	void *p;
+
+	size = session->sources_size ? session->sources_size * 2 : 16;
+
+	if (!(p = g_try_realloc(session->sources, size * sizeof(struct source *))))
+		goto err;
+	session->sources = p;
+	if (!(p = g_try_realloc(session->pollfds, size * sizeof(GPollFD))))
+		goto err;
+	session->pollfds = p;
+	if (!(p = g_try_realloc(session->timeouts, size * sizeof(struct source *))))
+		goto err;
+	session->timeouts = p;
+	if (!(p = g_try_realloc(session->ready, size * sizeof(struct source *))))
+		goto err;
+	session->ready = p;
+
+	session->sources_size = size;
+
+	return SR_OK;
+
+err:
+	sr_err("%s: sources malloc failed", __func__);
+	return SR_ERR_MALLOC;
+}
+
 /**
  * Add an event source for a file descriptor.
  *
@@ -571,8 +1034,11 @@ SR_PRIV int sr_session_send(const struct sr_dev_inst *sdi,
 static int _sr_session_source_add(GPollFD *pollfd, int timeout,
 	sr_receive_data_callback_t cb, void *cb_data, gintptr poll_object)
 {
-	struct source *new_sources, *s;
-	GPollFD *new_pollfds;
+	struct source *s, *first;
+	gpointer key;
+#ifdef HAVE_SYS_EPOLL_H
+	struct epoll_event ev;
+#endif
 
 	if (!cb) {
 		sr_err("%s: cb was NULL", __func__);
@@ -581,32 +1047,57 @@ static int _sr_session_source_add(GPollFD *pollfd, int timeout,
 
 	/* Note: cb_data can be NULL, that's not a bug. */
 
-	new_pollfds = g_try_realloc(session->pollfds,
-			sizeof(GPollFD) * (session->num_sources + 1));
-	if (!new_pollfds) {
-		sr_err("%s: new_pollfds malloc failed", __func__);
+	if (session->num_sources == session->sources_size
+			&& sources_grow() != SR_OK)
 		return SR_ERR_MALLOC;
-	}
 
-	new_sources = g_try_realloc(session->sources, sizeof(struct source) *
-			(session->num_sources + 1));
-	if (!new_sources) {
-		sr_err("%s: new_sources malloc failed", __func__);
+	if (!(s = g_try_malloc0(sizeof(struct source)))) {
+		sr_err("%s: source malloc failed", __func__);
 		return SR_ERR_MALLOC;
 	}
-
-	new_pollfds[session->num_sources] = *pollfd;
-	s = &new_sources[session->num_sources++];
 	s->timeout = timeout;
 	s->cb = cb;
 	s->cb_data = cb_data;
 	s->poll_object = poll_object;
-	session->pollfds = new_pollfds;
-	session->sources = new_sources;
+	s->epoll_registered = -1;
+	s->index = session->num_sources++;
+	session->sources[s->index] = s;
+	session->pollfds[s->index] = *pollfd;
+	session->pollfds[s->index].revents = 0;
+
+	key = (gpointer)poll_object;
+	if ((first = g_hash_table_lookup(session->poll_objects, key))) {
+		while (first->same_object)
+			first = first->same_object;
+		first->same_object = s;
+	} else {
+		g_hash_table_insert(session->poll_objects, key, s);
+	}
 
-	if (timeout != session->source_timeout && timeout > 0
-	    && (session->source_timeout == -1 || timeout < session->source_timeout))
-		session->source_timeout = timeout;
+	s->heap_index = -1;
+	if (timeout > 0) {
+		s->due = g_get_monotonic_time() + timeout * 1000;
+		s->heap_index = session->num_timeouts++;
+		session->timeouts[s->heap_index] = s;
+		heap_up(s->heap_index);
+	}
+
+#ifdef HAVE_SYS_EPOLL_H
+	if (session->epoll_fd >= 0 && pollfd->fd >= 0) {
+		ev.events = pollfd->events;
+		ev.data.ptr = s;
+		if (epoll_ctl(session->epoll_fd, EPOLL_CTL_ADD,
+			      pollfd->fd, &ev) < 0) {
+			/* E.g. the same fd twice, or a regular file. */
+			sr_dbg("Can't use epoll for fd %d (%s), using poll.",
+			       pollfd->fd, strerror(errno));
+			close(session->epoll_fd);
+			session->epoll_fd = -1;
+		} else {
+			s->epoll_registered = pollfd->fd;
+		}
+	}
+#endif
 
 	return SR_OK;
 }
@@ -696,47 +1187,19 @@ SR_API int sr_session_source_add_channel(GIOChannel *channel, int events,
  */
 static int _sr_session_source_remove(gintptr poll_object)
 {
-	struct source *new_sources;
-	GPollFD *new_pollfds;
-	unsigned int old;
+	struct source *s;
 
 	if (!session->sources || !session->num_sources) {
 		sr_err("%s: sources was NULL", __func__);
 		return SR_ERR_BUG;
 	}
 
-	for (old = 0; old < session->num_sources; old++) {
-		if (session->sources[old].poll_object == poll_object)
-			break;
-	}
-
 	/* fd not found, nothing to do */
-	if (old == session->num_sources)
+	if (!(s = g_hash_table_lookup(session->poll_objects,
+				      (gpointer)poll_object)))
 		return SR_OK;
 
-	session->num_sources -= 1;
-
-	if (old != session->num_sources) {
-		memmove(&session->pollfds[old], &session->pollfds[old+1],
-			(session->num_sources - old) * sizeof(GPollFD));
-		memmove(&session->sources[old], &session->sources[old+1],
-			(session->num_sources - old) * sizeof(struct source));
-	}
-
-	new_pollfds = g_try_realloc(session->pollfds, sizeof(GPollFD) * session->num_sources);
-	if (!new_pollfds && session->num_sources > 0) {
-		sr_err("%s: new_pollfds malloc failed", __func__);
-		return SR_ERR_MALLOC;
-	}
-
-	new_sources = g_try_realloc(session->sources, sizeof(struct source) * session->num_sources);
-	if (!new_sources && session->num_sources > 0) {
-		sr_err("%s: new_sources malloc failed", __func__);
-		return SR_ERR_MALLOC;
-	}
-
-	session->pollfds = new_pollfds;
-	session->sources = new_sources;
+	source_remove(s);
 
 	return SR_OK;
 }
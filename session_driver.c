@@ -22,6 +22,7 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <string.h>
 #include <zip.h>
 #include "libsigrok.h"
 #include "libsigrok-internal.h"
@@ -33,137 +34,414 @@
 #define CHUNKSIZE (512 * 1024)
 /** @endcond */
 
+/* Number of analog samples sent per packet. */
+#define ANALOG_CHUNKSIZE (CHUNKSIZE / sizeof(float))
+
+/* One analog probe's capture files. */
+struct session_analog {
+	struct sr_probe *probe;
+	/** Capture file base name, without the chunk number. */
+	char *capturefile;
+	int format;
+	float scale;
+	float offset;
+	struct zip_file *capfile;
+	int cur_chunk;
+	gboolean done;
+	uint64_t samples_sent;
+	/** MQ, unit and flags of the current chunk. */
+	int mq;
+	int unit;
+	uint64_t mqflags;
+};
+
 struct session_vdev {
 	char *sessionfile;
 	char *capturefile;
 	struct zip *archive;
 	struct zip_file *capfile;
-	int bytes_read;
+	uint64_t bytes_read;
 	uint64_t samplerate;
 	int unitsize;
 	int num_probes;
 	int cur_chunk;
+	gboolean logic_done;
+	/** The analog probes (struct session_analog). */
+	GSList *analog;
+	/** Acquisition start in microseconds since the epoch, 0 if unknown. */
+	int64_t start_time;
 };
 
 static GSList *dev_insts = NULL;
+/* Number of devices whose acquisition is running. */
+static int num_running = 0;
 static const int hwcaps[] = {
 	SR_CONF_CAPTUREFILE,
 	SR_CONF_CAPTURE_UNITSIZE,
 	0,
 };
 
-static int receive_data(int fd, int revents, void *cb_data)
+/*
+ * Open the next chunk of a capture file, or the capture file itself if it
+ * isn't chunked. cur_chunk starts out as 0, and is -1 for an unchunked
+ * file. Returns NULL once there are no more chunks.
+ */
+static struct zip_file *open_next_chunk(struct zip *archive, const char *name,
+		int *cur_chunk)
+{
+	struct zip_stat zs;
+	struct zip_file *zf;
+	char *chunkname;
+
+	if (*cur_chunk < 0)
+		return NULL;
+
+	if (*cur_chunk == 0 && zip_stat(archive, name, 0, &zs) != -1) {
+		/* No chunks, just a single capture file. */
+		*cur_chunk = -1;
+		chunkname = g_strdup(name);
+	} else {
+		chunkname = g_strdup_printf("%s-%d", name, ++*cur_chunk);
+		if (zip_stat(archive, chunkname, 0, &zs) == -1) {
+			/* We got all the chunks. */
+			g_free(chunkname);
+			return NULL;
+		}
+	}
+
+	if ((zf = zip_fopen(archive, chunkname, 0)))
+		sr_dbg("Opened %s.", chunkname);
+	else
+		sr_err("Failed to open %s.", chunkname);
+	g_free(chunkname);
+
+	return zf;
+}
+
+/* Send the next piece of logic data. Returns FALSE once all was sent. */
+static gboolean receive_logic(struct session_vdev *vdev,
+		const struct sr_dev_inst *sdi)
 {
-	struct sr_dev_inst *sdi;
-	struct session_vdev *vdev;
 	struct sr_datafeed_packet packet;
 	struct sr_datafeed_logic logic;
-	struct zip_stat zs;
-	GSList *l;
-	int ret, got_data;
-	char capturefile[16];
+	gboolean first;
+	int ret;
 	void *buf;
 
+	if (!vdev->capfile) {
+		first = vdev->cur_chunk == 0;
+		if (!(vdev->capfile = open_next_chunk(vdev->archive,
+				vdev->capturefile, &vdev->cur_chunk))) {
+			/* Sessions with only analog data have no logic file. */
+			if (first && !vdev->analog)
+				sr_err("No capture file '%s' in "
+				       "session file '%s'.",
+				       vdev->capturefile, vdev->sessionfile);
+			vdev->logic_done = TRUE;
+			return FALSE;
+		}
+	}
+
+	if (!(buf = g_try_malloc(CHUNKSIZE))) {
+		sr_err("%s: buf malloc failed", __func__);
+		vdev->logic_done = TRUE;
+		return FALSE;
+	}
+
+	ret = zip_fread(vdev->capfile, buf, CHUNKSIZE);
+	if (ret > 0) {
+		packet.type = SR_DF_LOGIC;
+		packet.payload = &logic;
+		logic.length = ret;
+		logic.unitsize = vdev->unitsize;
+		logic.data = buf;
+		vdev->bytes_read += ret;
+		sr_session_send(sdi, &packet);
+	} else {
+		/* Done with this capture file, there might be more chunks. */
+		zip_fclose(vdev->capfile);
+		vdev->capfile = NULL;
+	}
+	g_free(buf);
+
+	return TRUE;
+}
+
+/* Send the next piece of an analog probe's data. Returns FALSE when done. */
+static gboolean receive_analog(struct session_vdev *vdev,
+		struct session_analog *sa, const struct sr_dev_inst *sdi)
+{
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	uint8_t header[SR_SESSION_ANALOG_HEADER_SIZE], *buf;
+	float *data;
+	int size, ret;
+
+	if (!sa->capfile) {
+		if (!(sa->capfile = open_next_chunk(vdev->archive,
+				sa->capturefile, &sa->cur_chunk))) {
+			sa->done = TRUE;
+			return FALSE;
+		}
+		/* Every chunk starts with the MQ, unit and flags of its data. */
+		if (zip_fread(sa->capfile, header, sizeof(header))
+				!= sizeof(header)) {
+			sr_err("Analog capture file %s is truncated.",
+			       sa->capturefile);
+			zip_fclose(sa->capfile);
+			sa->capfile = NULL;
+			return TRUE;
+		}
+		sa->mq = (int32_t)RL32(header);
+		sa->unit = (int32_t)RL32(header + 4);
+		sa->mqflags = RL32(header + 8)
+			      | (uint64_t)RL32(header + 12) << 32;
+	}
+
+	size = sr_session_analog_size(sa->format);
+	buf = g_try_malloc(ANALOG_CHUNKSIZE * size);
+	data = g_try_malloc(ANALOG_CHUNKSIZE * sizeof(float));
+	if (!buf || !data) {
+		sr_err("%s: buf malloc failed", __func__);
+		g_free(buf);
+		g_free(data);
+		sa->done = TRUE;
+		return FALSE;
+	}
+
+	ret = zip_fread(sa->capfile, buf, ANALOG_CHUNKSIZE * size);
+	if (ret >= size) {
+		sr_session_analog_decode(sa->format, sa->scale, sa->offset,
+					 buf, data, ret / size);
+		packet.type = SR_DF_ANALOG;
+		packet.payload = &analog;
+		analog.probes = g_slist_append(NULL, sa->probe);
+		analog.num_samples = ret / size;
+		analog.mq = sa->mq;
+		analog.unit = sa->unit;
+		analog.mqflags = sa->mqflags;
+		analog.data = data;
+		sa->samples_sent += analog.num_samples;
+		sr_session_send(sdi, &packet);
+		g_slist_free(analog.probes);
+	} else {
+		/* Done with this chunk, the next one might have another MQ. */
+		zip_fclose(sa->capfile);
+		sa->capfile = NULL;
+	}
+	g_free(buf);
+	g_free(data);
+
+	return TRUE;
+}
+
+static void session_analog_free(struct session_analog *sa)
+{
+	if (sa->capfile)
+		zip_fclose(sa->capfile);
+	g_free(sa->capturefile);
+	g_free(sa);
+}
+
+static void session_vdev_free(struct session_vdev *vdev)
+{
+	g_slist_free_full(vdev->analog, (GDestroyNotify)session_analog_free);
+	if (vdev->capfile)
+		zip_fclose(vdev->capfile);
+	if (vdev->archive)
+		zip_close(vdev->archive);
+	g_free(vdev->sessionfile);
+	g_free(vdev->capturefile);
+	g_free(vdev);
+}
+
+/* Done with a device, either at the end of its data or when stopped. */
+static void vdev_finish(struct sr_dev_inst *sdi)
+{
+	struct sr_datafeed_packet packet;
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	sr_session_send(sdi, &packet);
+
+	session_vdev_free(sdi->priv);
+	sdi->priv = NULL;
+
+	if (--num_running == 0)
+		sr_session_source_remove(-1);
+}
+
+/* The earliest known start time of all running devices, or 0. */
+static int64_t start_time_base(void)
+{
+	struct sr_dev_inst *sdi;
+	struct session_vdev *vdev;
+	GSList *l;
+	int64_t base;
+
+	base = 0;
+	for (l = dev_insts; l; l = l->next) {
+		sdi = l->data;
+		if (!(vdev = sdi->priv) || !vdev->archive || !vdev->start_time)
+			continue;
+		if (!base || vdev->start_time < base)
+			base = vdev->start_time;
+	}
+
+	return base;
+}
+
+/*
+ * Time of the next sample of one of a device's streams, in microseconds
+ * since base. Devices without a start time are taken to have started at
+ * base, without a samplerate at one sample per microsecond.
+ */
+static double stream_time(const struct session_vdev *vdev, int64_t base,
+		uint64_t samples)
+{
+	double t;
+
+	t = vdev->start_time ? vdev->start_time - base : 0;
+	if (vdev->samplerate)
+		t += samples * 1000000.0 / vdev->samplerate;
+	else
+		t += samples;
+
+	return t;
+}
+
+/*
+ * Every call sends one packet, from the stream of any device which lags
+ * furthest behind. That way devices with different samplerates are
+ * replayed in step, just like they were captured.
+ */
+static int receive_data(int fd, int revents, void *cb_data)
+{
+	struct sr_dev_inst *sdi, *next_sdi;
+	struct session_vdev *vdev;
+	struct session_analog *sa, *next_sa;
+	GSList *l, *la;
+	int64_t base;
+	double t, next_t;
+	gboolean active;
+
 	(void)fd;
 	(void)revents;
+	(void)cb_data;
 
-	got_data = FALSE;
+	base = start_time_base();
+	next_sdi = NULL;
+	next_sa = NULL;
+	next_t = 0;
 	for (l = dev_insts; l; l = l->next) {
 		sdi = l->data;
-		if (!(vdev = sdi->priv))
-			/* Already done with this instance. */
+		if (!(vdev = sdi->priv) || !vdev->archive)
+			/* Already done with this instance, or not running. */
 			continue;
 
-		if (!vdev->capfile) {
-			/* No capture file opened yet, or finished with the last
-			 * chunked one. */
-			if (vdev->cur_chunk == 0) {
-				/* capturefile is always the unchunked base name. */
-				if (zip_stat(vdev->archive, vdev->capturefile, 0, &zs) != -1) {
-					/* No chunks, just a single capture file. */
-					vdev->cur_chunk = 0;
-					if (!(vdev->capfile = zip_fopen(vdev->archive,
-							vdev->capturefile, 0)))
-						return FALSE;
-						sr_dbg("Opened %s.", vdev->capturefile);
-				} else {
-					/* Try as first chunk filename. */
-					snprintf(capturefile, 15, "%s-1", vdev->capturefile);
-					if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-						vdev->cur_chunk = 1;
-						if (!(vdev->capfile = zip_fopen(vdev->archive,
-								capturefile, 0)))
-							return FALSE;
-						sr_dbg("Opened %s.", capturefile);
-					} else {
-						sr_err("No capture file '%s' in " "session file '%s'.",
-								vdev->capturefile, vdev->sessionfile);
-						return FALSE;
-					}
-				}
-			} else {
-				/* Capture data is chunked, advance to the next chunk. */
-				vdev->cur_chunk++;
-				snprintf(capturefile, 15, "%s-%d", vdev->capturefile,
-						vdev->cur_chunk);
-				if (zip_stat(vdev->archive, capturefile, 0, &zs) != -1) {
-					if (!(vdev->capfile = zip_fopen(vdev->archive,
-							capturefile, 0)))
-						return FALSE;
-					sr_dbg("Opened %s.", capturefile);
-				} else {
-					/* We got all the chunks, finish up. */
-					g_free(vdev->capturefile);
-					g_free(vdev);
-					sdi->priv = NULL;
-					continue;
-				}
+		if (!vdev->logic_done) {
+			t = stream_time(vdev, base,
+					vdev->bytes_read / MAX(vdev->unitsize, 1));
+			if (!next_sdi || t < next_t) {
+				next_sdi = sdi;
+				next_sa = NULL;
+				next_t = t;
 			}
 		}
-
-		if (!(buf = g_try_malloc(CHUNKSIZE))) {
-			sr_err("%s: buf malloc failed", __func__);
-			return FALSE;
-		}
-
-		ret = zip_fread(vdev->capfile, buf, CHUNKSIZE);
-		if (ret > 0) {
-			got_data = TRUE;
-			packet.type = SR_DF_LOGIC;
-			packet.payload = &logic;
-			logic.length = ret;
-			logic.unitsize = vdev->unitsize;
-			logic.data = buf;
-			vdev->bytes_read += ret;
-			sr_session_send(cb_data, &packet);
-		} else {
-			/* done with this capture file */
-			zip_fclose(vdev->capfile);
-			vdev->capfile = NULL;
-			if (vdev->cur_chunk == 0) {
-				/* It was the only file. */
-				g_free(vdev->capturefile);
-				g_free(vdev);
-				sdi->priv = NULL;
-			} else {
-				/* There might be more chunks, so don't fall through
-				 * to the SR_DF_END here. */
-				g_free(buf);
-				return TRUE;
+		for (la = vdev->analog; la; la = la->next) {
+			sa = la->data;
+			if (sa->done)
+				continue;
+			t = stream_time(vdev, base, sa->samples_sent);
+			if (!next_sdi || t < next_t) {
+				next_sdi = sdi;
+				next_sa = sa;
+				next_t = t;
 			}
 		}
-		g_free(buf);
 	}
 
-	if (!got_data) {
-		packet.type = SR_DF_END;
-		sr_session_send(cb_data, &packet);
-		sr_session_source_remove(-1);
+	if (!next_sdi)
+		return TRUE;
+
+	vdev = next_sdi->priv;
+	if (next_sa)
+		receive_analog(vdev, next_sa, next_sdi);
+	else
+		receive_logic(vdev, next_sdi);
+
+	active = !vdev->logic_done;
+	for (la = vdev->analog; la; la = la->next) {
+		sa = la->data;
+		if (!sa->done)
+			active = TRUE;
 	}
+	if (!active)
+		vdev_finish(next_sdi);
 
 	return TRUE;
 }
 
+/**
+ * Add an analog probe to a session file device.
+ *
+ * Its data is in the capture files analog-N-num, or chunks thereof,
+ * where N is the same as in the device's logic-N capture file.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_vdev_analog_add(const struct sr_dev_inst *sdi,
+		struct sr_probe *probe, int num, int format, float scale,
+		float offset)
+{
+	struct session_vdev *vdev;
+	struct session_analog *sa;
+	const char *dev;
+
+	if (!(vdev = sdi->priv) || !vdev->capturefile)
+		return SR_ERR_BUG;
+
+	if (!sr_session_analog_size(format))
+		return SR_ERR_ARG;
+
+	if (!(sa = g_try_malloc0(sizeof(struct session_analog)))) {
+		sr_err("%s: analog probe malloc failed", __func__);
+		return SR_ERR_MALLOC;
+	}
+
+	dev = vdev->capturefile;
+	if (!strncmp(dev, "logic-", 6))
+		dev += 6;
+	sa->capturefile = g_strdup_printf("analog-%s-%d", dev, num);
+	sa->probe = probe;
+	sa->format = format;
+	sa->scale = scale;
+	sa->offset = offset;
+	vdev->analog = g_slist_append(vdev->analog, sa);
+
+	return SR_OK;
+}
+
+/**
+ * Set the time a session file device's acquisition started at, in
+ * microseconds since the epoch. Devices are replayed relative to each
+ * other according to their start times.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_vdev_start_time_set(const struct sr_dev_inst *sdi,
+		int64_t start_time)
+{
+	struct session_vdev *vdev;
+
+	if (!sdi || !(vdev = sdi->priv))
+		return SR_ERR_BUG;
+
+	vdev->start_time = start_time;
+
+	return SR_OK;
+}
+
 /* driver callbacks */
 
 static int init(struct sr_context *sr_ctx)
@@ -274,6 +552,8 @@ static int config_list(int key, GVariant **data, const struct sr_dev_inst *sdi,
 
 static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 {
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_header header;
 	struct session_vdev *vdev;
 	int ret;
 
@@ -288,11 +568,33 @@ static int dev_acquisition_start(const struct sr_dev_inst *sdi, void *cb_data)
 		return SR_ERR;
 	}
 
-	/* Send header packet to the session bus. */
-	std_session_send_df_header(cb_data, LOG_PREFIX);
+	/* Send header packet to the session bus, with the original start. */
+	packet.type = SR_DF_HEADER;
+	packet.payload = &header;
+	header.feed_version = 1;
+	if (vdev->start_time) {
+		header.starttime.tv_sec = vdev->start_time / 1000000;
+		header.starttime.tv_usec = vdev->start_time % 1000000;
+	} else {
+		gettimeofday(&header.starttime, NULL);
+	}
+	sr_session_send(cb_data, &packet);
+
+	/* One freewheeling source replays all devices. */
+	if (num_running++ == 0)
+		sr_session_source_add(-1, 0, 0, receive_data, NULL);
+
+	return SR_OK;
+}
+
+static int dev_acquisition_stop(struct sr_dev_inst *sdi, void *cb_data)
+{
+	struct session_vdev *vdev;
+
+	(void)cb_data;
 
-	/* freewheeling source */
-	sr_session_source_add(-1, 0, 0, receive_data, cb_data);
+	if ((vdev = sdi->priv) && vdev->archive)
+		vdev_finish(sdi);
 
 	return SR_OK;
 }
@@ -313,6 +615,6 @@ SR_PRIV struct sr_dev_driver session_driver = {
 	.dev_open = dev_open,
 	.dev_close = NULL,
 	.dev_acquisition_start = dev_acquisition_start,
-	.dev_acquisition_stop = NULL,
+	.dev_acquisition_stop = dev_acquisition_stop,
 	.priv = NULL,
 };
@@ -47,6 +47,14 @@
 extern struct sr_session *session;
 extern SR_PRIV struct sr_dev_driver session_driver;
 
+/* Names of the analog storage formats in the metadata. */
+static const char *analog_format_names[] = {
+	[SR_SESSION_ANALOG_FLOAT32] = "float32",
+	[SR_SESSION_ANALOG_INT8] = "int8",
+	[SR_SESSION_ANALOG_INT16] = "int16",
+	[SR_SESSION_ANALOG_INT32] = "int32",
+};
+
 /** @private */
 SR_PRIV int sr_sessionfile_check(const char *filename)
 {
@@ -95,6 +103,71 @@ SR_PRIV int sr_sessionfile_check(const char *filename)
 	return SR_OK;
 }
 
+static int analog_format_parse(const char *name)
+{
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(analog_format_names); i++) {
+		if (!strcmp(name, analog_format_names[i]))
+			return i;
+	}
+
+	return -1;
+}
+
+/* Create the analog probes of a device section, if any. */
+static int load_analog_probes(GKeyFile *kf, const char *section,
+		struct sr_dev_inst *sdi, int first_index)
+{
+	struct sr_probe *probe;
+	double scale, offset;
+	int num_analog, format, ret, k;
+	char *key, *name, *val;
+
+	num_analog = g_key_file_get_integer(kf, section, "total analog", NULL);
+	for (k = 1; k <= num_analog; k++) {
+		key = g_strdup_printf("analog%d", k);
+		name = g_key_file_get_string(kf, section, key, NULL);
+		g_free(key);
+		if (!name)
+			name = g_strdup_printf("A%d", k - 1);
+
+		key = g_strdup_printf("analog%d format", k);
+		val = g_key_file_get_string(kf, section, key, NULL);
+		g_free(key);
+		format = val ? analog_format_parse(val) : SR_SESSION_ANALOG_FLOAT32;
+		if (format < 0) {
+			sr_err("Unknown format '%s' of analog probe %s.",
+			       val, name);
+			g_free(val);
+			g_free(name);
+			return SR_ERR;
+		}
+		g_free(val);
+
+		key = g_strdup_printf("analog%d scale", k);
+		scale = g_key_file_has_key(kf, section, key, NULL)
+			? g_key_file_get_double(kf, section, key, NULL) : 1.0;
+		g_free(key);
+		key = g_strdup_printf("analog%d offset", k);
+		offset = g_key_file_get_double(kf, section, key, NULL);
+		g_free(key);
+
+		probe = sr_probe_new(first_index + k - 1, SR_PROBE_ANALOG,
+				     TRUE, name);
+		g_free(name);
+		if (!probe)
+			return SR_ERR_MALLOC;
+		sdi->probes = g_slist_append(sdi->probes, probe);
+
+		if ((ret = sr_session_vdev_analog_add(sdi, probe, k, format,
+						      scale, offset)) != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
 /**
  * Load the session from the specified filename.
  *
@@ -197,6 +270,9 @@ SR_API int sr_session_load(const char *filename)
 					tmp_u64 = strtoul(keys[j]+5, NULL, 10);
 					/* sr_session_save() */
 					sr_dev_probe_name_set(sdi, tmp_u64 - 1, val);
+				} else if (!strcmp(keys[j], "start time")) {
+					sr_session_vdev_start_time_set(sdi,
+						g_ascii_strtoll(val, NULL, 10));
 				} else if (!strncmp(keys[j], "trigger", 7)) {
 					probenum = strtoul(keys[j]+7, NULL, 10);
 					sr_dev_trigger_set(sdi, probenum, val);
@@ -207,6 +283,10 @@ SR_API int sr_session_load(const char *filename)
 			if (total_probes)
 				for (p = enabled_probes; p < total_probes; p++)
 					sr_dev_probe_enable(sdi, p, FALSE);
+			/* Analog probes come after all logic probes. */
+			if (sdi && (ret = load_analog_probes(kf, sections[i],
+					sdi, total_probes)) != SR_OK)
+				return ret;
 		}
 		devcnt++;
 	}
@@ -231,7 +311,7 @@ SR_API int sr_session_load(const char *filename)
  * @retval SR_ERR Other errors
  */
 SR_API int sr_session_save(const char *filename, const struct sr_dev_inst *sdi,
-		unsigned char *buf, int unitsize, int units)
+		unsigned char *buf, int unitsize, uint64_t units)
 {
 	struct sr_probe *probe;
 	GSList *l;
@@ -268,6 +348,35 @@ SR_API int sr_session_save(const char *filename, const struct sr_dev_inst *sdi,
 	return ret;
 }
 
+static void write_global_metadata(FILE *meta)
+{
+	fprintf(meta, "[global]\n");
+	fprintf(meta, "sigrok version = %s\n", PACKAGE_VERSION);
+}
+
+/* Write the metadata section of device num, whose data is in logic-num. */
+static void write_metadata(FILE *meta, int num, uint64_t samplerate,
+		char **probes, int unitsize)
+{
+	int cnt, i;
+	char *s;
+
+	fprintf(meta, "[device %d]\n", num);
+	fprintf(meta, "capturefile = logic-%d\n", num);
+	cnt = 0;
+	for (i = 0; probes[i]; i++)
+		cnt++;
+	fprintf(meta, "total probes = %d\n", cnt);
+	s = sr_samplerate_string(samplerate);
+	fprintf(meta, "samplerate = %s\n", s);
+	g_free(s);
+	if (unitsize > 0)
+		fprintf(meta, "unitsize = %d\n", unitsize);
+
+	for (i = 0; probes[i]; i++)
+		fprintf(meta, "probe%d = %s\n", i + 1, probes[i]);
+}
+
 /**
  * Initialize a saved session file.
  *
@@ -287,8 +396,8 @@ SR_API int sr_session_save_init(const char *filename, uint64_t samplerate,
 	FILE *meta;
 	struct zip *zipfile;
 	struct zip_source *versrc, *metasrc;
-	int tmpfile, cnt, ret, i;
-	char version[1], metafile[32], *s;
+	int tmpfile, ret;
+	char version[1], metafile[32];
 
 	if (!filename) {
 		sr_err("%s: filename was NULL", __func__);
@@ -316,25 +425,8 @@ SR_API int sr_session_save_init(const char *filename, uint64_t samplerate,
 		return SR_ERR;
 	close(tmpfile);
 	meta = g_fopen(metafile, "wb");
-	fprintf(meta, "[global]\n");
-	fprintf(meta, "sigrok version = %s\n", PACKAGE_VERSION);
-
-	/* metadata */
-	fprintf(meta, "[device 1]\n");
-
-	/* metadata */
-	fprintf(meta, "capturefile = logic-1\n");
-	cnt = 0;
-	for (i = 0; probes[i]; i++)
-		cnt++;
-	fprintf(meta, "total probes = %d\n", cnt);
-	s = sr_samplerate_string(samplerate);
-	fprintf(meta, "samplerate = %s\n", s);
-	g_free(s);
-
-	for (i = 0; probes[i]; i++)
-		fprintf(meta, "probe%d = %s\n", i + 1, probes[i]);
-
+	write_global_metadata(meta);
+	write_metadata(meta, 1, samplerate, probes, 0);
 	fclose(meta);
 
 	if (!(metasrc = zip_source_file(zipfile, metafile, 0, -1)))
@@ -368,7 +460,7 @@ SR_API int sr_session_save_init(const char *filename, uint64_t samplerate,
  * @retval SR_ERR Other errors
  */
 SR_API int sr_session_append(const char *filename, unsigned char *buf,
-		int unitsize, int units)
+		int unitsize, uint64_t units)
 {
 	struct zip *archive;
 	struct zip_source *logicsrc;
@@ -471,4 +563,880 @@ SR_API int sr_session_append(const char *filename, unsigned char *buf,
 	return SR_OK;
 }
 
+/** Default size of the capture file chunks written by a save stream. */
+#define SAVE_STREAM_CHUNK_SIZE (4 * 1024 * 1024)
+
+/* Number of analog samples converted at once while saving. */
+#define ANALOG_BUFSIZE 1024
+
+/** Storage format requested for an analog probe. */
+struct analog_format {
+	char *probe_name;
+	int format;
+	float scale;
+	float offset;
+};
+
+/** An analog probe being saved. */
+struct save_analog {
+	const struct sr_probe *probe;
+	int format;
+	float scale;
+	float offset;
+	/** Names of the temporary files holding the chunks written so far. */
+	GPtrArray *chunk_files;
+	/** The chunk currently being written, if any. */
+	FILE *chunk;
+	uint64_t chunk_bytes;
+	/** MQ, unit and flags of all samples in the current chunk. */
+	int mq;
+	int unit;
+	uint64_t mqflags;
+};
+
+/** A device whose data is being saved. */
+struct save_dev {
+	const struct sr_dev_inst *sdi;
+	uint64_t samplerate;
+	int unitsize;
+	/** Maximum size of a capture file chunk, a multiple of unitsize. */
+	uint64_t chunk_size;
+	/** Template for chunk file names, see chunk_open(). */
+	const char *chunk_template;
+	/** Number of logic samples saved so far. */
+	uint64_t num_samples;
+	/** Names of the temporary files holding the chunks written so far. */
+	GPtrArray *chunk_files;
+	/** The logic chunk currently being written, if any. */
+	FILE *chunk;
+	uint64_t chunk_bytes;
+	/** The analog probes seen so far (struct save_analog). */
+	GSList *analog;
+	/** Acquisition start in microseconds since the epoch, 0 if unknown. */
+	int64_t start_time;
+	gboolean ended;
+};
+
+struct sr_session_save_stream {
+	char *filename;
+	/** Requested maximum size of a capture file chunk. */
+	uint64_t chunk_size;
+	/** Chunk files go next to the session file: "<filename>.XXXXXX". */
+	char *chunk_template;
+	/** The devices seen so far, in order of appearance (struct save_dev). */
+	GSList *devs;
+	/** Requested analog storage formats (struct analog_format). */
+	GSList *analog_formats;
+	gboolean finished;
+	/** SR_OK, or the first error that occurred. */
+	int ret;
+};
+
+/**
+ * Return the size of a sample of an analog storage format in bytes,
+ * or 0 if the format is unknown.
+ *
+ * @private
+ */
+SR_PRIV int sr_session_analog_size(int format)
+{
+	switch (format) {
+	case SR_SESSION_ANALOG_FLOAT32:
+		return 4;
+	case SR_SESSION_ANALOG_INT8:
+		return 1;
+	case SR_SESSION_ANALOG_INT16:
+		return 2;
+	case SR_SESSION_ANALOG_INT32:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Convert little endian analog samples from a session file to floats.
+ *
+ * @private
+ */
+SR_PRIV void sr_session_analog_decode(int format, float scale, float offset,
+		const uint8_t *in, float *out, int num_samples)
+{
+	union {
+		uint32_t u;
+		float f;
+	} v;
+	int i;
+
+	switch (format) {
+	case SR_SESSION_ANALOG_FLOAT32:
+		for (i = 0; i < num_samples; i++) {
+			v.u = RL32(in + 4 * i);
+			out[i] = v.f;
+		}
+		break;
+	case SR_SESSION_ANALOG_INT8:
+		for (i = 0; i < num_samples; i++)
+			out[i] = (int8_t)in[i] * scale + offset;
+		break;
+	case SR_SESSION_ANALOG_INT16:
+		for (i = 0; i < num_samples; i++)
+			out[i] = (int16_t)RL16(in + 2 * i) * scale + offset;
+		break;
+	case SR_SESSION_ANALOG_INT32:
+		for (i = 0; i < num_samples; i++)
+			out[i] = (int32_t)RL32(in + 4 * i) * scale + offset;
+		break;
+	}
+}
+
+/* Store a value as a little endian sample, rounding and clamping integers. */
+static void analog_encode(const struct save_analog *sa, float value,
+		uint8_t *out)
+{
+	union {
+		uint32_t u;
+		float f;
+	} v;
+	double raw, max;
+	int size, i;
+
+	size = sr_session_analog_size(sa->format);
+	if (sa->format == SR_SESSION_ANALOG_FLOAT32) {
+		v.f = value;
+	} else {
+		max = (double)((1U << (8 * size - 1)) - 1);
+		raw = (value - sa->offset) / sa->scale;
+		raw = raw < 0 ? raw - 0.5 : raw + 0.5;
+		if (raw > max)
+			raw = max;
+		else if (raw < -max - 1)
+			raw = -max - 1;
+		v.u = (uint32_t)(int32_t)raw;
+	}
+
+	for (i = 0; i < size; i++)
+		out[i] = v.u >> (8 * i);
+}
+
+static void save_stream_error(struct sr_session_save_stream *stream, int ret)
+{
+	if (stream->ret == SR_OK)
+		stream->ret = ret;
+}
+
+static int chunk_close(FILE **chunk)
+{
+	int ret;
+
+	if (!*chunk)
+		return SR_OK;
+
+	ret = fclose(*chunk);
+	*chunk = NULL;
+	if (ret != 0) {
+		sr_err("Failed to write capture file chunk: %s.",
+		       strerror(errno));
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+/*
+ * Chunks are staged in the directory of the session file rather than in
+ * $TMPDIR, which is often a RAM-backed tmpfs.
+ */
+static int chunk_open(FILE **chunk, GPtrArray *chunk_files,
+		const char *chunk_template)
+{
+	char *name;
+	int fd;
+
+	name = g_strdup(chunk_template);
+	if ((fd = g_mkstemp(name)) == -1) {
+		sr_err("Failed to create capture file chunk %s: %s.",
+		       name, strerror(errno));
+		g_free(name);
+		return SR_ERR;
+	}
+	g_ptr_array_add(chunk_files, name);
+
+	if (!(*chunk = fdopen(fd, "wb"))) {
+		sr_err("Failed to open capture file chunk: %s.",
+		       strerror(errno));
+		close(fd);
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+static int chunk_write(FILE *chunk, const void *data, uint64_t len)
+{
+	if (fwrite(data, 1, len, chunk) != len) {
+		sr_err("Failed to write capture file chunk: %s.",
+		       strerror(errno));
+		return SR_ERR;
+	}
+
+	return SR_OK;
+}
+
+/* Append logic data, starting a new chunk whenever one is full. */
+static int save_dev_write(struct save_dev *dev, const uint8_t *data,
+		uint64_t len)
+{
+	uint64_t n;
+	int ret;
+
+	while (len > 0) {
+		if (!dev->chunk) {
+			if ((ret = chunk_open(&dev->chunk, dev->chunk_files,
+					      dev->chunk_template)) != SR_OK)
+				return ret;
+			dev->chunk_bytes = 0;
+		}
+
+		n = MIN(len, dev->chunk_size - dev->chunk_bytes);
+		if ((ret = chunk_write(dev->chunk, data, n)) != SR_OK)
+			return ret;
+		dev->chunk_bytes += n;
+		data += n;
+		len -= n;
+
+		if (dev->chunk_bytes == dev->chunk_size
+		    && (ret = chunk_close(&dev->chunk)) != SR_OK)
+			return ret;
+	}
+
+	return SR_OK;
+}
+
+static uint64_t get_samplerate(const struct sr_dev_inst *sdi)
+{
+	GVariant *gvar;
+	uint64_t samplerate;
+
+	samplerate = 0;
+	if (sr_dev_has_option(sdi, SR_CONF_SAMPLERATE)) {
+		if (sr_config_get(sdi->driver, sdi, NULL,
+					SR_CONF_SAMPLERATE, &gvar) == SR_OK) {
+			samplerate = g_variant_get_uint64(gvar);
+			g_variant_unref(gvar);
+		}
+	}
+
+	return samplerate;
+}
+
+static struct save_dev *save_dev_find(
+		const struct sr_session_save_stream *stream,
+		const struct sr_dev_inst *sdi)
+{
+	struct save_dev *dev;
+	GSList *l;
+
+	for (l = stream->devs; l; l = l->next) {
+		dev = l->data;
+		if (dev->sdi == sdi)
+			return dev;
+	}
+
+	return NULL;
+}
+
+/* Every device sending data gets its own streams in the session file. */
+static struct save_dev *save_dev_get(struct sr_session_save_stream *stream,
+		const struct sr_dev_inst *sdi)
+{
+	struct save_dev *dev;
+
+	if ((dev = save_dev_find(stream, sdi)))
+		return dev;
+
+	if (!(dev = g_try_malloc0(sizeof(struct save_dev)))) {
+		sr_err("%s: device malloc failed", __func__);
+		return NULL;
+	}
+	dev->sdi = sdi;
+	dev->samplerate = get_samplerate(sdi);
+	dev->chunk_size = stream->chunk_size;
+	dev->chunk_template = stream->chunk_template;
+	dev->chunk_files = g_ptr_array_new_with_free_func(g_free);
+	stream->devs = g_slist_append(stream->devs, dev);
+
+	return dev;
+}
+
+static int save_dev_logic(struct save_dev *dev,
+		const struct sr_datafeed_logic *logic)
+{
+	if (!dev->unitsize) {
+		if (logic->unitsize < 1)
+			return SR_ERR_ARG;
+		dev->unitsize = logic->unitsize;
+		/* Chunks only ever hold whole samples. */
+		dev->chunk_size -= dev->chunk_size % dev->unitsize;
+		if (dev->chunk_size == 0)
+			dev->chunk_size = dev->unitsize;
+	} else if (logic->unitsize != dev->unitsize) {
+		sr_err("Unitsize changed from %d to %d while saving.",
+		       dev->unitsize, logic->unitsize);
+		return SR_ERR;
+	}
+
+	dev->num_samples += logic->length / logic->unitsize;
+
+	return save_dev_write(dev, logic->data, logic->length);
+}
+
+static struct save_analog *save_analog_get(
+		const struct sr_session_save_stream *stream,
+		struct save_dev *dev, const struct sr_probe *probe)
+{
+	struct save_analog *sa;
+	struct analog_format *af;
+	GSList *l;
+
+	for (l = dev->analog; l; l = l->next) {
+		sa = l->data;
+		if (sa->probe == probe)
+			return sa;
+	}
+
+	if (!(sa = g_try_malloc0(sizeof(struct save_analog)))) {
+		sr_err("%s: analog probe malloc failed", __func__);
+		return NULL;
+	}
+	sa->probe = probe;
+	sa->format = SR_SESSION_ANALOG_FLOAT32;
+	sa->scale = 1.0;
+	for (l = stream->analog_formats; l; l = l->next) {
+		af = l->data;
+		if (probe->name && !strcmp(af->probe_name, probe->name)) {
+			sa->format = af->format;
+			sa->scale = af->scale;
+			sa->offset = af->offset;
+		}
+	}
+	sa->chunk_files = g_ptr_array_new_with_free_func(g_free);
+	dev->analog = g_slist_append(dev->analog, sa);
+
+	return sa;
+}
+
+/* Start an analog chunk, all of whose samples have the given MQ and unit. */
+static int save_analog_chunk_open(struct save_analog *sa,
+		const struct sr_datafeed_analog *analog, const char *chunk_template)
+{
+	uint8_t header[SR_SESSION_ANALOG_HEADER_SIZE];
+	uint64_t mqflags;
+	int ret, i;
+
+	if ((ret = chunk_open(&sa->chunk, sa->chunk_files,
+			      chunk_template)) != SR_OK)
+		return ret;
+	sa->chunk_bytes = 0;
+	sa->mq = analog->mq;
+	sa->unit = analog->unit;
+	sa->mqflags = analog->mqflags;
+
+	/* Little endian MQ, unit (32 bits each) and MQ flags (64 bits). */
+	mqflags = analog->mqflags;
+	for (i = 0; i < 4; i++) {
+		header[i] = (uint32_t)analog->mq >> (8 * i);
+		header[4 + i] = (uint32_t)analog->unit >> (8 * i);
+	}
+	for (i = 0; i < 8; i++)
+		header[8 + i] = mqflags >> (8 * i);
+
+	return chunk_write(sa->chunk, header, sizeof(header));
+}
+
+static int save_dev_analog(const struct sr_session_save_stream *stream,
+		struct save_dev *dev, const struct sr_datafeed_analog *analog)
+{
+	struct save_analog *sa;
+	GSList *l;
+	uint64_t room;
+	int num_probes, size, p, i, j, n, ret;
+	uint8_t buf[ANALOG_BUFSIZE * 4];
+
+	num_probes = g_slist_length(analog->probes);
+	for (l = analog->probes, p = 0; l; l = l->next, p++) {
+		if (!(sa = save_analog_get(stream, dev, l->data)))
+			return SR_ERR_MALLOC;
+
+		/* A new MQ or unit always starts a new chunk. */
+		if (sa->chunk && (sa->mq != analog->mq
+				  || sa->unit != analog->unit
+				  || sa->mqflags != analog->mqflags)
+		    && (ret = chunk_close(&sa->chunk)) != SR_OK)
+			return ret;
+
+		size = sr_session_analog_size(sa->format);
+		for (i = 0; i < analog->num_samples; i += n) {
+			if (!sa->chunk && (ret = save_analog_chunk_open(sa,
+					analog, dev->chunk_template)) != SR_OK)
+				return ret;
+
+			room = (dev->chunk_size - MIN(dev->chunk_size,
+					sa->chunk_bytes)) / size;
+			n = MIN(analog->num_samples - i, ANALOG_BUFSIZE);
+			n = MIN((uint64_t)n, MAX(room, 1));
+			for (j = 0; j < n; j++)
+				analog_encode(sa, analog->data[(i + j)
+						* num_probes + p], buf + j * size);
+			if ((ret = chunk_write(sa->chunk, buf,
+					       n * size)) != SR_OK)
+				return ret;
+			sa->chunk_bytes += n * size;
+
+			if (sa->chunk_bytes >= dev->chunk_size
+			    && (ret = chunk_close(&sa->chunk)) != SR_OK)
+				return ret;
+		}
+	}
+
+	return SR_OK;
+}
+
+static void write_analog_metadata(FILE *meta, const struct save_dev *dev)
+{
+	const struct save_analog *sa;
+	const GSList *l;
+	int k;
+	char s[G_ASCII_DTOSTR_BUF_SIZE];
+
+	if (!dev->analog)
+		return;
+
+	fprintf(meta, "total analog = %d\n", g_slist_length(dev->analog));
+	for (l = dev->analog, k = 1; l; l = l->next, k++) {
+		sa = l->data;
+		if (sa->probe->name)
+			fprintf(meta, "analog%d = %s\n", k, sa->probe->name);
+		fprintf(meta, "analog%d format = %s\n", k,
+			analog_format_names[sa->format]);
+		if (sa->format == SR_SESSION_ANALOG_FLOAT32)
+			continue;
+		fprintf(meta, "analog%d scale = %s\n", k,
+			g_ascii_dtostr(s, sizeof(s), sa->scale));
+		fprintf(meta, "analog%d offset = %s\n", k,
+			g_ascii_dtostr(s, sizeof(s), sa->offset));
+	}
+}
+
+static int zip_add_chunks(struct zip *zipfile, const char *name,
+		const GPtrArray *chunk_files)
+{
+	struct zip_source *src;
+	unsigned int i;
+	char *chunkname;
+	int ret;
+
+	ret = SR_OK;
+	for (i = 0; i < chunk_files->len && ret == SR_OK; i++) {
+		chunkname = g_strdup_printf("%s-%u", name, i + 1);
+		if (!(src = zip_source_file(zipfile,
+				g_ptr_array_index(chunk_files, i), 0, -1))
+		    || zip_add(zipfile, chunkname, src) == -1)
+			ret = SR_ERR;
+		g_free(chunkname);
+	}
+
+	return ret;
+}
+
+/* Devices which only sent a header have nothing worth saving. */
+static gboolean save_dev_empty(const struct save_dev *dev)
+{
+	return !dev->chunk_files->len && !dev->analog;
+}
+
+static void write_dev_metadata(FILE *meta, const struct save_dev *dev,
+		int num)
+{
+	struct sr_probe *probe;
+	GSList *l;
+	int cnt;
+	char **probe_names;
+
+	/* Only the enabled logic probes are saved, as sr_session_save() does. */
+	cnt = 0;
+	probe_names = g_malloc0(sizeof(char *)
+			* (g_slist_length(dev->sdi->probes) + 1));
+	for (l = dev->sdi->probes; l; l = l->next) {
+		probe = l->data;
+		if (probe->type == SR_PROBE_LOGIC && probe->enabled
+		    && probe->name)
+			probe_names[cnt++] = probe->name;
+	}
+
+	write_metadata(meta, num, dev->samplerate, probe_names, dev->unitsize);
+	if (dev->start_time)
+		fprintf(meta, "start time = %" PRId64 "\n", dev->start_time);
+	write_analog_metadata(meta, dev);
+	g_free(probe_names);
+}
+
+/* Put the metadata and all chunks of all devices into the session file. */
+static int save_stream_finish(struct sr_session_save_stream *stream)
+{
+	FILE *meta;
+	GError *error;
+	struct zip *zipfile;
+	struct zip_source *src;
+	struct save_dev *dev;
+	struct save_analog *sa;
+	GSList *l, *la;
+	int fd, ret, num, k;
+	char version[1], *metafile, name[32];
+
+	stream->finished = TRUE;
+	ret = SR_OK;
+	for (l = stream->devs; l; l = l->next) {
+		dev = l->data;
+		if (chunk_close(&dev->chunk) != SR_OK)
+			ret = SR_ERR;
+		for (la = dev->analog; la; la = la->next) {
+			sa = la->data;
+			if (chunk_close(&sa->chunk) != SR_OK)
+				ret = SR_ERR;
+		}
+	}
+	if (ret != SR_OK)
+		return ret;
+	if (stream->ret != SR_OK)
+		return stream->ret;
+
+	error = NULL;
+	if ((fd = g_file_open_tmp("sigrok-meta-XXXXXX", &metafile,
+				  &error)) == -1) {
+		sr_err("Failed to create metadata: %s.", error->message);
+		g_error_free(error);
+		return SR_ERR;
+	}
+	meta = fdopen(fd, "wb");
+	write_global_metadata(meta);
+	num = 0;
+	for (l = stream->devs; l; l = l->next) {
+		dev = l->data;
+		if (!save_dev_empty(dev))
+			write_dev_metadata(meta, dev, ++num);
+	}
+	fclose(meta);
+
+	/* Quietly delete it first, libzip wants replace ops otherwise. */
+	unlink(stream->filename);
+	ret = SR_ERR;
+	if (!(zipfile = zip_open(stream->filename, ZIP_CREATE, &fd)))
+		goto out;
+
+	version[0] = '1';
+	if (!(src = zip_source_buffer(zipfile, version, 1, 0))
+	    || zip_add(zipfile, "version", src) == -1)
+		goto err_zip;
+	if (!(src = zip_source_file(zipfile, metafile, 0, -1))
+	    || zip_add(zipfile, "metadata", src) == -1)
+		goto err_zip;
+
+	/* Device num's chunks are logic-num-N and analog-num-k-N. */
+	num = 0;
+	for (l = stream->devs; l; l = l->next) {
+		dev = l->data;
+		if (save_dev_empty(dev))
+			continue;
+		num++;
+		snprintf(name, sizeof(name), "logic-%d", num);
+		if (zip_add_chunks(zipfile, name, dev->chunk_files) != SR_OK)
+			goto err_zip;
+		for (la = dev->analog, k = 1; la; la = la->next, k++) {
+			sa = la->data;
+			snprintf(name, sizeof(name), "analog-%d-%d", num, k);
+			if (zip_add_chunks(zipfile, name,
+					   sa->chunk_files) != SR_OK)
+				goto err_zip;
+		}
+	}
+
+	/* This is where the chunks are actually compressed and stored. */
+	if (zip_close(zipfile) == -1) {
+		sr_err("Error saving session file: %s.", zip_strerror(zipfile));
+		goto out;
+	}
+
+	sr_dbg("Saved %d devices to %s.", num, stream->filename);
+	ret = SR_OK;
+	goto out;
+
+err_zip:
+	sr_err("Error saving session file: %s.", zip_strerror(zipfile));
+	zip_unchange_all(zipfile);
+	zip_close(zipfile);
+out:
+	g_unlink(metafile);
+	g_free(metafile);
+
+	return ret;
+}
+
+/*
+ * Whether all devices have sent SR_DF_END. These are the devices of the
+ * session, including any which have not sent anything yet. Without a
+ * session (the stream is fed by hand), only the devices seen count.
+ */
+static gboolean save_stream_ended(const struct sr_session_save_stream *stream)
+{
+	const struct save_dev *dev;
+	GSList *l;
+
+	if (session && session->devs) {
+		for (l = session->devs; l; l = l->next) {
+			if (!(dev = save_dev_find(stream, l->data))
+					|| !dev->ended)
+				return FALSE;
+		}
+		return TRUE;
+	}
+
+	for (l = stream->devs; l; l = l->next) {
+		dev = l->data;
+		if (!dev->ended)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void chunk_files_free(GPtrArray *chunk_files)
+{
+	unsigned int i;
+
+	for (i = 0; i < chunk_files->len; i++)
+		g_unlink(g_ptr_array_index(chunk_files, i));
+	g_ptr_array_free(chunk_files, TRUE);
+}
+
+static void save_analog_free(struct save_analog *sa)
+{
+	chunk_files_free(sa->chunk_files);
+	g_free(sa);
+}
+
+static void save_dev_free(struct save_dev *dev)
+{
+	chunk_files_free(dev->chunk_files);
+	g_slist_free_full(dev->analog, (GDestroyNotify)save_analog_free);
+	g_free(dev);
+}
+
+static void analog_format_free(struct analog_format *af)
+{
+	g_free(af->probe_name);
+	g_free(af);
+}
+
+/**
+ * Create a stream saving the data of a session to a session file as it
+ * arrives.
+ *
+ * Register sr_session_save_stream_feed() as a datafeed callback, with the
+ * returned stream as its cb_data. The logic and analog data of every
+ * device is written to temporary capture file chunks of at most
+ * chunk_size bytes, so a capture of any length can be saved with only a
+ * small amount of memory. The session file is written once all devices
+ * of the session have sent SR_DF_END.
+ *
+ * The chunks are staged uncompressed next to the session file, named
+ * "<filename>.XXXXXX", so its filesystem needs room for the whole
+ * uncompressed capture in addition to the session file. They are
+ * compressed into the session file at the end, and then deleted.
+ *
+ * Each device gets its own section in the session file, with its own
+ * samplerate and capture files. The start time from its SR_DF_HEADER
+ * packet is saved too, so the devices are replayed in step.
+ *
+ * Analog probes are stored as 32-bit floats, unless another format was
+ * selected with sr_session_save_stream_analog_format().
+ *
+ * @param filename The name of the session file to write. Must not be NULL.
+ * @param chunk_size The maximum size of each capture file chunk in bytes,
+ *                   or 0 for the default.
+ *
+ * @return A new stream, to be freed with sr_session_save_stream_free(), or
+ *         NULL upon errors.
+ *
+ * @since 0.3.0
+ */
+SR_API struct sr_session_save_stream *sr_session_save_stream_new(
+		const char *filename, uint64_t chunk_size)
+{
+	struct sr_session_save_stream *stream;
+
+	if (!filename) {
+		sr_err("%s: filename was NULL", __func__);
+		return NULL;
+	}
+
+	if (!(stream = g_try_malloc0(sizeof(struct sr_session_save_stream)))) {
+		sr_err("%s: stream malloc failed", __func__);
+		return NULL;
+	}
+
+	stream->filename = g_strdup(filename);
+	stream->chunk_template = g_strconcat(filename, ".XXXXXX", NULL);
+	stream->chunk_size = chunk_size ? chunk_size : SAVE_STREAM_CHUNK_SIZE;
+	stream->ret = SR_OK;
+
+	return stream;
+}
+
+/**
+ * Select how an analog probe is stored by a session save stream.
+ *
+ * Integer formats store round((value - offset) / scale), clamped to the
+ * range of the integer type. For data which comes from an ADC in the
+ * first place, such as oscilloscope traces, this is both lossless and
+ * much smaller than floats.
+ *
+ * This must be called before the first data of the probe arrives.
+ *
+ * @param stream The stream.
+ * @param probe_name The name of the analog probe.
+ * @param format SR_SESSION_ANALOG_FLOAT32, SR_SESSION_ANALOG_INT8, ...
+ * @param scale The value of one integer step. Ignored for floats.
+ * @param offset The value of integer 0. Ignored for floats.
+ *
+ * @retval SR_OK Success
+ * @retval SR_ERR_ARG Invalid arguments
+ * @retval SR_ERR_MALLOC Memory allocation error
+ *
+ * @since 0.3.0
+ */
+SR_API int sr_session_save_stream_analog_format(
+		struct sr_session_save_stream *stream, const char *probe_name,
+		int format, float scale, float offset)
+{
+	struct analog_format *af;
+
+	if (!stream || !probe_name || !sr_session_analog_size(format))
+		return SR_ERR_ARG;
+
+	if (format != SR_SESSION_ANALOG_FLOAT32 && scale == 0) {
+		sr_err("%s: scale must not be 0", __func__);
+		return SR_ERR_ARG;
+	}
+
+	if (!(af = g_try_malloc(sizeof(struct analog_format)))) {
+		sr_err("%s: analog format malloc failed", __func__);
+		return SR_ERR_MALLOC;
+	}
+	af->probe_name = g_strdup(probe_name);
+	af->format = format;
+	af->scale = scale;
+	af->offset = offset;
+	stream->analog_formats = g_slist_append(stream->analog_formats, af);
+
+	return SR_OK;
+}
+
+/**
+ * Datafeed callback saving the data to a session file.
+ *
+ * @param sdi The device instance the packet is from.
+ * @param packet The packet.
+ * @param cb_data The stream, as returned by sr_session_save_stream_new().
+ *
+ * @since 0.3.0
+ */
+SR_API void sr_session_save_stream_feed(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	struct sr_session_save_stream *stream;
+	const struct sr_datafeed_header *header;
+	const struct sr_datafeed_meta *meta;
+	const struct sr_config *src;
+	struct save_dev *dev;
+	GSList *l;
+	int ret;
+
+	if (!(stream = cb_data) || !packet || !sdi || stream->finished)
+		return;
+
+	if (!(dev = save_dev_get(stream, sdi))) {
+		save_stream_error(stream, SR_ERR_MALLOC);
+		return;
+	}
+
+	ret = SR_OK;
+	switch (packet->type) {
+	case SR_DF_HEADER:
+		header = packet->payload;
+		dev->start_time = (int64_t)header->starttime.tv_sec * 1000000
+				  + header->starttime.tv_usec;
+		break;
+	case SR_DF_META:
+		meta = packet->payload;
+		for (l = meta->config; l; l = l->next) {
+			src = l->data;
+			if (src->key == SR_CONF_SAMPLERATE)
+				dev->samplerate = g_variant_get_uint64(src->data);
+		}
+		break;
+	case SR_DF_LOGIC:
+		if (stream->ret == SR_OK)
+			ret = save_dev_logic(dev, packet->payload);
+		break;
+	case SR_DF_ANALOG:
+		if (stream->ret == SR_OK)
+			ret = save_dev_analog(stream, dev, packet->payload);
+		break;
+	case SR_DF_END:
+		dev->ended = TRUE;
+		if (save_stream_ended(stream))
+			ret = save_stream_finish(stream);
+		break;
+	}
+
+	if (ret != SR_OK)
+		save_stream_error(stream, ret);
+}
+
+/**
+ * Free a session save stream.
+ *
+ * If not all devices have sent SR_DF_END yet, whatever data arrived so
+ * far is saved now.
+ *
+ * @param stream The stream to free.
+ *
+ * @retval SR_OK The session file was saved successfully.
+ * @retval SR_ERR_ARG Invalid arguments
+ * @retval SR_ERR Saving the session file failed.
+ *
+ * @since 0.3.0
+ */
+SR_API int sr_session_save_stream_free(struct sr_session_save_stream *stream)
+{
+	int ret;
+
+	if (!stream)
+		return SR_ERR_ARG;
+
+	if (!stream->finished)
+		save_stream_error(stream, save_stream_finish(stream));
+	ret = stream->ret;
+
+	g_slist_free_full(stream->devs, (GDestroyNotify)save_dev_free);
+	g_slist_free_full(stream->analog_formats,
+			  (GDestroyNotify)analog_format_free);
+	g_free(stream->filename);
+	g_free(stream->chunk_template);
+	g_free(stream);
+
+	return ret;
+}
+
 /** @} */
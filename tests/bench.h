@@ -0,0 +1,58 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef LIBSIGROK_TESTS_BENCH_H
+#define LIBSIGROK_TESTS_BENCH_H
+
+#include <stdint.h>
+#include <glib.h>
+#include "../libsigrok.h"
+
+/* Each benchmark runs at least this long (in us) and this many times. */
+#define SRBENCH_MIN_USEC	(500 * 1000)
+#define SRBENCH_MIN_RUNS	3
+
+/* Buffers fed to consumers are split into chunks of this size. */
+#define SRBENCH_CHUNKSIZE	(64 * 1024)
+#define SRBENCH_NUM_CHUNKS	16
+#define SRBENCH_BUFSIZE		(SRBENCH_CHUNKSIZE * SRBENCH_NUM_CHUNKS)
+
+#define SRBENCH_SAMPLERATE	SR_MHZ(1)
+
+/*
+ * A single benchmark iteration. It adds the number of bytes and samples
+ * it processed to *bytes and *samples, and returns SR_OK on success.
+ */
+typedef int (*srbench_func_t)(void *data, uint64_t *bytes, uint64_t *samples);
+
+void srbench_set_filter(const char *filter);
+void srbench_run(const char *name, srbench_func_t func, void *data);
+
+uint8_t *srbench_logic_buf(uint64_t len);
+float *srbench_analog_buf(uint64_t num_samples);
+struct sr_dev_inst *srbench_demo_dev(struct sr_context *sr_ctx,
+		int num_analog_probes);
+char *srbench_tmpfile(const char *suffix);
+
+void srbench_core(struct sr_context *sr_ctx);
+void srbench_output(struct sr_context *sr_ctx);
+void srbench_input(struct sr_context *sr_ctx);
+void srbench_session(struct sr_context *sr_ctx);
+void srbench_driver(struct sr_context *sr_ctx);
+
+#endif
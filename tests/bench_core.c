@@ -0,0 +1,84 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <glib.h>
+#include "../libsigrok.h"
+#include "bench.h"
+
+struct filter_bench {
+	unsigned int in_unitsize;
+	unsigned int out_unitsize;
+	GArray *probes;
+	uint8_t *buf;
+};
+
+static int bench_filter_probes(void *data, uint64_t *bytes, uint64_t *samples)
+{
+	struct filter_bench *fb;
+	uint8_t *out;
+	uint64_t outlen;
+	int ret;
+
+	fb = data;
+	ret = sr_filter_probes(fb->in_unitsize, fb->out_unitsize, fb->probes,
+			       fb->buf, SRBENCH_BUFSIZE, &out, &outlen);
+	if (ret != SR_OK)
+		return ret;
+	g_free(out);
+
+	*bytes += SRBENCH_BUFSIZE;
+	*samples += SRBENCH_BUFSIZE / fb->in_unitsize;
+
+	return SR_OK;
+}
+
+static void run_filter(const char *name, unsigned int in_unitsize,
+		       unsigned int out_unitsize, int num_probes, int step,
+		       uint8_t *buf)
+{
+	struct filter_bench fb;
+	int i, p;
+
+	fb.in_unitsize = in_unitsize;
+	fb.out_unitsize = out_unitsize;
+	fb.buf = buf;
+	fb.probes = g_array_new(FALSE, FALSE, sizeof(int));
+	for (i = 0, p = 0; i < num_probes; i++, p += step)
+		g_array_append_val(fb.probes, p);
+
+	srbench_run(name, bench_filter_probes, &fb);
+
+	g_array_free(fb.probes, TRUE);
+}
+
+void srbench_core(struct sr_context *sr_ctx)
+{
+	uint8_t *buf;
+
+	(void)sr_ctx;
+
+	if (!(buf = srbench_logic_buf(SRBENCH_BUFSIZE)))
+		return;
+
+	run_filter("filter_probes/1to1/8", 1, 1, 8, 1, buf);
+	run_filter("filter_probes/2to1/8", 2, 1, 8, 2, buf);
+	run_filter("filter_probes/2to2/16", 2, 2, 16, 1, buf);
+	run_filter("filter_probes/4to1/4", 4, 1, 4, 8, buf);
+
+	g_free(buf);
+}
@@ -0,0 +1,192 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+#include <glib.h>
+#include "../libsigrok.h"
+#include "../libsigrok-internal.h"
+#ifdef HAVE_HW_SALEAE_LOGIC16
+#include "../hardware/saleae-logic16/protocol.h"
+#endif
+#include "bench.h"
+
+/* Samples captured from the demo driver per benchmark iteration. */
+#define DEMO_LIMIT_SAMPLES	(64 * 1024 * 1024)
+
+#ifdef HAVE_HW_SALEAE_LOGIC16
+struct logic16_bench {
+	struct dev_context devc;
+	uint8_t *buf;
+	uint8_t *convbuf;
+	size_t convbuf_size;
+};
+
+static int bench_logic16_convert(void *data, uint64_t *bytes,
+		uint64_t *samples)
+{
+	struct logic16_bench *lb;
+	size_t converted;
+	int i;
+
+	lb = data;
+	lb->devc.cur_channel = 0;
+	memset(lb->devc.channel_data, 0, sizeof(lb->devc.channel_data));
+
+	/* Convert the recorded buffer in USB transfer sized chunks. */
+	converted = 0;
+	for (i = 0; i < SRBENCH_NUM_CHUNKS; i++)
+		converted += logic16_convert_sample_data(&lb->devc,
+				lb->convbuf, lb->convbuf_size,
+				lb->buf + i * SRBENCH_CHUNKSIZE,
+				SRBENCH_CHUNKSIZE);
+
+	*bytes += SRBENCH_BUFSIZE;
+	*samples += converted / 2;
+
+	return SR_OK;
+}
+
+static void run_logic16_convert(const char *name, int num_channels)
+{
+	struct logic16_bench lb;
+	int i;
+
+	memset(&lb, 0, sizeof(lb));
+	lb.devc.num_channels = num_channels;
+	for (i = 0; i < num_channels; i++)
+		lb.devc.channel_masks[i] = 1 << i;
+
+	/* Same sizing as dev_acquisition_start() uses. */
+	lb.convbuf_size = (SRBENCH_CHUNKSIZE / num_channels + 2) * 16;
+	lb.buf = srbench_logic_buf(SRBENCH_BUFSIZE);
+	lb.convbuf = g_try_malloc(lb.convbuf_size);
+	if (lb.buf && lb.convbuf)
+		srbench_run(name, bench_logic16_convert, &lb);
+
+	g_free(lb.buf);
+	g_free(lb.convbuf);
+}
+#endif
+
+struct trigger_bench {
+	int unitsize;
+	/* Logic data with the MSB of every byte cleared. */
+	uint8_t *buf;
+};
+
+/* Wait for a trigger that never fires, the worst case for a driver. */
+static int bench_soft_trigger(void *data, uint64_t *bytes, uint64_t *samples)
+{
+	struct trigger_bench *tb;
+	struct sr_soft_trigger st;
+	int num_samples, i;
+
+	tb = data;
+	sr_soft_trigger_init(&st, tb->unitsize);
+	sr_soft_trigger_add_stage(&st, 0x8080, 0x8080);
+	sr_soft_trigger_add_stage(&st, 0x0101, 0x0000);
+
+	num_samples = SRBENCH_CHUNKSIZE / tb->unitsize;
+	for (i = 0; i < SRBENCH_NUM_CHUNKS; i++) {
+		if (sr_soft_trigger_scan(&st, tb->buf + i * SRBENCH_CHUNKSIZE,
+					 num_samples) >= 0)
+			return SR_ERR;
+	}
+
+	*bytes += SRBENCH_BUFSIZE;
+	*samples += num_samples * SRBENCH_NUM_CHUNKS;
+
+	return SR_OK;
+}
+
+struct demo_bench {
+	struct sr_dev_inst *sdi;
+	uint64_t bytes;
+	uint64_t samples;
+};
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	struct demo_bench *db;
+
+	(void)sdi;
+
+	db = cb_data;
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		db->bytes += logic->length;
+		db->samples += logic->length / logic->unitsize;
+	}
+}
+
+static int bench_demo(void *data, uint64_t *bytes, uint64_t *samples)
+{
+	struct demo_bench *db;
+	int ret;
+
+	db = data;
+	db->bytes = db->samples = 0;
+	sr_session_new();
+	sr_session_datafeed_callback_add(datafeed_in, db);
+	sr_session_dev_add(db->sdi);
+	if ((ret = sr_session_start()) == SR_OK)
+		ret = sr_session_run();
+	sr_session_destroy();
+
+	*bytes += db->bytes;
+	*samples += db->samples;
+
+	return ret;
+}
+
+void srbench_driver(struct sr_context *sr_ctx)
+{
+	struct trigger_bench tb;
+	struct demo_bench db;
+	int i;
+
+#ifdef HAVE_HW_SALEAE_LOGIC16
+	run_logic16_convert("driver/saleae-logic16/convert/16ch", 16);
+	run_logic16_convert("driver/saleae-logic16/convert/8ch", 8);
+	run_logic16_convert("driver/saleae-logic16/convert/3ch", 3);
+#endif
+
+	if ((tb.buf = srbench_logic_buf(SRBENCH_BUFSIZE))) {
+		for (i = 0; i < SRBENCH_BUFSIZE; i++)
+			tb.buf[i] &= 0x7f;
+		tb.unitsize = 1;
+		srbench_run("driver/soft_trigger/8bit", bench_soft_trigger, &tb);
+		tb.unitsize = 2;
+		srbench_run("driver/soft_trigger/16bit", bench_soft_trigger, &tb);
+		g_free(tb.buf);
+	}
+
+	/* Session bus throughput, with a logic-only demo device as source. */
+	if (!(db.sdi = srbench_demo_dev(sr_ctx, 0)))
+		return;
+	sr_config_set(db.sdi, NULL, SR_CONF_MAX_THROUGHPUT,
+		      g_variant_new_boolean(TRUE));
+	sr_config_set(db.sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		      g_variant_new_uint64(DEMO_LIMIT_SAMPLES));
+
+	srbench_run("driver/demo/max_throughput", bench_demo, &db);
+
+	sr_dev_close(db.sdi);
+}
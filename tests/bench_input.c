@@ -0,0 +1,245 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "../libsigrok.h"
+#include "../libsigrok-internal.h"
+#include "bench.h"
+
+/* Fixed size of a ChronoVu LA8 capture: 8MB of samples plus 5 bytes. */
+#define LA8_FILESIZE		(8 * 1024 * 1024 + 5)
+
+#define WAV_HEADER_SIZE		44
+
+struct input_bench {
+	struct sr_input_format *format;
+	char *filename;
+	uint64_t filesize;
+	uint64_t samples;
+};
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+	struct input_bench *ib;
+
+	(void)sdi;
+
+	ib = cb_data;
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		ib->samples += logic->length / logic->unitsize;
+	} else if (packet->type == SR_DF_ANALOG) {
+		analog = packet->payload;
+		ib->samples += analog->num_samples;
+	}
+}
+
+static int bench_input(void *data, uint64_t *bytes, uint64_t *samples)
+{
+	struct input_bench *ib;
+	struct sr_input in;
+	int ret;
+
+	ib = data;
+	memset(&in, 0, sizeof(in));
+	in.format = ib->format;
+	if ((ret = in.format->init(&in, ib->filename)) != SR_OK)
+		return ret;
+
+	ib->samples = 0;
+	sr_session_new();
+	sr_session_datafeed_callback_add(datafeed_in, ib);
+	sr_session_dev_add(in.sdi);
+	ret = in.format->loadfile(&in, ib->filename);
+	sr_session_destroy();
+	sr_dev_inst_free(in.sdi);
+
+	*bytes += ib->filesize;
+	*samples += ib->samples;
+
+	return ret;
+}
+
+static GString *gen_binary(const uint8_t *buf)
+{
+	GString *s;
+
+	s = g_string_sized_new(SRBENCH_BUFSIZE);
+	g_string_append_len(s, (const gchar *)buf, SRBENCH_BUFSIZE);
+
+	return s;
+}
+
+static GString *gen_chronovu_la8(const uint8_t *buf)
+{
+	GString *s;
+	int i;
+
+	s = g_string_sized_new(LA8_FILESIZE);
+	for (i = 0; i < LA8_FILESIZE - 5; i += SRBENCH_BUFSIZE)
+		g_string_append_len(s, (const gchar *)buf, SRBENCH_BUFSIZE);
+	/* Divcount 0 (100MHz), followed by the trigger point. */
+	g_string_append_len(s, "\x00\x00\x00\x00\x00", 5);
+
+	return s;
+}
+
+static GString *gen_csv(const uint8_t *buf)
+{
+	GString *s;
+	int i, b;
+
+	/* One sample per line, one column per probe. */
+	s = g_string_sized_new(SRBENCH_BUFSIZE / 8 * 16);
+	for (i = 0; i < SRBENCH_BUFSIZE / 8; i++) {
+		for (b = 0; b < 8; b++) {
+			g_string_append_c(s, buf[i] & (1 << b) ? '1' : '0');
+			g_string_append_c(s, b == 7 ? '\n' : ',');
+		}
+	}
+
+	return s;
+}
+
+static GString *gen_vcd(const uint8_t *buf)
+{
+	GString *s;
+	uint8_t prev, diff;
+	int i, b;
+
+	s = g_string_sized_new(SRBENCH_BUFSIZE);
+	g_string_append(s, "$timescale 1 us $end\n$scope module bench $end\n");
+	for (b = 0; b < 8; b++)
+		g_string_append_printf(s, "$var wire 1 %c D%d $end\n", '!' + b, b);
+	g_string_append(s, "$upscope $end\n$enddefinitions $end\n");
+
+	prev = ~buf[0];
+	for (i = 0; i < SRBENCH_BUFSIZE; i++) {
+		if (!(diff = buf[i] ^ prev))
+			continue;
+		g_string_append_printf(s, "#%d", i);
+		for (b = 0; b < 8; b++) {
+			if (diff & (1 << b))
+				g_string_append_printf(s, " %c%c",
+					buf[i] & (1 << b) ? '1' : '0', '!' + b);
+		}
+		g_string_append_c(s, '\n');
+		prev = buf[i];
+	}
+	g_string_append_printf(s, "#%d\n", SRBENCH_BUFSIZE);
+
+	return s;
+}
+
+static void put_le(uint8_t *p, uint32_t val, int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++, val >>= 8)
+		p[i] = val & 0xff;
+}
+
+static GString *gen_wav(const uint8_t *buf)
+{
+	GString *s;
+	uint8_t hdr[WAV_HEADER_SIZE];
+
+	/* 16-bit mono PCM at SRBENCH_SAMPLERATE. */
+	memset(hdr, 0, sizeof(hdr));
+	memcpy(hdr, "RIFF", 4);
+	put_le(hdr + 4, WAV_HEADER_SIZE - 8 + SRBENCH_BUFSIZE, 4);
+	memcpy(hdr + 8, "WAVEfmt ", 8);
+	put_le(hdr + 16, 16, 4);
+	put_le(hdr + 20, 1, 2);
+	put_le(hdr + 22, 1, 2);
+	put_le(hdr + 24, SRBENCH_SAMPLERATE, 4);
+	put_le(hdr + 28, SRBENCH_SAMPLERATE * 2, 4);
+	put_le(hdr + 32, 2, 2);
+	put_le(hdr + 34, 16, 2);
+	memcpy(hdr + 36, "data", 4);
+	put_le(hdr + 40, SRBENCH_BUFSIZE, 4);
+
+	s = g_string_sized_new(WAV_HEADER_SIZE + SRBENCH_BUFSIZE);
+	g_string_append_len(s, (const gchar *)hdr, WAV_HEADER_SIZE);
+	g_string_append_len(s, (const gchar *)buf, SRBENCH_BUFSIZE);
+
+	return s;
+}
+
+static const struct {
+	const char *id;
+	const char *suffix;
+	GString *(*gen)(const uint8_t *buf);
+} input_files[] = {
+	{"binary", ".bin", gen_binary},
+	{"chronovu-la8", ".kdt", gen_chronovu_la8},
+	{"csv", ".csv", gen_csv},
+	{"vcd", ".vcd", gen_vcd},
+	{"wav", ".wav", gen_wav},
+};
+
+void srbench_input(struct sr_context *sr_ctx)
+{
+	struct sr_input_format **inputs;
+	struct input_bench ib;
+	GString *contents;
+	uint8_t *buf;
+	unsigned int j;
+	char *name;
+	int i;
+
+	(void)sr_ctx;
+
+	if (!(buf = srbench_logic_buf(SRBENCH_BUFSIZE)))
+		return;
+
+	inputs = sr_input_list();
+	for (i = 0; inputs[i]; i++) {
+		for (j = 0; j < ARRAY_SIZE(input_files); j++) {
+			if (!strcmp(inputs[i]->id, input_files[j].id))
+				break;
+		}
+		if (j == ARRAY_SIZE(input_files)) {
+			fprintf(stderr, "input/%s: no test file generator, "
+				"skipping.\n", inputs[i]->id);
+			continue;
+		}
+
+		ib.format = inputs[i];
+		ib.filename = srbench_tmpfile(input_files[j].suffix);
+		contents = input_files[j].gen(buf);
+		ib.filesize = contents->len;
+		if (g_file_set_contents(ib.filename, contents->str,
+					contents->len, NULL)) {
+			name = g_strdup_printf("input/%s", ib.format->id);
+			srbench_run(name, bench_input, &ib);
+			g_free(name);
+			g_unlink(ib.filename);
+		}
+		g_string_free(contents, TRUE);
+		g_free(ib.filename);
+	}
+
+	g_free(buf);
+}
@@ -0,0 +1,185 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "../libsigrok.h"
+#include "bench.h"
+
+/* Fixed seed, so every run benchmarks the exact same buffers. */
+#define SRBENCH_SEED 0x2545f491
+
+static const char *bench_filter = NULL;
+
+/* Only run benchmarks whose name contains this substring. */
+void srbench_set_filter(const char *filter)
+{
+	bench_filter = filter;
+}
+
+/*
+ * Run a benchmark until it has been busy for at least SRBENCH_MIN_USEC
+ * and SRBENCH_MIN_RUNS iterations, after one untimed warm-up iteration.
+ *
+ * The result is written to stdout as one tab-separated line:
+ * name, bytes, samples, seconds, MB/s, samples/s.
+ */
+void srbench_run(const char *name, srbench_func_t func, void *data)
+{
+	uint64_t bytes, samples, dummy;
+	gint64 start, elapsed;
+	double secs;
+	int runs;
+
+	if (bench_filter && !strstr(name, bench_filter))
+		return;
+
+	dummy = 0;
+	if (func(data, &dummy, &dummy) != SR_OK) {
+		fprintf(stderr, "%s: benchmark failed, skipping.\n", name);
+		return;
+	}
+
+	bytes = samples = 0;
+	runs = 0;
+	start = g_get_monotonic_time();
+	do {
+		if (func(data, &bytes, &samples) != SR_OK) {
+			fprintf(stderr, "%s: benchmark failed.\n", name);
+			return;
+		}
+		runs++;
+		elapsed = g_get_monotonic_time() - start;
+	} while (elapsed < SRBENCH_MIN_USEC || runs < SRBENCH_MIN_RUNS);
+
+	secs = elapsed / 1000000.0;
+	printf("%s\t%" PRIu64 "\t%" PRIu64 "\t%.6f\t%.3f\t%.0f\n", name,
+	       bytes, samples, secs, bytes / secs / 1000000.0, samples / secs);
+	fflush(stdout);
+}
+
+static uint32_t rng_next(uint32_t *state)
+{
+	uint32_t x;
+
+	x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+
+	return x;
+}
+
+/*
+ * Return a buffer of len bytes of logic data. Roughly every fourth
+ * byte changes, which looks more like a real capture than pure noise
+ * to modules that compress or only emit changes.
+ */
+uint8_t *srbench_logic_buf(uint64_t len)
+{
+	uint8_t *buf, cur;
+	uint32_t state, r;
+	uint64_t i;
+
+	if (!(buf = g_try_malloc(len)))
+		return NULL;
+
+	state = SRBENCH_SEED;
+	cur = 0;
+	for (i = 0; i < len; i++) {
+		r = rng_next(&state);
+		if ((r & 3) == 0)
+			cur = r >> 24;
+		buf[i] = cur;
+	}
+
+	return buf;
+}
+
+/* Return a buffer of num_samples floats in the range [-1, 1]. */
+float *srbench_analog_buf(uint64_t num_samples)
+{
+	float *buf;
+	uint32_t state;
+	uint64_t i;
+
+	if (!(buf = g_try_malloc(num_samples * sizeof(float))))
+		return NULL;
+
+	state = SRBENCH_SEED;
+	for (i = 0; i < num_samples; i++)
+		buf[i] = (int32_t)rng_next(&state) / 2147483648.0;
+
+	return buf;
+}
+
+/* Return a new, opened demo device with the given number of analog probes. */
+struct sr_dev_inst *srbench_demo_dev(struct sr_context *sr_ctx,
+		int num_analog_probes)
+{
+	struct sr_dev_driver **drivers, *driver;
+	struct sr_dev_inst *sdi;
+	struct sr_config src;
+	GSList *devices, *options;
+	int i;
+
+	driver = NULL;
+	drivers = sr_driver_list();
+	for (i = 0; drivers[i]; i++) {
+		if (!strcmp(drivers[i]->name, "demo"))
+			driver = drivers[i];
+	}
+	if (!driver) {
+		fprintf(stderr, "Demo driver not available.\n");
+		return NULL;
+	}
+
+	if (!driver->priv && sr_driver_init(sr_ctx, driver) != SR_OK)
+		return NULL;
+
+	src.key = SR_CONF_NUM_ANALOG_PROBES;
+	src.data = g_variant_ref_sink(g_variant_new_int32(num_analog_probes));
+	options = g_slist_append(NULL, &src);
+	devices = sr_driver_scan(driver, options);
+	g_slist_free(options);
+	g_variant_unref(src.data);
+	if (!devices)
+		return NULL;
+	sdi = devices->data;
+	g_slist_free(devices);
+
+	if (sr_dev_open(sdi) != SR_OK)
+		return NULL;
+
+	/* sr_config_set() takes ownership of the floating reference. */
+	sr_config_set(sdi, NULL, SR_CONF_SAMPLERATE,
+		      g_variant_new_uint64(SRBENCH_SAMPLERATE));
+
+	return sdi;
+}
+
+/* Return a newly allocated, not yet existing temporary filename. */
+char *srbench_tmpfile(const char *suffix)
+{
+	return g_strdup_printf("%s/srbench-%d%s", g_get_tmp_dir(),
+			       (int)getpid(), suffix);
+}
@@ -0,0 +1,53 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../libsigrok.h"
+#include "bench.h"
+
+/*
+ * Usage: bench_main [filter]
+ *
+ * Runs all benchmarks (or only those whose name contains 'filter') and
+ * prints one tab-separated result line per benchmark on stdout.
+ */
+int main(int argc, char **argv)
+{
+	struct sr_context *sr_ctx;
+
+	if (argc > 1)
+		srbench_set_filter(argv[1]);
+
+	if (sr_init(&sr_ctx) != SR_OK) {
+		fprintf(stderr, "sr_init() failed.\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("# name\tbytes\tsamples\tseconds\tMB/s\tsamples/s\n");
+
+	srbench_core(sr_ctx);
+	srbench_output(sr_ctx);
+	srbench_input(sr_ctx);
+	srbench_session(sr_ctx);
+	srbench_driver(sr_ctx);
+
+	sr_exit(sr_ctx);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <glib.h>
+#include "../libsigrok.h"
+#include "bench.h"
+
+struct output_bench {
+	struct sr_output_format *format;
+	struct sr_dev_inst *sdi;
+	uint8_t *logic_buf;
+	float *analog_buf;
+	GSList *analog_probes;
+	/* Output is collected here, and thrown away after every packet. */
+	struct sr_output_sink *sink;
+};
+
+/* Feed one packet to a module, discarding its output. */
+static int output_send(struct output_bench *ob, struct sr_output *o,
+		const struct sr_datafeed_packet *packet)
+{
+	int ret;
+
+	ret = sr_output_send(o, packet, ob->sink);
+	g_string_truncate(sr_output_sink_buffer(ob->sink), 0);
+
+	return ret;
+}
+
+static int bench_output_logic(void *data, uint64_t *bytes, uint64_t *samples)
+{
+	struct output_bench *ob;
+	struct sr_output o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	int ret, i;
+
+	ob = data;
+	o.format = ob->format;
+	o.sdi = ob->sdi;
+	o.param = NULL;
+	o.internal = NULL;
+	if (o.format->init && (ret = o.format->init(&o)) != SR_OK)
+		return ret;
+
+	packet.type = SR_DF_HEADER;
+	packet.payload = NULL;
+	ret = output_send(ob, &o, &packet);
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = 1;
+	logic.length = SRBENCH_CHUNKSIZE;
+	for (i = 0; i < SRBENCH_NUM_CHUNKS && ret == SR_OK; i++) {
+		logic.data = ob->logic_buf + i * SRBENCH_CHUNKSIZE;
+		ret = output_send(ob, &o, &packet);
+	}
+
+	if (ret == SR_OK) {
+		packet.type = SR_DF_END;
+		packet.payload = NULL;
+		ret = output_send(ob, &o, &packet);
+	}
+
+	if (o.format->cleanup)
+		o.format->cleanup(&o);
+
+	*bytes += SRBENCH_BUFSIZE;
+	*samples += SRBENCH_BUFSIZE;
+
+	return ret;
+}
+
+static int bench_output_analog(void *data, uint64_t *bytes, uint64_t *samples)
+{
+	struct output_bench *ob;
+	struct sr_output o;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_analog analog;
+	int num_samples, ret, i;
+
+	ob = data;
+	o.format = ob->format;
+	o.sdi = ob->sdi;
+	o.param = NULL;
+	o.internal = NULL;
+	if (o.format->init && (ret = o.format->init(&o)) != SR_OK)
+		return ret;
+
+	num_samples = SRBENCH_CHUNKSIZE / sizeof(float);
+	packet.type = SR_DF_ANALOG;
+	packet.payload = &analog;
+	analog.probes = ob->analog_probes;
+	analog.num_samples = num_samples;
+	analog.mq = SR_MQ_VOLTAGE;
+	analog.unit = SR_UNIT_VOLT;
+	analog.mqflags = SR_MQFLAG_DC;
+	ret = SR_OK;
+	for (i = 0; i < SRBENCH_NUM_CHUNKS && ret == SR_OK; i++) {
+		analog.data = ob->analog_buf + i * num_samples;
+		ret = output_send(ob, &o, &packet);
+	}
+
+	if (o.format->cleanup)
+		o.format->cleanup(&o);
+
+	*bytes += SRBENCH_BUFSIZE;
+	*samples += SRBENCH_BUFSIZE / sizeof(float);
+
+	return ret;
+}
+
+void srbench_output(struct sr_context *sr_ctx)
+{
+	struct sr_output_format **outputs;
+	struct output_bench ob;
+	struct sr_probe *probe;
+	GSList *l;
+	char *name;
+	int i;
+
+	if (!(ob.sdi = srbench_demo_dev(sr_ctx, 1)))
+		return;
+
+	/* Only the first analog probe is fed to analog output modules. */
+	ob.analog_probes = NULL;
+	for (l = ob.sdi->probes; l; l = l->next) {
+		probe = l->data;
+		if (probe->type == SR_PROBE_ANALOG) {
+			ob.analog_probes = g_slist_append(NULL, probe);
+			break;
+		}
+	}
+
+	ob.logic_buf = srbench_logic_buf(SRBENCH_BUFSIZE);
+	ob.analog_buf = srbench_analog_buf(SRBENCH_BUFSIZE / sizeof(float));
+	ob.sink = sr_output_sink_new(NULL, NULL);
+	if (!ob.logic_buf || !ob.analog_buf || !ob.sink)
+		goto out;
+
+	outputs = sr_output_list();
+	for (i = 0; outputs[i]; i++) {
+		ob.format = outputs[i];
+		name = g_strdup_printf("output/%s", ob.format->id);
+		if (ob.format->df_type == SR_DF_ANALOG) {
+			if (ob.analog_probes && (ob.format->receive
+					|| ob.format->receive_append))
+				srbench_run(name, bench_output_analog, &ob);
+		} else {
+			srbench_run(name, bench_output_logic, &ob);
+		}
+		g_free(name);
+	}
+
+out:
+	g_free(ob.logic_buf);
+	g_free(ob.analog_buf);
+	g_slist_free(ob.analog_probes);
+	sr_output_sink_free(ob.sink);
+	sr_dev_close(ob.sdi);
+}
@@ -0,0 +1,112 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include "../libsigrok.h"
+#include "bench.h"
+
+static char *probe_names[] = {
+	"D0", "D1", "D2", "D3", "D4", "D5", "D6", "D7", NULL,
+};
+
+struct session_bench {
+	char *filename;
+	uint8_t *buf;
+	uint64_t samples;
+};
+
+static int bench_session_save(void *data, uint64_t *bytes, uint64_t *samples)
+{
+	struct session_bench *sb;
+	int ret, i;
+
+	sb = data;
+	ret = sr_session_save_init(sb->filename, SRBENCH_SAMPLERATE,
+				   probe_names);
+	for (i = 0; i < SRBENCH_NUM_CHUNKS && ret == SR_OK; i++)
+		ret = sr_session_append(sb->filename,
+				sb->buf + i * SRBENCH_CHUNKSIZE,
+				1, SRBENCH_CHUNKSIZE);
+
+	*bytes += SRBENCH_BUFSIZE;
+	*samples += SRBENCH_BUFSIZE;
+
+	return ret;
+}
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	struct session_bench *sb;
+
+	(void)sdi;
+
+	sb = cb_data;
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		sb->samples += logic->length / logic->unitsize;
+	}
+}
+
+static int bench_session_replay(void *data, uint64_t *bytes, uint64_t *samples)
+{
+	struct session_bench *sb;
+	int ret;
+
+	sb = data;
+	sb->samples = 0;
+	if ((ret = sr_session_load(sb->filename)) != SR_OK)
+		return ret;
+	sr_session_datafeed_callback_add(datafeed_in, sb);
+	if ((ret = sr_session_start()) == SR_OK)
+		ret = sr_session_run();
+	sr_session_destroy();
+
+	if (sb->samples != SRBENCH_BUFSIZE)
+		return SR_ERR;
+
+	*bytes += SRBENCH_BUFSIZE;
+	*samples += sb->samples;
+
+	return ret;
+}
+
+void srbench_session(struct sr_context *sr_ctx)
+{
+	struct session_bench sb;
+	uint64_t dummy;
+
+	(void)sr_ctx;
+
+	if (!(sb.buf = srbench_logic_buf(SRBENCH_BUFSIZE)))
+		return;
+	sb.filename = srbench_tmpfile(".sr");
+
+	srbench_run("session/save_append", bench_session_save, &sb);
+
+	/* The replay benchmark needs a file, even if the above was skipped. */
+	dummy = 0;
+	if (bench_session_save(&sb, &dummy, &dummy) == SR_OK)
+		srbench_run("session/replay", bench_session_replay, &sb);
+	g_unlink(sb.filename);
+
+	g_free(sb.filename);
+	g_free(sb.buf);
+}
@@ -161,6 +161,35 @@ START_TEST(test_exit_null)
 }
 END_TEST
 
+/* Check whether the trace buffer keeps the newest events, oldest first. */
+START_TEST(test_trace)
+{
+	struct sr_trace_entry *entries;
+	unsigned int num, i;
+	int ret;
+
+	ret = sr_trace_add(SR_TRACE_USER, 0, 0);
+	fail_unless(ret != SR_OK, "sr_trace_add() without a buffer worked.");
+
+	ret = sr_trace_enable(3);
+	fail_unless(ret == SR_OK, "sr_trace_enable() failed: %d.", ret);
+	for (i = 0; i < 10; i++)
+		sr_trace_add(SR_TRACE_USER, i, i * 2);
+
+	ret = sr_trace_get(&entries, &num);
+	fail_unless(ret == SR_OK, "sr_trace_get() failed: %d.", ret);
+	fail_unless(num == 4, "Got %u trace entries instead of 4.", num);
+	for (i = 0; i < num; i++) {
+		fail_unless(entries[i].event == SR_TRACE_USER, "Wrong event.");
+		fail_unless(entries[i].arg1 == 6 + i, "Wrong trace order.");
+		fail_unless(entries[i].arg2 == (6 + i) * 2, "Wrong payload.");
+	}
+	g_free(entries);
+
+	sr_trace_enable(0);
+}
+END_TEST
+
 Suite *suite_core(void)
 {
 	Suite *s;
@@ -178,5 +207,9 @@ Suite *suite_core(void)
 	tcase_add_test(tc, test_exit_null);
 	suite_add_tcase(s, tc);
 
+	tc = tcase_create("trace");
+	tcase_add_test(tc, test_trace);
+	suite_add_tcase(s, tc);
+
 	return s;
 }
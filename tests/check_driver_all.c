@@ -58,6 +58,35 @@ START_TEST(test_driver_init_all)
 }
 END_TEST
 
+/* Check whether scanning with all initialized drivers finds the demo device. */
+START_TEST(test_driver_scan_all)
+{
+	struct sr_dev_driver *driver;
+	GSList *devices, *cached;
+
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(sr_ctx, driver);
+
+	devices = sr_driver_scan_all(sr_ctx, NULL, FALSE);
+	fail_unless(devices != NULL, "No devices found.");
+
+	/* Nothing changed, so the cached result must be the same. */
+	cached = sr_driver_scan_all(sr_ctx, NULL, TRUE);
+	fail_unless(g_slist_length(cached) == g_slist_length(devices),
+		    "Cached scan result differs.");
+	fail_unless(cached->data == devices->data,
+		    "Cached scan result differs.");
+	g_slist_free(cached);
+
+	/* After the devices are gone, the cache must not be used. */
+	sr_dev_clear(driver);
+	cached = sr_driver_scan_all(sr_ctx, NULL, TRUE);
+	fail_unless(cached != NULL, "No devices found.");
+	g_slist_free(cached);
+	g_slist_free(devices);
+}
+END_TEST
+
 /*
  * Check whether setting a samplerate works.
  *
@@ -88,6 +117,7 @@ Suite *suite_driver_all(void)
 	tcase_add_checked_fixture(tc, setup, teardown);
 	tcase_add_test(tc, test_driver_available);
 	tcase_add_test(tc, test_driver_init_all);
+	tcase_add_test(tc, test_driver_scan_all);
 	// TODO: Currently broken.
 	// tcase_add_test(tc, test_config_get_set_samplerate);
 	suite_add_tcase(s, tc);
@@ -19,6 +19,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <check.h>
 #include "../libsigrok.h"
 #include "lib.h"
@@ -33,6 +34,391 @@ START_TEST(test_output_available)
 }
 END_TEST
 
+/* Check that the binary output module passes its input through. */
+START_TEST(test_output_binary_borrow)
+{
+	struct sr_output_format *format;
+	struct sr_output o;
+	const uint8_t buf[] = { 0x01, 0x02, 0x04, 0x08 };
+	const uint8_t *out;
+	uint8_t *copy;
+	uint64_t outlen;
+	int ret;
+
+	format = srtest_output_get("binary");
+	fail_unless(format->data_borrow != NULL, "No data_borrow().");
+
+	o.format = format;
+	o.sdi = NULL;
+	o.param = NULL;
+	o.internal = NULL;
+
+	ret = format->data_borrow(&o, buf, sizeof(buf), &out, &outlen);
+	fail_unless(ret == SR_OK, "data_borrow() failed: %d.", ret);
+	fail_unless(out == buf, "Output is not the input buffer.");
+	fail_unless(outlen == sizeof(buf), "Wrong output length.");
+
+	/* The copying variant must produce the same bytes. */
+	ret = format->data(&o, buf, sizeof(buf), &copy, &outlen);
+	fail_unless(ret == SR_OK, "data() failed: %d.", ret);
+	fail_unless(outlen == sizeof(buf), "Wrong output length.");
+	fail_unless(!memcmp(copy, buf, sizeof(buf)), "Output mismatch.");
+	g_free(copy);
+}
+END_TEST
+
+static int collect(const uint8_t *buf, size_t len, void *cb_data)
+{
+	g_byte_array_append(cb_data, buf, len);
+
+	return SR_OK;
+}
+
+/* Check that sr_output_send() hands all output to the write callback. */
+START_TEST(test_output_sink)
+{
+	struct sr_output o;
+	struct sr_output_sink *sink;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GByteArray *written;
+	uint8_t buf[1000];
+	int ret, i;
+
+	for (i = 0; i < (int)sizeof(buf); i++)
+		buf[i] = i;
+
+	o.format = srtest_output_get("binary");
+	o.sdi = NULL;
+	o.param = NULL;
+	o.internal = NULL;
+
+	written = g_byte_array_new();
+	sink = sr_output_sink_new(collect, written);
+	fail_unless(sink != NULL, "Failed to create sink.");
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = 1;
+	logic.length = 100;
+	for (i = 0; i < 10; i++) {
+		logic.data = buf + i * 100;
+		ret = sr_output_send(&o, &packet, sink);
+		fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	}
+
+	/* Small output is buffered until the end of the feed. */
+	fail_unless(written->len == 0, "Output was not buffered.");
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	ret = sr_output_send(&o, &packet, sink);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	fail_unless(written->len == sizeof(buf), "Wrong output length: %d.",
+		    written->len);
+	fail_unless(!memcmp(written->data, buf, sizeof(buf)),
+		    "Output mismatch.");
+
+	sr_output_sink_free(sink);
+	g_byte_array_free(written, TRUE);
+}
+END_TEST
+
+/* Check that output of at least SINK_FLUSH_SIZE bypasses the buffer. */
+START_TEST(test_output_sink_large)
+{
+	struct sr_output o;
+	struct sr_output_sink *sink;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GByteArray *written;
+	uint8_t *buf;
+	int len, ret, i;
+
+	len = 100 + 64 * 1024;
+	buf = g_malloc(len);
+	for (i = 0; i < len; i++)
+		buf[i] = i;
+
+	o.format = srtest_output_get("binary");
+	o.sdi = NULL;
+	o.param = NULL;
+	o.internal = NULL;
+
+	written = g_byte_array_new();
+	sink = sr_output_sink_new(collect, written);
+	fail_unless(sink != NULL, "Failed to create sink.");
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = 1;
+
+	/* A small packet is buffered... */
+	logic.data = buf;
+	logic.length = 100;
+	ret = sr_output_send(&o, &packet, sink);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	fail_unless(written->len == 0, "Output was not buffered.");
+
+	/* ...and written ahead of a large one, which is written through. */
+	logic.data = buf + 100;
+	logic.length = len - 100;
+	ret = sr_output_send(&o, &packet, sink);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	fail_unless((int)written->len == len, "Wrong output length: %d.",
+		    written->len);
+	fail_unless(!memcmp(written->data, buf, len), "Output mismatch.");
+	fail_unless(sr_output_sink_buffer(sink)->len == 0,
+		    "Output left in the buffer.");
+
+	sr_output_sink_free(sink);
+	g_byte_array_free(written, TRUE);
+	g_free(buf);
+}
+END_TEST
+
+static int failing_receive_append(struct sr_output *o,
+		const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, GString *out)
+{
+	(void)o;
+	(void)sdi;
+
+	if (packet->type != SR_DF_LOGIC)
+		return SR_OK;
+
+	g_string_append(out, "partial");
+
+	return SR_ERR;
+}
+
+/* Check that the output of a failed receive_append() is dropped. */
+START_TEST(test_output_sink_error)
+{
+	struct sr_output_format format;
+	struct sr_output o;
+	struct sr_output_sink *sink;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	uint8_t buf[4];
+	int ret;
+
+	memset(&format, 0, sizeof(format));
+	format.id = "failing";
+	format.receive_append = failing_receive_append;
+	o.format = &format;
+	o.sdi = NULL;
+	o.param = NULL;
+	o.internal = NULL;
+
+	sink = sr_output_sink_new(NULL, NULL);
+	fail_unless(sink != NULL, "Failed to create sink.");
+	g_string_append(sr_output_sink_buffer(sink), "kept");
+
+	memset(buf, 0, sizeof(buf));
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = 1;
+	logic.length = sizeof(buf);
+	logic.data = buf;
+	ret = sr_output_send(&o, &packet, sink);
+	fail_unless(ret == SR_ERR, "sr_output_send() didn't fail: %d.", ret);
+	fail_unless(!strcmp(sr_output_sink_buffer(sink)->str, "kept"),
+		    "Partial output was kept: %s.",
+		    sr_output_sink_buffer(sink)->str);
+
+	sr_output_sink_free(sink);
+}
+END_TEST
+
+static struct sr_context *sr_ctx;
+static struct sr_dev_inst *demo_sdi;
+
+static void setup(void)
+{
+	struct sr_dev_driver *driver;
+	GSList *devices;
+	int ret;
+
+	ret = sr_init(&sr_ctx);
+	fail_unless(ret == SR_OK, "sr_init() failed: %d.", ret);
+
+	/* Output modules need a device for probe names and the samplerate. */
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(sr_ctx, driver);
+	devices = sr_driver_scan(driver, NULL);
+	fail_unless(devices != NULL, "No demo device found.");
+
+	demo_sdi = devices->data;
+	g_slist_free(devices);
+}
+
+static void teardown(void)
+{
+	int ret;
+
+	ret = sr_exit(sr_ctx);
+	fail_unless(ret == SR_OK, "sr_exit() failed: %d.", ret);
+}
+
+/*
+ * Feed 8-bit logic data in two packets to an output module, and return
+ * all of its output. The data is split at offset split.
+ */
+static GString *output_logic(const char *id, char *param,
+		const uint8_t *buf, uint64_t len, uint64_t split)
+{
+	struct sr_output o;
+	struct sr_output_sink *sink;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GString *out;
+	int ret;
+
+	o.format = srtest_output_get(id);
+	o.sdi = demo_sdi;
+	o.param = param;
+	o.internal = NULL;
+	ret = o.format->init(&o);
+	fail_unless(ret == SR_OK, "init() failed: %d.", ret);
+	sink = sr_output_sink_new(NULL, NULL);
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = 1;
+	logic.data = (void *)buf;
+	logic.length = split;
+	ret = sr_output_send(&o, &packet, sink);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	logic.data = (void *)(buf + split);
+	logic.length = len - split;
+	ret = sr_output_send(&o, &packet, sink);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	ret = sr_output_send(&o, &packet, sink);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+
+	o.format->cleanup(&o);
+	out = g_string_new(sr_output_sink_buffer(sink)->str);
+	sr_output_sink_free(sink);
+
+	return out;
+}
+
+/* Check that the OLS output module only writes changed samples. */
+START_TEST(test_output_ols_rle)
+{
+	GString *out;
+	const char *samples;
+	const uint8_t buf[] = {
+		0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01,
+	};
+
+	out = output_logic("ols", NULL, buf, sizeof(buf), 7);
+
+	/* The last sample is repeated, to keep the capture length. */
+	samples = strstr(out->str, "\n00@");
+	fail_unless(samples != NULL, "No samples in output.");
+	fail_unless(!strcmp(samples, "\n00@0\n01@5\n01@9\n"),
+		    "Unexpected output: %s.", samples);
+
+	g_string_free(out, TRUE);
+}
+END_TEST
+
+/* Check the CSV rows, one column per probe, LSB first. */
+START_TEST(test_output_csv)
+{
+	GString *out;
+	const char *rows;
+	const uint8_t buf[] = { 0x00, 0x81, 0x81, 0x3c };
+
+	out = output_logic("csv", NULL, buf, sizeof(buf), 1);
+
+	rows = strstr(out->str, "\n0,0,");
+	fail_unless(rows != NULL, "No rows in output.");
+	fail_unless(!strcmp(rows, "\n0,0,0,0,0,0,0,0,\n1,0,0,0,0,0,0,1,\n"
+		    "1,0,0,0,0,0,0,1,\n0,0,1,1,1,1,0,0,\n"),
+		    "Unexpected output: %s.", rows);
+
+	g_string_free(out, TRUE);
+}
+END_TEST
+
+/* Check that the CSV changes option only writes changed rows. */
+START_TEST(test_output_csv_changes)
+{
+	GString *out;
+	const char *rows;
+	const uint8_t buf[] = { 0x00, 0x00, 0x81, 0x81, 0x81, 0x81 };
+
+	out = output_logic("csv", "changes", buf, sizeof(buf), 3);
+
+	/* The last sample is repeated, to keep the capture length. */
+	rows = strstr(out->str, "\n0,0,");
+	fail_unless(rows != NULL, "No rows in output.");
+	fail_unless(!strcmp(rows, "\n0,0,0,0,0,0,0,0,0,\n2,1,0,0,0,0,0,0,1,\n"
+		    "5,1,0,0,0,0,0,0,1,\n"),
+		    "Unexpected output: %s.", rows);
+
+	g_string_free(out, TRUE);
+}
+END_TEST
+
+/* Check a receive_append() module writing through a callback sink. */
+START_TEST(test_output_sink_append)
+{
+	struct sr_output o;
+	struct sr_output_sink *sink;
+	struct sr_datafeed_packet packet;
+	struct sr_datafeed_logic logic;
+	GByteArray *written;
+	const uint8_t buf[] = { 0x00, 0x01, 0x03, 0x02 };
+	int ret;
+
+	o.format = srtest_output_get("vcd");
+	fail_unless(o.format->receive_append != NULL, "No receive_append().");
+	o.sdi = demo_sdi;
+	o.param = NULL;
+	o.internal = NULL;
+	ret = o.format->init(&o);
+	fail_unless(ret == SR_OK, "init() failed: %d.", ret);
+
+	written = g_byte_array_new();
+	sink = sr_output_sink_new(collect, written);
+	fail_unless(sink != NULL, "Failed to create sink.");
+
+	packet.type = SR_DF_LOGIC;
+	packet.payload = &logic;
+	logic.unitsize = 1;
+	logic.length = sizeof(buf);
+	logic.data = (void *)buf;
+	ret = sr_output_send(&o, &packet, sink);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	fail_unless(written->len == 0, "Output was not buffered.");
+
+	packet.type = SR_DF_END;
+	packet.payload = NULL;
+	ret = sr_output_send(&o, &packet, sink);
+	fail_unless(ret == SR_OK, "sr_output_send() failed: %d.", ret);
+	fail_unless(sr_output_sink_buffer(sink)->len == 0,
+		    "Output left in the buffer.");
+
+	/* Header, value changes and trailer, in that order. */
+	g_byte_array_append(written, (const uint8_t *)"", 1);
+	fail_unless(g_str_has_prefix((char *)written->data, "$date"),
+		    "No header: %s.", written->data);
+	fail_unless(strstr((char *)written->data, "$enddefinitions") != NULL,
+		    "No definitions: %s.", written->data);
+	fail_unless(g_str_has_suffix((char *)written->data, "$dumpoff\n$end\n"),
+		    "No trailer: %s.", written->data);
+
+	o.format->cleanup(&o);
+	sr_output_sink_free(sink);
+	g_byte_array_free(written, TRUE);
+}
+END_TEST
+
 Suite *suite_output_all(void)
 {
 	Suite *s;
@@ -42,6 +428,18 @@ Suite *suite_output_all(void)
 
 	tc = tcase_create("basic");
 	tcase_add_test(tc, test_output_available);
+	tcase_add_test(tc, test_output_binary_borrow);
+	tcase_add_test(tc, test_output_sink);
+	tcase_add_test(tc, test_output_sink_large);
+	tcase_add_test(tc, test_output_sink_error);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("formats");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_output_ols_rle);
+	tcase_add_test(tc, test_output_csv);
+	tcase_add_test(tc, test_output_csv_changes);
+	tcase_add_test(tc, test_output_sink_append);
 	suite_add_tcase(s, tc);
 
 	return s;
@@ -0,0 +1,168 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <check.h>
+#include "../libsigrok.h"
+#include "../libsigrok-internal.h"
+
+/*
+ * Fake SCPI transport serving a canned response. If strip_terminator is
+ * set, the trailing linefeed is never delivered (like TCP and USBTMC).
+ * Otherwise it is passed on unframed, like serial does.
+ */
+struct fake_scpi {
+	const char *response;
+	int length;
+	int pos;
+	gboolean strip_terminator;
+};
+
+static int fake_read_begin(void *priv)
+{
+	struct fake_scpi *fake = priv;
+
+	fake->pos = 0;
+
+	return SR_OK;
+}
+
+static int fake_read_data(void *priv, char *buf, int maxlen)
+{
+	struct fake_scpi *fake = priv;
+	int len;
+
+	len = MIN(maxlen, fake->length - fake->pos);
+	memcpy(buf, fake->response + fake->pos, len);
+	fake->pos += len;
+
+	return len;
+}
+
+static int fake_read_complete(void *priv)
+{
+	struct fake_scpi *fake = priv;
+
+	if (fake->strip_terminator)
+		return fake->pos >= fake->length;
+
+	return fake->pos > 0 && fake->response[fake->pos - 1] == '\n';
+}
+
+static void fake_init(struct sr_scpi_dev_inst *scpi, struct fake_scpi *fake,
+		const char *response, gboolean strip_terminator)
+{
+	memset(scpi, 0, sizeof(*scpi));
+	scpi->read_begin = fake_read_begin;
+	scpi->read_data = fake_read_data;
+	scpi->read_complete = fake_read_complete;
+	scpi->priv = fake;
+	scpi->unframed = !strip_terminator;
+
+	fake->response = response;
+	fake->length = strlen(response);
+	fake->pos = 0;
+	fake->strip_terminator = strip_terminator;
+}
+
+/* A transport which strips the terminator must not stall the block read. */
+START_TEST(test_get_block_stripped)
+{
+	struct sr_scpi_dev_inst scpi;
+	struct fake_scpi fake;
+	GByteArray *data;
+	gint64 start, elapsed;
+	int ret;
+
+	fake_init(&scpi, &fake, "#15hello", TRUE);
+	data = g_byte_array_new();
+
+	start = g_get_monotonic_time();
+	ret = sr_scpi_get_block(&scpi, NULL, data);
+	elapsed = g_get_monotonic_time() - start;
+
+	fail_unless(ret == SR_OK, "sr_scpi_get_block() failed: %d.", ret);
+	fail_unless(data->len == 5 && !memcmp(data->data, "hello", 5),
+		    "Wrong block data.");
+	fail_unless(elapsed < 100000, "Block read stalled for %" G_GINT64_FORMAT
+		    " us waiting for a terminator.", elapsed);
+
+	g_byte_array_free(data, TRUE);
+}
+END_TEST
+
+/* A transport which passes the terminator on must have it consumed. */
+START_TEST(test_get_block_terminated)
+{
+	struct sr_scpi_dev_inst scpi;
+	struct fake_scpi fake;
+	GByteArray *data;
+	int ret;
+
+	fake_init(&scpi, &fake, "#15hello\n", FALSE);
+	data = g_byte_array_new();
+
+	ret = sr_scpi_get_block(&scpi, NULL, data);
+
+	fail_unless(ret == SR_OK, "sr_scpi_get_block() failed: %d.", ret);
+	fail_unless(data->len == 5 && !memcmp(data->data, "hello", 5),
+		    "Wrong block data.");
+	fail_unless(fake.pos == fake.length, "Terminator was not consumed.");
+
+	g_byte_array_free(data, TRUE);
+}
+END_TEST
+
+/* Block data ending in a linefeed must not be taken for the terminator. */
+START_TEST(test_get_block_data_linefeed)
+{
+	struct sr_scpi_dev_inst scpi;
+	struct fake_scpi fake;
+	GByteArray *data;
+	int ret;
+
+	fake_init(&scpi, &fake, "#13ab\n\n", FALSE);
+	data = g_byte_array_new();
+
+	ret = sr_scpi_get_block(&scpi, NULL, data);
+
+	fail_unless(ret == SR_OK, "sr_scpi_get_block() failed: %d.", ret);
+	fail_unless(data->len == 3 && !memcmp(data->data, "ab\n", 3),
+		    "Wrong block data.");
+	fail_unless(fake.pos == fake.length, "Terminator was not consumed.");
+
+	g_byte_array_free(data, TRUE);
+}
+END_TEST
+
+Suite *suite_scpi(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("scpi");
+
+	tc = tcase_create("sr_scpi_get_block");
+	tcase_add_test(tc, test_get_block_stripped);
+	tcase_add_test(tc, test_get_block_terminated);
+	tcase_add_test(tc, test_get_block_data_linefeed);
+	suite_add_tcase(s, tc);
+
+	return s;
+}
@@ -0,0 +1,376 @@
+/*
+ * This file is part of the libsigrok project.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <check.h>
+#include <glib/gstdio.h>
+#include "../libsigrok.h"
+#include "lib.h"
+
+#define NUM_POLLFDS 1000
+
+struct sr_context *sr_ctx;
+
+static GPollFD fast_pollfd, slow_pollfd, stop_pollfd;
+static int fast_calls, slow_calls;
+static struct sr_dev_inst *demo_sdi;
+static uint64_t samples_seen;
+static uint64_t logic_samples_seen;
+static uint64_t analog_samples_seen;
+static const struct sr_dev_inst *devs_seen[2];
+static uint64_t dev_samples[2];
+static int ends_seen;
+
+static void setup(void)
+{
+	struct sr_dev_driver *driver;
+	GSList *devices;
+	int ret;
+
+	ret = sr_init(&sr_ctx);
+	fail_unless(ret == SR_OK, "sr_init() failed: %d.", ret);
+
+	/* A session can't run without a device, use a demo device. */
+	driver = srtest_driver_get("demo");
+	srtest_driver_init(sr_ctx, driver);
+	devices = sr_driver_scan(driver, NULL);
+	fail_unless(devices != NULL, "No demo device found.");
+
+	demo_sdi = devices->data;
+	g_slist_free(devices);
+
+	sr_session_new();
+	sr_session_dev_add(demo_sdi);
+}
+
+static void teardown(void)
+{
+	int ret;
+
+	sr_session_destroy();
+
+	ret = sr_exit(sr_ctx);
+	fail_unless(ret == SR_OK, "sr_exit() failed: %d.", ret);
+}
+
+static int count_cb(int fd, int revents, void *cb_data)
+{
+	(void)fd;
+	(void)revents;
+
+	(*(int *)cb_data)++;
+
+	return TRUE;
+}
+
+static int stop_cb(int fd, int revents, void *cb_data)
+{
+	(void)fd;
+	(void)revents;
+	(void)cb_data;
+
+	sr_session_source_remove_pollfd(&fast_pollfd);
+	sr_session_source_remove_pollfd(&slow_pollfd);
+
+	return FALSE;
+}
+
+/* Check whether every source is only called on its own timeout. */
+START_TEST(test_session_source_timeouts)
+{
+	fast_pollfd.fd = slow_pollfd.fd = stop_pollfd.fd = -1;
+	fast_calls = slow_calls = 0;
+
+	sr_session_source_add_pollfd(&fast_pollfd, 10, count_cb, &fast_calls);
+	sr_session_source_add_pollfd(&slow_pollfd, 100, count_cb, &slow_calls);
+	sr_session_source_add_pollfd(&stop_pollfd, 450, stop_cb, NULL);
+	sr_session_run();
+
+	fail_unless(fast_calls >= 20, "Fast source called %d times.",
+		    fast_calls);
+	fail_unless(slow_calls >= 2 && slow_calls <= 5,
+		    "Slow source called %d times.", slow_calls);
+}
+END_TEST
+
+/* Check whether adding and removing many sources in any order works. */
+START_TEST(test_session_source_add_remove)
+{
+	GPollFD pollfds[NUM_POLLFDS];
+	int ret, i;
+
+	for (i = 0; i < NUM_POLLFDS; i++) {
+		pollfds[i].fd = -1;
+		ret = sr_session_source_add_pollfd(&pollfds[i], i % 50 + 1,
+						   count_cb, &fast_calls);
+		fail_unless(ret == SR_OK, "Adding source %d failed: %d.",
+			    i, ret);
+	}
+
+	for (i = 1; i < NUM_POLLFDS; i += 2) {
+		ret = sr_session_source_remove_pollfd(&pollfds[i]);
+		fail_unless(ret == SR_OK, "Removing source %d failed: %d.",
+			    i, ret);
+	}
+	for (i = NUM_POLLFDS - 2; i >= 0; i -= 2) {
+		ret = sr_session_source_remove_pollfd(&pollfds[i]);
+		fail_unless(ret == SR_OK, "Removing source %d failed: %d.",
+			    i, ret);
+	}
+
+	/* All sources are gone, so this returns right away. */
+	ret = sr_session_run();
+	fail_unless(ret == SR_OK, "sr_session_run() failed: %d.", ret);
+}
+END_TEST
+
+static void datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	const struct sr_datafeed_analog *analog;
+
+	(void)sdi;
+	(void)cb_data;
+
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		samples_seen += logic->length / logic->unitsize;
+		logic_samples_seen += logic->length / logic->unitsize;
+	} else if (packet->type == SR_DF_ANALOG) {
+		analog = packet->payload;
+		samples_seen += analog->num_samples;
+		analog_samples_seen += analog->num_samples
+				       * g_slist_length(analog->probes);
+	}
+}
+
+/* Check whether the counters match what was sent on the session bus. */
+START_TEST(test_session_stats)
+{
+	struct sr_acq_stats dev_stats, session_stats;
+	int ret;
+
+	ret = sr_dev_open(demo_sdi);
+	fail_unless(ret == SR_OK, "sr_dev_open() failed: %d.", ret);
+	sr_config_set(demo_sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		      g_variant_new_uint64(100000));
+
+	samples_seen = 0;
+	sr_session_datafeed_callback_add(datafeed_in, NULL);
+	sr_session_start();
+	sr_session_run();
+
+	sr_session_stats_get(&session_stats);
+	sr_dev_stats_get(demo_sdi, &dev_stats);
+	sr_dev_close(demo_sdi);
+
+	fail_unless(samples_seen > 0, "No samples received.");
+	fail_unless(session_stats.samples_delivered == samples_seen,
+		    "Session counted %" PRIu64 " samples, %" PRIu64 " sent.",
+		    session_stats.samples_delivered, samples_seen);
+	fail_unless(dev_stats.samples_delivered == samples_seen,
+		    "Device counted %" PRIu64 " samples, %" PRIu64 " sent.",
+		    dev_stats.samples_delivered, samples_seen);
+	fail_unless(dev_stats.packets_sent >= 2,
+		    "Device sent %" PRIu64 " packets.", dev_stats.packets_sent);
+}
+END_TEST
+
+/* Check whether a capture saved while running replays completely. */
+START_TEST(test_session_save_stream)
+{
+	struct sr_session_save_stream *stream;
+	uint64_t saved, saved_analog;
+	char *filename;
+	int ret;
+
+	filename = g_strdup_printf("%s/check-session-%d.sr",
+				   g_get_tmp_dir(), (int)getpid());
+
+	ret = sr_dev_open(demo_sdi);
+	fail_unless(ret == SR_OK, "sr_dev_open() failed: %d.", ret);
+	sr_config_set(demo_sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		      g_variant_new_uint64(100000));
+
+	/* Small chunks, so the capture is spread over many of them. */
+	stream = sr_session_save_stream_new(filename, 10000);
+	fail_unless(stream != NULL, "Failed to create save stream.");
+	ret = sr_session_save_stream_analog_format(stream, "A1",
+			SR_SESSION_ANALOG_INT16, 0.001, 0);
+	fail_unless(ret == SR_OK, "Failed to set analog format: %d.", ret);
+
+	logic_samples_seen = analog_samples_seen = 0;
+	sr_session_datafeed_callback_add(datafeed_in, NULL);
+	sr_session_datafeed_callback_add(sr_session_save_stream_feed, stream);
+	sr_session_start();
+	sr_session_run();
+	sr_dev_close(demo_sdi);
+	sr_session_destroy();
+
+	ret = sr_session_save_stream_free(stream);
+	fail_unless(ret == SR_OK, "Saving failed: %d.", ret);
+	saved = logic_samples_seen;
+	saved_analog = analog_samples_seen;
+	fail_unless(saved > 0, "No logic samples received.");
+	fail_unless(saved_analog > 0, "No analog samples received.");
+
+	ret = sr_session_load(filename);
+	fail_unless(ret == SR_OK, "sr_session_load() failed: %d.", ret);
+	logic_samples_seen = analog_samples_seen = 0;
+	sr_session_datafeed_callback_add(datafeed_in, NULL);
+	sr_session_start();
+	sr_session_run();
+
+	fail_unless(logic_samples_seen == saved,
+		    "Replayed %" PRIu64 " samples, %" PRIu64 " saved.",
+		    logic_samples_seen, saved);
+	fail_unless(analog_samples_seen == saved_analog,
+		    "Replayed %" PRIu64 " analog samples, %" PRIu64 " saved.",
+		    analog_samples_seen, saved_analog);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+static void multi_datafeed_in(const struct sr_dev_inst *sdi,
+		const struct sr_datafeed_packet *packet, void *cb_data)
+{
+	const struct sr_datafeed_logic *logic;
+	int i;
+
+	(void)cb_data;
+
+	for (i = 0; i < 2 && devs_seen[i] && devs_seen[i] != sdi; i++)
+		;
+	fail_unless(i < 2, "Packet from a third device.");
+	devs_seen[i] = sdi;
+
+	if (packet->type == SR_DF_LOGIC) {
+		logic = packet->payload;
+		dev_samples[i] += logic->length / logic->unitsize;
+	} else if (packet->type == SR_DF_END) {
+		ends_seen++;
+	}
+}
+
+static void multi_reset(void)
+{
+	devs_seen[0] = devs_seen[1] = NULL;
+	dev_samples[0] = dev_samples[1] = 0;
+	ends_seen = 0;
+}
+
+/* Check whether two devices with different samplerates replay completely. */
+START_TEST(test_session_save_multi)
+{
+	struct sr_session_save_stream *stream;
+	struct sr_dev_inst *sdi2;
+	GSList *devices;
+	uint64_t saved[2];
+	char *filename;
+	int ret;
+
+	filename = g_strdup_printf("%s/check-session-multi-%d.sr",
+				   g_get_tmp_dir(), (int)getpid());
+
+	devices = sr_driver_scan(srtest_driver_get("demo"), NULL);
+	fail_unless(devices != NULL, "No second demo device found.");
+	sdi2 = devices->data;
+	g_slist_free(devices);
+
+	/* Both capture for half a second. */
+	sr_dev_open(demo_sdi);
+	sr_config_set(demo_sdi, NULL, SR_CONF_SAMPLERATE,
+		      g_variant_new_uint64(SR_KHZ(200)));
+	sr_config_set(demo_sdi, NULL, SR_CONF_LIMIT_SAMPLES,
+		      g_variant_new_uint64(100000));
+	sr_dev_open(sdi2);
+	sr_config_set(sdi2, NULL, SR_CONF_SAMPLERATE,
+		      g_variant_new_uint64(SR_KHZ(50)));
+	sr_config_set(sdi2, NULL, SR_CONF_LIMIT_SAMPLES,
+		      g_variant_new_uint64(25000));
+	sr_session_dev_add(sdi2);
+
+	stream = sr_session_save_stream_new(filename, 10000);
+	fail_unless(stream != NULL, "Failed to create save stream.");
+	multi_reset();
+	sr_session_datafeed_callback_add(multi_datafeed_in, NULL);
+	sr_session_datafeed_callback_add(sr_session_save_stream_feed, stream);
+	sr_session_start();
+	sr_session_run();
+	sr_dev_close(demo_sdi);
+	sr_dev_close(sdi2);
+	sr_session_destroy();
+
+	ret = sr_session_save_stream_free(stream);
+	fail_unless(ret == SR_OK, "Saving failed: %d.", ret);
+	fail_unless(ends_seen == 2, "%d devices ended.", ends_seen);
+	saved[0] = dev_samples[0];
+	saved[1] = dev_samples[1];
+	fail_unless(saved[0] > 0 && saved[1] > 0, "No samples received.");
+
+	ret = sr_session_load(filename);
+	fail_unless(ret == SR_OK, "sr_session_load() failed: %d.", ret);
+	multi_reset();
+	sr_session_datafeed_callback_add(multi_datafeed_in, NULL);
+	sr_session_start();
+	sr_session_run();
+
+	fail_unless(ends_seen == 2, "%d devices replayed.", ends_seen);
+	/* The replay order of the devices isn't necessarily the same. */
+	fail_unless((dev_samples[0] == saved[0] && dev_samples[1] == saved[1])
+		    || (dev_samples[0] == saved[1]
+			&& dev_samples[1] == saved[0]),
+		    "Replayed %" PRIu64 "/%" PRIu64 " samples, "
+		    "%" PRIu64 "/%" PRIu64 " saved.", dev_samples[0],
+		    dev_samples[1], saved[0], saved[1]);
+
+	g_unlink(filename);
+	g_free(filename);
+}
+END_TEST
+
+Suite *suite_session(void)
+{
+	Suite *s;
+	TCase *tc;
+
+	s = suite_create("session");
+
+	tc = tcase_create("sources");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_session_source_timeouts);
+	tcase_add_test(tc, test_session_source_add_remove);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("stats");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_session_stats);
+	suite_add_tcase(s, tc);
+
+	tc = tcase_create("save");
+	tcase_add_checked_fixture(tc, setup, teardown);
+	tcase_add_test(tc, test_session_save_stream);
+	tcase_add_test(tc, test_session_save_multi);
+	suite_add_tcase(s, tc);
+
+	return s;
+}